@@ -4,6 +4,7 @@
 #include <algorithm>
 #include <list>
 
+#include "coroutine_task.h"
 #include "threadpool.h"
 
 namespace Concurrency{
@@ -43,12 +44,19 @@ std::list<T> ManualThreadingQuickSort(std::list<T> input)
     return result;
 }
 
+namespace Internal {
+
+// With on_pool the sort first moves to a task of thread_pool, otherwise it starts on the awaiting thread.
 template<typename T>
-std::list<T> ThreadPoolQuickSort(std::list<T> input, ThreadPool& thread_pool)
+Task<std::list<T>> CoroutineQuickSort(std::list<T> input, ThreadPool& thread_pool, const bool on_pool)
 {
     if(input.empty())
     {
-        return input;
+        co_return input;
+    }
+    if(on_pool)
+    {
+        co_await thread_pool.schedule();
     }
     std::list<T> result;
     result.splice(result.begin(),input,input.begin());
@@ -66,28 +74,31 @@ std::list<T> ThreadPoolQuickSort(std::list<T> input, ThreadPool& thread_pool)
     lower_part.splice(lower_part.end(),input,input.begin(),
     divide_point);
 
-    auto new_lower = thread_pool.submit([&thread_pool, &lower_part] ()
-        {
-            return ThreadPoolQuickSort<T>(std::move(lower_part), thread_pool);
-        });
+    // Queue the lower part on the pool and sort the higher part on this thread meanwhile.
+    auto new_lower = CoroutineQuickSort(std::move(lower_part), thread_pool, true);
+    new_lower.start();
 
-    if (!new_lower.has_value()) [[unlikely]]
-    {
-        throw std::runtime_error("Submitting task to thread pool failed!");
-    }
-    std::future<std::list<T>> new_lower_fut = std::move(new_lower.value());
-
-    auto new_higher(ThreadPoolQuickSort(std::move(input), thread_pool));
+    auto new_higher(co_await CoroutineQuickSort(std::move(input), thread_pool, false));
 
     result.splice(result.end(), new_higher);
 
-    // Run other pending tasks while waiting for our lower part to get sorted by threadpool.
-    while (new_lower_fut.wait_for(std::chrono::seconds(0)) == std::future_status::timeout)
-    {
-        thread_pool.runPendingTask();
-    }
-    result.splice(result.begin(), new_lower_fut.get());
-    return result;
+    // Doesn't block: if the lower part isn't sorted yet, this coroutine is resumed by the thread that finishes it.
+    result.splice(result.begin(), co_await new_lower);
+    co_return result;
+}
+
+} // namespace Internal
+
+template<typename T>
+Task<std::list<T>> CoroutineQuickSort(std::list<T> input, ThreadPool& thread_pool)
+{
+    return Internal::CoroutineQuickSort(std::move(input), thread_pool, false);
+}
+
+template<typename T>
+std::list<T> ThreadPoolQuickSort(std::list<T> input, ThreadPool& thread_pool)
+{
+    return syncWait(thread_pool, CoroutineQuickSort(std::move(input), thread_pool));
 }
 
 } // namespace Concurrency
@@ -52,5 +52,17 @@ TEST_F(QuickSortTest, ThreadPoolCorrectnessTest)
     EXPECT_TRUE(std::is_sorted(numbers_lst.begin(), numbers_lst.end()));
 }
 
+TEST_F(QuickSortTest, CoroutineCorrectnessTest)
+{
+    std::list<int> numbers_lst = generateRandomizedList(10'000);
+    ThreadPool thread_pool;
+
+    ASSERT_FALSE(std::is_sorted(numbers_lst.begin(), numbers_lst.end()));
+
+    numbers_lst = syncWait(thread_pool, CoroutineQuickSort(numbers_lst, thread_pool));
+
+    EXPECT_TRUE(std::is_sorted(numbers_lst.begin(), numbers_lst.end()));
+}
+
 } // namespace Concurrency::Testing
 
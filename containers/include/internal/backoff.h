@@ -0,0 +1,71 @@
+#ifndef BACKOFF_H
+#define BACKOFF_H
+
+#include <algorithm>
+#include <cstdint>
+#include <thread>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+namespace Concurrency::Internal {
+
+inline void cpuRelax () noexcept
+{
+#if defined(__x86_64__) || defined(__i386__)
+    _mm_pause();
+#endif
+}
+
+/**
+ * Exponential backoff for retry loops.
+ * spin() is for a lost race (CAS failure), snooze() for waiting on another thread to finish a step: after a few
+ * rounds it yields the thread to the OS so a preempted thread can make progress.
+ */
+class Backoff
+{
+private:
+    static constexpr uint32_t spin_limit  = 6;
+    static constexpr uint32_t yield_limit = 10;
+
+    uint32_t _step = 0;
+
+public:
+    void spin () noexcept
+    {
+        for (uint32_t i = 0; i < (1u << std::min(_step, spin_limit)); ++i)
+        {
+            cpuRelax();
+        }
+
+        if (_step <= spin_limit)
+        {
+            ++_step;
+        }
+    }
+
+    void snooze () noexcept
+    {
+        if (_step <= spin_limit)
+        {
+            for (uint32_t i = 0; i < (1u << _step); ++i)
+            {
+                cpuRelax();
+            }
+        }
+        else
+        {
+            std::this_thread::yield();
+        }
+
+        if (_step <= yield_limit)
+        {
+            ++_step;
+        }
+    }
+};
+
+} // namespace Concurrency::Internal
+
+#endif // BACKOFF_H
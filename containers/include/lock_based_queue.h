@@ -8,8 +8,6 @@
 
 namespace Concurrency {
 
-// FIXME: Replace this with a lock-free queue
-
 template<typename T>
 class ConcurrentQueue
 {
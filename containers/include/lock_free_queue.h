@@ -0,0 +1,336 @@
+#ifndef LOCK_FREE_QUEUE_H
+#define LOCK_FREE_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+#include "internal/backoff.h"
+
+
+/**
+ * This file contains an unbounded lock-free MPMC queue with the interface of ConcurrentQueue.
+ *
+ * Elements live in a linked list of blocks of `block_capacity` slots. Producers and consumers claim a position with a
+ * CAS on a 64-bit index, the last position of every block is never used for an element: whoever claims the position
+ * before it links in the next block and moves the index past it, the others back off while the index points at it.
+ *
+ * Blocks are reclaimed without hazard pointers or epochs. Each slot records that it was written, that it was read and
+ * that its block should be destroyed. The consumer of the last slot of a block starts the destruction, it walks the
+ * slots and hands it over to the first consumer that is still reading one, which finishes it when it's done.
+ *
+ * The design follows crossbeam's SegQueue. Elements must be nothrow move constructible.
+ */
+
+namespace Concurrency {
+
+namespace Internal {
+
+template<typename T>
+struct LockFreeQueueSlot
+{
+    static constexpr uint32_t write   = 1;
+    static constexpr uint32_t read    = 2;
+    static constexpr uint32_t destroy = 4;
+
+    std::atomic<uint32_t> state {0};
+    alignas(T) std::byte  storage[sizeof(T)];
+
+    T* object () noexcept
+    {
+        return std::launder(reinterpret_cast<T*>(storage));
+    }
+
+    void waitWrite () const noexcept
+    {
+        Backoff backoff;
+        while ((state.load(std::memory_order_acquire) & write) == 0)
+        {
+            backoff.snooze();
+        }
+    }
+};
+
+template<typename T, uint32_t CAPACITY>
+struct LockFreeQueueBlock
+{
+    std::atomic<LockFreeQueueBlock*> next {nullptr};
+    LockFreeQueueSlot<T>             slots[CAPACITY];
+
+    LockFreeQueueBlock* waitNext () const noexcept
+    {
+        Backoff backoff;
+        while (true)
+        {
+            LockFreeQueueBlock* next_block = next.load(std::memory_order_acquire);
+            if (next_block != nullptr)
+            {
+                return next_block;
+            }
+            backoff.snooze();
+        }
+    }
+
+    /**
+     * Destroy the block once no consumer reads slots [start, CAPACITY) anymore.
+     * If a slot is still being read, mark it and let its consumer call destroy() again from the next slot.
+     * The last slot doesn't need the mark, its consumer is the one who started the destruction.
+     */
+    static void destroy (LockFreeQueueBlock* block, const uint32_t start) noexcept
+    {
+        for (uint32_t i = start; i + 1 < CAPACITY; ++i)
+        {
+            std::atomic<uint32_t>& state = block->slots[i].state;
+            if ((state.load(std::memory_order_acquire) & LockFreeQueueSlot<T>::read) == 0
+                && (state.fetch_or(LockFreeQueueSlot<T>::destroy, std::memory_order_acq_rel)
+                    & LockFreeQueueSlot<T>::read) == 0)
+            {
+                return;
+            }
+        }
+        delete block;
+    }
+};
+
+} // namespace Internal
+
+template<typename T>
+requires std::is_nothrow_move_constructible_v<T>
+class LockFreeQueue
+{
+private:
+    // Indices count positions shifted by `shift`, the low bit of the head index flags that the head block has a
+    // successor, a consumer that sees it doesn't need to look at the tail to know the queue isn't empty.
+    static constexpr uint64_t shift          = 1;
+    static constexpr uint64_t has_next       = 1;
+    static constexpr uint64_t lap            = 32;
+    static constexpr uint32_t block_capacity = lap - 1;
+    static constexpr size_t   cache_line     = 64;
+
+    using Slot  = Internal::LockFreeQueueSlot<T>;
+    using Block = Internal::LockFreeQueueBlock<T, block_capacity>;
+
+    struct alignas(cache_line) Position
+    {
+        std::atomic<uint64_t> index {0};
+        std::atomic<Block*>   block {nullptr};
+    };
+
+    Position _head;
+    Position _tail;
+
+    static constexpr uint32_t offsetOf (const uint64_t index) noexcept
+    {
+        return static_cast<uint32_t>((index >> shift) % lap);
+    }
+
+public:
+    LockFreeQueue()  = default;
+
+    ~LockFreeQueue()
+    {
+        uint64_t head  = _head.index.load(std::memory_order_relaxed) & ~has_next;
+        uint64_t tail  = _tail.index.load(std::memory_order_relaxed) & ~has_next;
+        Block*   block = _head.block.load(std::memory_order_relaxed);
+
+        for (; head != tail; head += (1 << shift))
+        {
+            const uint32_t offset = offsetOf(head);
+            if (offset < block_capacity)
+            {
+                std::destroy_at(block->slots[offset].object());
+            }
+            else
+            {
+                Block* next_block = block->next.load(std::memory_order_relaxed);
+                delete block;
+                block = next_block;
+            }
+        }
+
+        delete block;
+    }
+
+    LockFreeQueue(const LockFreeQueue &) = delete;
+    LockFreeQueue(LockFreeQueue &&)      = delete;
+
+    LockFreeQueue &operator=(const LockFreeQueue &) = delete;
+    LockFreeQueue &operator=(LockFreeQueue &&)      = delete;
+
+    /**
+     * Append an element. Returns false only if a new block couldn't be allocated.
+     */
+    bool push(T element)
+    {
+        Internal::Backoff backoff;
+        uint64_t          tail       = _tail.index.load(std::memory_order_acquire);
+        Block*            block      = _tail.block.load(std::memory_order_acquire);
+        Block*            next_block = nullptr;
+
+        while (true)
+        {
+            const uint32_t offset = offsetOf(tail);
+
+            // Another producer is linking in the next block.
+            if (offset == block_capacity)
+            {
+                backoff.snooze();
+                tail  = _tail.index.load(std::memory_order_acquire);
+                block = _tail.block.load(std::memory_order_acquire);
+                continue;
+            }
+
+            // Allocate the next block before claiming the last slot, so the others don't wait on the allocation.
+            if (offset + 1 == block_capacity && next_block == nullptr)
+            {
+                next_block = new (std::nothrow) Block;
+                if (next_block == nullptr)
+                {
+                    return false;
+                }
+            }
+
+            // First push ever: install the first block.
+            if (block == nullptr)
+            {
+                Block* first_block = new (std::nothrow) Block;
+                if (first_block == nullptr)
+                {
+                    delete next_block;
+                    return false;
+                }
+
+                if (_tail.block.compare_exchange_strong(block, first_block, std::memory_order_release,
+                                                        std::memory_order_relaxed))
+                {
+                    _head.block.store(first_block, std::memory_order_release);
+                    block = first_block;
+                }
+                else
+                {
+                    delete next_block;
+                    next_block = first_block;
+                    tail       = _tail.index.load(std::memory_order_acquire);
+                    block      = _tail.block.load(std::memory_order_acquire);
+                    continue;
+                }
+            }
+
+            const uint64_t new_tail = tail + (1 << shift);
+            if (_tail.index.compare_exchange_weak(tail, new_tail, std::memory_order_seq_cst,
+                                                  std::memory_order_acquire))
+            {
+                if (offset + 1 == block_capacity)
+                {
+                    _tail.block.store(next_block, std::memory_order_release);
+                    _tail.index.store(new_tail + (1 << shift), std::memory_order_release);
+                    block->next.store(next_block, std::memory_order_release);
+                    next_block = nullptr;
+                }
+
+                delete next_block;
+
+                Slot& slot = block->slots[offset];
+                new (slot.storage) T(std::move(element));
+                slot.state.fetch_or(Slot::write, std::memory_order_release);
+                return true;
+            }
+
+            block = _tail.block.load(std::memory_order_acquire);
+            backoff.spin();
+        }
+    }
+
+    std::optional<T> pop()
+    {
+        Internal::Backoff backoff;
+        uint64_t          head  = _head.index.load(std::memory_order_acquire);
+        Block*            block = _head.block.load(std::memory_order_acquire);
+
+        while (true)
+        {
+            const uint32_t offset = offsetOf(head);
+
+            // Another consumer is moving the head to the next block.
+            if (offset == block_capacity)
+            {
+                backoff.snooze();
+                head  = _head.index.load(std::memory_order_acquire);
+                block = _head.block.load(std::memory_order_acquire);
+                continue;
+            }
+
+            uint64_t new_head = head + (1 << shift);
+
+            if ((new_head & has_next) == 0)
+            {
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                const uint64_t tail = _tail.index.load(std::memory_order_relaxed);
+
+                if ((head >> shift) == (tail >> shift))
+                {
+                    return std::nullopt;
+                }
+
+                if ((head >> shift) / lap != (tail >> shift) / lap)
+                {
+                    new_head |= has_next;
+                }
+            }
+
+            // The first push is still installing the first block.
+            if (block == nullptr)
+            {
+                backoff.snooze();
+                head  = _head.index.load(std::memory_order_acquire);
+                block = _head.block.load(std::memory_order_acquire);
+                continue;
+            }
+
+            if (_head.index.compare_exchange_weak(head, new_head, std::memory_order_seq_cst,
+                                                  std::memory_order_acquire))
+            {
+                if (offset + 1 == block_capacity)
+                {
+                    Block*   next_block = block->waitNext();
+                    uint64_t next_index = (new_head & ~has_next) + (1 << shift);
+                    if (next_block->next.load(std::memory_order_relaxed) != nullptr)
+                    {
+                        next_index |= has_next;
+                    }
+
+                    _head.block.store(next_block, std::memory_order_release);
+                    _head.index.store(next_index, std::memory_order_release);
+                }
+
+                Slot& slot = block->slots[offset];
+                slot.waitWrite();
+                std::optional<T> result(std::move(*slot.object()));
+                std::destroy_at(slot.object());
+
+                if (offset + 1 == block_capacity)
+                {
+                    Block::destroy(block, 0);
+                }
+                else if ((slot.state.fetch_or(Slot::read, std::memory_order_acq_rel) & Slot::destroy) != 0)
+                {
+                    Block::destroy(block, offset + 1);
+                }
+
+                return result;
+            }
+
+            block = _head.block.load(std::memory_order_acquire);
+            backoff.spin();
+        }
+    }
+};
+
+} // namespace Concurrency
+
+#endif // LOCK_FREE_QUEUE_H
@@ -1,40 +1,145 @@
 #ifndef LOCK_FREE_RING_H
 #define LOCK_FREE_RING_H
 
+#include <algorithm>
 #include <atomic>
+#include <chrono>
+#include <cstddef>
 #include <cstdint>
+#include <iterator>
+#include <memory>
+#include <new>
 #include <optional>
+#include <ranges>
+#include <stdexcept>
+#include <type_traits>
+
+#include "ring_storage.h"
+#include "ring_wait_strategy.h"
 
 
 /**
  * This file contains a lock-free ring buffer implementation.
- * This implementation is meant to run on X86 architecture. It may have UB on other architectures.
+ *
+ * The SPSC flavour only uses the head/tail indices for synchronization. The flavours with more than one producer
+ * and/or consumer use a sequence number per slot (Dmitry Vyukov's bounded queue): a slot is writable for position
+ * `pos` when its sequence equals `pos` and readable when it equals `pos + 1`. The side that has more than one thread
+ * reserves its position with a CAS on its index, the single side simply stores it once the slot is published.
+ *
+ * Slots are raw uninitialized storage: objects are constructed in place when enqueued and destroyed when dequeued,
+ * so T doesn't need to be default constructible. The slot array comes from a storage policy (see ring_storage.h).
+ *
+ * The number of slots is either a compile-time constant or, with `dynamic_ring_size`, given to the constructor.
+ *
+ * enqueueWait/dequeueWait block until they succeed or time out, how they wait is chosen by the wait strategy
+ * (see ring_wait_strategy.h). The default one spins.
  */
 
 namespace Concurrency {
 
 enum class LockFreeRingType
 {
-    SPSC
+    SPSC,
+    MPSC,
+    SPMC,
+    MPMC
+};
+
+inline constexpr uint32_t dynamic_ring_size = 0;
+
+namespace Internal {
+
+template<typename T>
+struct LockFreeRingSlotStorage
+{
+    alignas(T) std::byte storage[sizeof(T)];
+
+    void* raw () noexcept
+    {
+        return storage;
+    }
+
+    T* object () noexcept
+    {
+        return std::launder(reinterpret_cast<T*>(storage));
+    }
+};
+
+template<typename T, bool SEQUENCED>
+struct LockFreeRingSlot : LockFreeRingSlotStorage<T>
+{
+};
+
+template<typename T>
+struct LockFreeRingSlot<T, true> : LockFreeRingSlotStorage<T>
+{
+    std::atomic<uint32_t> sequence;
+};
+
+struct LockFreeRingNoSize
+{
 };
 
-template<typename T, uint32_t N, LockFreeRingType RING_TYPE = LockFreeRingType::SPSC>
+} // namespace Internal
+
+template<typename T, uint32_t N, LockFreeRingType RING_TYPE = LockFreeRingType::SPSC,
+         RingStorage Storage = HeapStorage, RingWaitStrategy WaitStrategy = BusySpinWait>
 class LockFreeRing
 {
 private:
     static constexpr uint32_t cache_line_size = 64;
 
-    alignas(cache_line_size) T* _ring;
+    static constexpr bool multi_producer = RING_TYPE == LockFreeRingType::MPSC || RING_TYPE == LockFreeRingType::MPMC;
+    static constexpr bool multi_consumer = RING_TYPE == LockFreeRingType::SPMC || RING_TYPE == LockFreeRingType::MPMC;
+    static constexpr bool sequenced      = RING_TYPE != LockFreeRingType::SPSC;
+    static constexpr bool dynamic        = N == dynamic_ring_size;
+
+    using Slot = Internal::LockFreeRingSlot<T, sequenced>;
+
+    static constexpr size_t slot_alignment = std::max<size_t>(alignof(Slot), cache_line_size);
 
+    using SlotPointer = std::conditional_t<PositionIndependentRingStorage<Storage>, Internal::OffsetPointer<Slot>, Slot*>;
+
+    // Read-only after construction, shared by both sides.
+    alignas(cache_line_size) SlotPointer            _ring;
+    [[no_unique_address]] std::conditional_t<dynamic, uint32_t, Internal::LockFreeRingNoSize> _size_mask;
+    [[no_unique_address]] Storage                   _storage;
+
+    /**
+     * Each side keeps a private copy of the other side's index next to its own one (SPSC only). The copy is only
+     * refreshed when the ring looks full to the producer or empty to the consumer, so in the common case neither side
+     * touches the other side's cache line.
+     */
     alignas(cache_line_size) std::atomic<uint32_t> _head;
+    uint32_t                                       _cached_tail;
+
     alignas(cache_line_size) std::atomic<uint32_t> _tail;
+    uint32_t                                       _cached_head;
 
-    static constexpr uint32_t size_mask = N - 1;
-    static constexpr uint32_t capacity = size_mask;
+    // Consumers wait on `_not_empty` and producers notify it, the other way around for `_not_full`.
+    [[no_unique_address]] WaitStrategy _not_empty;
+    [[no_unique_address]] WaitStrategy _not_full;
+
+    [[nodiscard]] constexpr uint32_t sizeMask() const noexcept
+    {
+        if constexpr (dynamic)
+        {
+            return _size_mask;
+        }
+        else
+        {
+            return N - 1;
+        }
+    }
+
+    [[nodiscard]] constexpr uint32_t slotCount() const noexcept
+    {
+        return sizeMask() + 1;
+    }
 
     [[nodiscard]] constexpr uint32_t freeSpace(const uint32_t head, const uint32_t tail) const noexcept
     {
-        return capacity + tail - head;
+        return capacity() + tail - head;
     }
 
     [[nodiscard]] constexpr uint32_t size(const uint32_t head, const uint32_t tail) const noexcept
@@ -52,19 +157,222 @@ private:
         return (number + (align - 1)) & ~(align - 1);
     }
 
+    /**
+     * Difference between a slot sequence and the sequence we expect to see. Indices are free-running and wrap around,
+     * so the difference has to be interpreted as a signed value.
+     */
+    static constexpr int32_t sequenceDiff(const uint32_t sequence, const uint32_t expected) noexcept
+    {
+        return static_cast<int32_t>(sequence - expected);
+    }
+
+    Slot& slotAt(const uint32_t position) noexcept
+    {
+        return _ring[position & sizeMask()];
+    }
+
+    struct Reservation
+    {
+        uint32_t position;
+        uint32_t count;
+    };
+
+    /**
+     * Find up to `max_count` consecutive usable positions on the index of one side of the ring.
+     * `ready_offset` is what the slot sequence must be ahead of the position for the slot to be usable by this side:
+     * 0 for the producers (slot is empty) and 1 for the consumers (slot is full).
+     * A side with several threads takes the positions with a single CAS on its index. A single-threaded side leaves its
+     * index alone, the index is moved when the slots are published.
+     * A zero count means the ring is full (producers) or empty (consumers).
+     */
+    template<bool MULTI>
+    Reservation reservePositions(std::atomic<uint32_t>& index, const uint32_t ready_offset,
+                                 const uint32_t max_count) noexcept
+    {
+        uint32_t position = index.load(std::memory_order_relaxed);
+        while (true)
+        {
+            const uint32_t sequence = slotAt(position).sequence.load(std::memory_order_acquire);
+            const int32_t  diff     = sequenceDiff(sequence, position + ready_offset);
+
+            if (diff < 0)
+            {
+                return {position, 0};
+            }
+
+            if (diff > 0)
+            {
+                // Another thread on our side already took this position.
+                position = index.load(std::memory_order_relaxed);
+                continue;
+            }
+
+            /**
+             * Nobody on our side can use these slots without moving the index past `position` first, so they stay
+             * usable for us as long as the index update below succeeds.
+             */
+            uint32_t count = 1;
+            while (count < max_count)
+            {
+                const uint32_t next = position + count;
+                if (slotAt(next).sequence.load(std::memory_order_acquire) != next + ready_offset)
+                {
+                    break;
+                }
+                ++count;
+            }
+
+            if constexpr (MULTI)
+            {
+                if (!index.compare_exchange_weak(position, position + count, std::memory_order_relaxed))
+                {
+                    continue;
+                }
+            }
+
+            return {position, count};
+        }
+    }
+
+    Reservation reserveForProducer(const uint32_t max_count) noexcept
+    {
+        if constexpr (sequenced)
+        {
+            return reservePositions<multi_producer>(_head, 0, max_count);
+        }
+        else
+        {
+            const uint32_t head = _head.load(std::memory_order_relaxed);
+            if (freeSpace(head, _cached_tail) < max_count)
+            {
+                _cached_tail = _tail.load(std::memory_order_acquire);
+            }
+            return {head, std::min(max_count, freeSpace(head, _cached_tail))};
+        }
+    }
+
+    // Make the slots of `reservation`, with their objects constructed, visible to the consumers.
+    void publishForConsumers(const Reservation reservation) noexcept
+    {
+        if constexpr (sequenced)
+        {
+            if constexpr (!multi_producer)
+            {
+                _head.store(reservation.position + reservation.count, std::memory_order_relaxed);
+            }
+
+            for (uint32_t i = 0; i < reservation.count; ++i)
+            {
+                const uint32_t position = reservation.position + i;
+                slotAt(position).sequence.store(position + 1, std::memory_order_release);
+            }
+        }
+        else
+        {
+            _head.store(reservation.position + reservation.count, std::memory_order_release);
+        }
+
+        _not_empty.notify();
+    }
+
+    Reservation reserveForConsumer(const uint32_t max_count) noexcept
+    {
+        if constexpr (sequenced)
+        {
+            return reservePositions<multi_consumer>(_tail, 1, max_count);
+        }
+        else
+        {
+            const uint32_t tail = _tail.load(std::memory_order_relaxed);
+            if (size(_cached_head, tail) < max_count)
+            {
+                _cached_head = _head.load(std::memory_order_acquire);
+            }
+            return {tail, std::min(max_count, size(_cached_head, tail))};
+        }
+    }
+
+    // Hand the slots of `reservation`, with their objects destroyed, back to the producers.
+    void publishForProducers(const Reservation reservation) noexcept
+    {
+        if constexpr (sequenced)
+        {
+            if constexpr (!multi_consumer)
+            {
+                _tail.store(reservation.position + reservation.count, std::memory_order_relaxed);
+            }
+
+            // The slot becomes writable for the producer of the next lap.
+            for (uint32_t i = 0; i < reservation.count; ++i)
+            {
+                const uint32_t position = reservation.position + i;
+                slotAt(position).sequence.store(position + slotCount(), std::memory_order_release);
+            }
+        }
+        else
+        {
+            _tail.store(reservation.position + reservation.count, std::memory_order_release);
+        }
+
+        _not_full.notify();
+    }
+
+    void allocateSlots ()
+    {
+        const uint32_t slot_count = slotCount();
+
+        void* memory = _storage.allocate(sizeof(Slot) * slot_count, slot_alignment);
+        _ring = std::uninitialized_default_construct_n(static_cast<Slot*>(memory), slot_count) - slot_count;
+
+        if constexpr (sequenced)
+        {
+            for (uint32_t i = 0; i < slot_count; ++i)
+            {
+                _ring[i].sequence.store(i, std::memory_order_relaxed);
+            }
+        }
+    }
+
 public:
 
-    LockFreeRing ()
-        : _ring(nullptr), _head(0), _tail(0)
+    explicit LockFreeRing (Storage storage = Storage()) requires (!dynamic)
+        : _ring(nullptr), _size_mask(), _storage(std::move(storage)), _head(0), _cached_tail(0), _tail(0),
+          _cached_head(0)
     {
         static_assert(isPowerOf2(N), "LockFreeRing size must be a power of 2");
 
-        _ring = new T[N];
+        allocateSlots();
+    }
+
+    /**
+     * Ring with `size` slots, `size` must be a power of 2.
+     */
+    explicit LockFreeRing (const uint32_t size, Storage storage = Storage()) requires (dynamic)
+        : _ring(nullptr), _size_mask(size - 1), _storage(std::move(storage)), _head(0), _cached_tail(0), _tail(0),
+          _cached_head(0)
+    {
+        if (!isPowerOf2(size))
+        {
+            throw std::invalid_argument("LockFreeRing size must be a power of 2");
+        }
+
+        allocateSlots();
     }
 
     ~LockFreeRing ()
     {
-        delete[] _ring;
+        if constexpr (!std::is_trivially_destructible_v<T>)
+        {
+            const uint32_t head = _head.load(std::memory_order_acquire);
+            for (uint32_t position = _tail.load(std::memory_order_acquire); position != head; ++position)
+            {
+                std::destroy_at(slotAt(position).object());
+            }
+        }
+
+        Slot* slots = _ring;
+        std::destroy_n(slots, slotCount());
+        _storage.deallocate(slots, sizeof(Slot) * slotCount(), slot_alignment);
     }
 
     LockFreeRing (const LockFreeRing &) = delete;
@@ -73,9 +381,15 @@ public:
     LockFreeRing& operator= (const LockFreeRing&) = delete;
     LockFreeRing& operator= (LockFreeRing&&) = delete;
 
+    // Maximum number of elements. The SPSC ring keeps one slot empty, the sequenced rings can use every slot.
+    [[nodiscard]] constexpr uint32_t capacity() const noexcept
+    {
+        return sequenced ? slotCount() : sizeMask();
+    }
+
     [[nodiscard]] constexpr uint32_t freeSpace() const noexcept
     {
-        return capacity + _tail.load(std::memory_order_seq_cst) - _head.load(std::memory_order_seq_cst);
+        return capacity() + _tail.load(std::memory_order_seq_cst) - _head.load(std::memory_order_seq_cst);
     }
 
     [[nodiscard]] constexpr uint32_t size() const noexcept
@@ -83,34 +397,226 @@ public:
         return _head.load(std::memory_order_seq_cst) - _tail.load(std::memory_order_seq_cst);
     }
 
-    bool enqueue (T item) noexcept requires (RING_TYPE == LockFreeRingType::SPSC)
+    /**
+     * Construct an element directly in the next free slot.
+     * Returns false, without constructing anything, if the ring is full.
+     * If the constructor throws, nothing is enqueued. Several producers can't give back a position they took, other
+     * producers may have taken the next ones already: there a constructor that can throw runs before the position is
+     * taken, and the element is moved into its slot.
+     */
+    template<typename... Args>
+    bool emplace (Args&&... args) noexcept(std::is_nothrow_constructible_v<T, Args...>)
     {
-        const uint32_t head = _head.load(std::memory_order_relaxed);
-
-        if (freeSpace(head, _tail.load(std::memory_order_relaxed)) < 1)
+        if constexpr (multi_producer && !std::is_nothrow_constructible_v<T, Args...>)
         {
-            return false;
+            static_assert(std::is_nothrow_move_constructible_v<T>, "LockFreeRing elements must be nothrow movable");
+
+            T item(std::forward<Args>(args)...);
+            return emplace(std::move(item));
         }
+        else
+        {
+            // A single producer only moves its index when it publishes, a throwing constructor leaves the slot free.
+            const Reservation reservation = reserveForProducer(1);
+            if (reservation.count == 0)
+            {
+                return false;
+            }
 
-        _ring[head & size_mask] = std::move(item);
-        _head.store(head + 1, std::memory_order_relaxed);
+            std::construct_at(static_cast<T*>(slotAt(reservation.position).raw()), std::forward<Args>(args)...);
+            publishForConsumers(reservation);
 
-        return true;
+            return true;
+        }
     }
 
-    std::optional<T> dequeue () noexcept requires (RING_TYPE == LockFreeRingType::SPSC)
+    bool enqueue (T item) noexcept
     {
-        const uint32_t tail = _tail.load(std::memory_order_relaxed);
+        return emplace(std::move(item));
+    }
 
-        if (size(_head.load(std::memory_order_relaxed), tail) < 1)
+    std::optional<T> dequeue () noexcept
+    {
+        const Reservation reservation = reserveForConsumer(1);
+        if (reservation.count == 0)
         {
             return std::nullopt;
         }
 
-        T item = std::move(_ring[tail & size_mask]);
-        _tail.store(tail + 1, std::memory_order_relaxed);
+        T* object = slotAt(reservation.position).object();
+        std::optional<T> item(std::move(*object));
+        std::destroy_at(object);
+
+        publishForProducers(reservation);
         return item;
     }
+
+    /**
+     * Enqueue, waiting up to `timeout` for a free slot if the ring is full.
+     */
+    template<typename Rep, typename Period>
+    bool enqueueWait (T item, const std::chrono::duration<Rep, Period> timeout) noexcept
+    {
+        return _not_full.waitUntil(RingWaitClock::now() + timeout, [this, &item]()
+        {
+            return emplace(std::move(item));
+        });
+    }
+
+    /**
+     * Dequeue, waiting up to `timeout` for an element if the ring is empty.
+     */
+    template<typename Rep, typename Period>
+    std::optional<T> dequeueWait (const std::chrono::duration<Rep, Period> timeout) noexcept
+    {
+        std::optional<T> item;
+        _not_empty.waitUntil(RingWaitClock::now() + timeout, [this, &item]()
+        {
+            item = dequeue();
+            return item.has_value();
+        });
+        return item;
+    }
+
+    /**
+     * Zero-copy produce: get the next free slot, construct the element in it (e.g. with std::construct_at) and make it
+     * visible to the consumers with commit(). Returns nullptr if the ring is full.
+     * The returned memory is uninitialized. Only one slot can be claimed at a time, and only with a single producer.
+     */
+    [[nodiscard]] T* tryClaim () noexcept requires (!multi_producer)
+    {
+        const Reservation reservation = reserveForProducer(1);
+        if (reservation.count == 0)
+        {
+            return nullptr;
+        }
+
+        return static_cast<T*>(slotAt(reservation.position).raw());
+    }
+
+    // Publish the slot returned by the last successful tryClaim(). The element must have been constructed in it.
+    void commit () noexcept requires (!multi_producer)
+    {
+        publishForConsumers({_head.load(std::memory_order_relaxed), 1});
+    }
+
+    /**
+     * Zero-copy consume: access the oldest element in place, then destroy it and free its slot with release().
+     * Returns nullptr if the ring is empty. Only available with a single consumer.
+     */
+    [[nodiscard]] const T* peek () noexcept requires (!multi_consumer)
+    {
+        const Reservation reservation = reserveForConsumer(1);
+        if (reservation.count == 0)
+        {
+            return nullptr;
+        }
+
+        return slotAt(reservation.position).object();
+    }
+
+    // Destroy the element returned by the last successful peek() and free its slot.
+    void release () noexcept requires (!multi_consumer)
+    {
+        const uint32_t tail = _tail.load(std::memory_order_relaxed);
+
+        std::destroy_at(slotAt(tail).object());
+        publishForProducers({tail, 1});
+    }
+
+    /**
+     * Enqueue as many elements of [first, last) as fit in the ring, in order.
+     * The elements are copied, pass move iterators to move them instead.
+     * Returns the number of enqueued elements.
+     * If constructing an element throws, the elements before it are enqueued. With several producers a constructor
+     * that can throw makes the elements go one by one through emplace, see there, other producers' elements can then
+     * come in between.
+     */
+    template<std::forward_iterator Iterator>
+    uint32_t enqueueBulk (Iterator first, Iterator last)
+        noexcept(std::is_nothrow_constructible_v<T, std::iter_reference_t<Iterator>>)
+    {
+        if constexpr (multi_producer && !std::is_nothrow_constructible_v<T, std::iter_reference_t<Iterator>>)
+        {
+            uint32_t enqueued = 0;
+            for (; first != last && emplace(*first); ++first)
+            {
+                ++enqueued;
+            }
+            return enqueued;
+        }
+        else
+        {
+            const auto requested = static_cast<uint32_t>(std::min<size_t>(std::distance(first, last), capacity()));
+            if (requested == 0)
+            {
+                return 0;
+            }
+
+            const Reservation reservation = reserveForProducer(requested);
+            uint32_t          constructed = 0;
+            const auto        construct   = [this, reservation, &constructed, &first]()
+            {
+                for (; constructed < reservation.count; ++constructed, ++first)
+                {
+                    std::construct_at(static_cast<T*>(slotAt(reservation.position + constructed).raw()), *first);
+                }
+            };
+
+            if constexpr (std::is_nothrow_constructible_v<T, std::iter_reference_t<Iterator>>)
+            {
+                construct();
+            }
+            else
+            {
+                // A single producer publishes the elements built so far, the positions after them stay free.
+                try
+                {
+                    construct();
+                } catch (...)
+                {
+                    publishForConsumers({reservation.position, constructed});
+                    throw;
+                }
+            }
+
+            publishForConsumers(reservation);
+            return reservation.count;
+        }
+    }
+
+    template<typename Range>
+    requires std::ranges::forward_range<Range>
+    uint32_t enqueueBulk (Range&& range)
+        noexcept(std::is_nothrow_constructible_v<T, std::ranges::range_reference_t<Range>>)
+    {
+        return enqueueBulk(std::ranges::begin(range), std::ranges::end(range));
+    }
+
+    /**
+     * Dequeue up to `max_count` elements into `out`, in order.
+     * Returns the number of dequeued elements.
+     */
+    template<std::output_iterator<T> OutputIterator>
+    uint32_t dequeueBulk (OutputIterator out, const uint32_t max_count) noexcept
+    {
+        const uint32_t requested = std::min(max_count, capacity());
+        if (requested == 0)
+        {
+            return 0;
+        }
+
+        const Reservation reservation = reserveForConsumer(requested);
+        for (uint32_t i = 0; i < reservation.count; ++i, ++out)
+        {
+            T* object = slotAt(reservation.position + i).object();
+            *out = std::move(*object);
+            std::destroy_at(object);
+        }
+
+        publishForProducers(reservation);
+        return reservation.count;
+    }
 };
 
 
@@ -0,0 +1,187 @@
+#ifndef RING_STORAGE_H
+#define RING_STORAGE_H
+
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+#include <linux/mempolicy.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+
+/**
+ * Storage policies for the slots of a LockFreeRing.
+ * A policy hands out raw memory for the slot array. The ring constructs and destroys the slots itself.
+ *
+ * A policy that sets `position_independent` makes the ring refer to its slots with an offset from the ring object
+ * instead of a pointer, so a ring and its slots placed in a shared mapping work at any address the mapping gets.
+ */
+
+namespace Concurrency {
+
+template<typename Storage>
+concept RingStorage = requires(Storage storage, void* pointer, size_t bytes, size_t alignment)
+{
+    { storage.allocate(bytes, alignment) } -> std::same_as<void*>;
+    { storage.deallocate(pointer, bytes, alignment) } noexcept;
+};
+
+template<typename Storage>
+concept PositionIndependentRingStorage = RingStorage<Storage> && requires
+{
+    requires Storage::position_independent;
+};
+
+namespace Internal {
+
+/**
+ * Pointer stored as the distance from its own address, it stays valid when the memory holding both the pointer and
+ * the pointee is mapped at another address.
+ */
+template<typename T>
+class OffsetPointer
+{
+private:
+    std::ptrdiff_t _offset;
+
+    [[nodiscard]] std::uintptr_t self () const noexcept
+    {
+        return reinterpret_cast<std::uintptr_t>(this);
+    }
+
+public:
+    OffsetPointer (std::nullptr_t) noexcept
+        : _offset(0)
+    {
+    }
+
+    OffsetPointer (const OffsetPointer&)            = delete;
+    OffsetPointer& operator= (const OffsetPointer&) = delete;
+
+    OffsetPointer& operator= (T* pointer) noexcept
+    {
+        _offset = pointer == nullptr
+                ? 0
+                : static_cast<std::ptrdiff_t>(reinterpret_cast<std::uintptr_t>(pointer) - self());
+        return *this;
+    }
+
+    operator T* () const noexcept
+    {
+        return _offset == 0 ? nullptr : reinterpret_cast<T*>(self() + _offset);
+    }
+};
+
+} // namespace Internal
+
+/**
+ * Aligned operator new. This is the default storage.
+ */
+struct HeapStorage
+{
+    void* allocate (const size_t bytes, const size_t alignment)
+    {
+        return ::operator new(bytes, std::align_val_t{alignment});
+    }
+
+    void deallocate (void* pointer, const size_t, const size_t alignment) noexcept
+    {
+        ::operator delete(pointer, std::align_val_t{alignment});
+    }
+};
+
+/**
+ * Anonymous mmap backed storage, for rings of several MB where TLB misses start to matter.
+ *
+ * - huge_pages: Explicit uses MAP_HUGETLB and needs pages reserved in /proc/sys/vm/nr_hugepages. If none are
+ *   available it falls back to Transparent, which asks for transparent huge pages with madvise(MADV_HUGEPAGE).
+ * - numa_node: preferred NUMA node of the memory, -1 keeps the default policy (the node of the thread that first
+ *   touches a page). This is best effort, the memory is still usable if the kernel refuses the policy.
+ * - prefault: touch every page up front so the ring never page-faults on the fast path.
+ */
+struct MmapStorage
+{
+    enum class HugePages
+    {
+        None,
+        Transparent,
+        Explicit
+    };
+
+    static constexpr size_t page_size      = 4096;
+    static constexpr size_t huge_page_size = 2 * 1024 * 1024;
+
+    HugePages huge_pages = HugePages::None;
+    int       numa_node  = -1;
+    bool      prefault   = true;
+
+    static constexpr size_t alignTo (const size_t number, const size_t align) noexcept
+    {
+        return (number + (align - 1)) & ~(align - 1);
+    }
+
+    [[nodiscard]] size_t mappingSize (const size_t bytes) const noexcept
+    {
+        return alignTo(bytes, huge_pages == HugePages::None ? page_size : huge_page_size);
+    }
+
+    void* allocate (const size_t bytes, const size_t alignment)
+    {
+        if (alignment > page_size)
+        {
+            throw std::bad_alloc();
+        }
+
+        const size_t length  = mappingSize(bytes);
+        void*        pointer = MAP_FAILED;
+
+        if (huge_pages == HugePages::Explicit)
+        {
+            pointer = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        }
+
+        if (pointer == MAP_FAILED)
+        {
+            pointer = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (pointer == MAP_FAILED)
+            {
+                throw std::bad_alloc();
+            }
+
+            if (huge_pages != HugePages::None)
+            {
+                madvise(pointer, length, MADV_HUGEPAGE);
+            }
+        }
+
+        if (numa_node >= 0 && static_cast<size_t>(numa_node) < sizeof(unsigned long) * 8)
+        {
+            const unsigned long node_mask = 1UL << numa_node;
+            syscall(SYS_mbind, pointer, length, MPOL_PREFERRED, &node_mask, sizeof(node_mask) * 8, 0);
+        }
+
+        if (prefault)
+        {
+            // Pages are zero-filled by the kernel, writing a zero to each one only forces the allocation.
+            auto* bytes_pointer = static_cast<volatile std::byte*>(pointer);
+            for (size_t offset = 0; offset < length; offset += page_size)
+            {
+                bytes_pointer[offset] = std::byte{0};
+            }
+        }
+
+        return pointer;
+    }
+
+    void deallocate (void* pointer, const size_t bytes, const size_t) noexcept
+    {
+        munmap(pointer, mappingSize(bytes));
+    }
+};
+
+} // namespace Concurrency
+
+#endif // RING_STORAGE_H
@@ -0,0 +1,259 @@
+#ifndef RING_WAIT_STRATEGY_H
+#define RING_WAIT_STRATEGY_H
+
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <concepts>
+#include <cstdint>
+#include <ctime>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "internal/backoff.h"
+
+
+/**
+ * Wait strategies for the blocking calls of LockFreeRing (enqueueWait/dequeueWait).
+ *
+ * A ring holds one strategy object per direction. The waiting side calls waitUntil() with an attempt function that
+ * retries the operation, the other side calls notify() every time it publishes elements or frees slots. notify() is on
+ * the fast path of every operation, so it must be close to free when nobody waits.
+ */
+
+namespace Concurrency {
+
+using RingWaitClock = std::chrono::steady_clock;
+
+template<typename Strategy>
+concept RingWaitStrategy = requires(Strategy strategy, RingWaitClock::time_point deadline, bool (*attempt)())
+{
+    { strategy.waitUntil(deadline, attempt) } -> std::same_as<bool>;
+    { strategy.notify() } noexcept;
+};
+
+namespace Internal {
+
+// Reading the clock costs more than an attempt, only look at it every few attempts while spinning.
+inline constexpr uint32_t deadline_check_interval = 64;
+
+} // namespace Internal
+
+/**
+ * Retry in a tight loop. Lowest latency, burns a core for as long as it waits.
+ */
+struct BusySpinWait
+{
+    template<typename Attempt>
+    bool waitUntil (const RingWaitClock::time_point deadline, Attempt&& attempt)
+    {
+        for (uint32_t i = 1;; ++i)
+        {
+            if (attempt())
+            {
+                return true;
+            }
+
+            if (i % Internal::deadline_check_interval == 0 && RingWaitClock::now() >= deadline)
+            {
+                return false;
+            }
+            Internal::cpuRelax();
+        }
+    }
+
+    void notify () noexcept
+    {
+    }
+};
+
+/**
+ * Spin for `spin_limit` attempts, then yield the thread to the OS between attempts.
+ */
+struct SpinThenYieldWait
+{
+    uint32_t spin_limit = 1024;
+
+    template<typename Attempt>
+    bool waitUntil (const RingWaitClock::time_point deadline, Attempt&& attempt)
+    {
+        for (uint32_t i = 1;; ++i)
+        {
+            if (attempt())
+            {
+                return true;
+            }
+
+            if (i < spin_limit)
+            {
+                if (i % Internal::deadline_check_interval == 0 && RingWaitClock::now() >= deadline)
+                {
+                    return false;
+                }
+                Internal::cpuRelax();
+            }
+            else
+            {
+                if (RingWaitClock::now() >= deadline)
+                {
+                    return false;
+                }
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    void notify () noexcept
+    {
+    }
+};
+
+/**
+ * Spin for `spin_limit` attempts, yield for `yield_limit` more, then sleep on a futex until notified or the deadline
+ * passes.
+ *
+ * This is an eventcount: a sleeper reads `_epoch`, announces itself in `_sleepers`, retries once more and then sleeps
+ * only if `_epoch` didn't move. notify() bumps the epoch and wakes the futex only when it sees a sleeper, so without
+ * sleepers it costs a fence and a load of a line that nobody writes.
+ * The futex is process private, this strategy can't be used for a ring shared between processes.
+ */
+class ParkingWait
+{
+private:
+    static constexpr uint32_t cache_line_size = 64;
+
+    alignas(cache_line_size) std::atomic<uint32_t> _epoch {0};
+    std::atomic<uint32_t>                          _sleepers {0};
+
+    static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "futex needs a plain 32-bit word");
+
+    void sleep (const uint32_t epoch, const RingWaitClock::time_point deadline) noexcept
+    {
+        const auto remaining = deadline - RingWaitClock::now();
+        if (remaining <= RingWaitClock::duration::zero())
+        {
+            return;
+        }
+
+        const auto     seconds     = std::chrono::duration_cast<std::chrono::seconds>(remaining);
+        const auto     nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(remaining - seconds);
+        const timespec timeout {.tv_sec  = static_cast<time_t>(seconds.count()),
+                                .tv_nsec = static_cast<long>(nanoseconds.count())};
+
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(&_epoch), FUTEX_WAIT_PRIVATE, epoch, &timeout, nullptr, 0);
+    }
+
+    bool wake (const int number_of_threads) noexcept
+    {
+        // Order the publication done by the caller before the sleepers check, pairs with the fence in waitUntil.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (_sleepers.load(std::memory_order_relaxed) == 0)
+        {
+            return false;
+        }
+
+        _epoch.fetch_add(1, std::memory_order_release);
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(&_epoch), FUTEX_WAKE_PRIVATE, number_of_threads, nullptr, nullptr,
+                0);
+        return true;
+    }
+
+public:
+    uint32_t spin_limit  = 256;
+    uint32_t yield_limit = 0;
+
+    template<typename Deadline, typename Attempt>
+    bool waitUntil (Deadline&& deadline, Attempt&& attempt)
+    {
+        return waitUntil(std::forward<Deadline>(deadline), std::forward<Attempt>(attempt), []() noexcept {});
+    }
+
+    /**
+     * on_sleep() is called every time the waiter is about to sleep on the futex, e.g. to count parks.
+     * The deadline can also be a callable returning it, called once the spinning is over: a waiter that usually
+     * succeeds while spinning doesn't read the clock.
+     */
+    template<typename Deadline, typename Attempt, typename OnSleep>
+    bool waitUntil (Deadline&& get_deadline, Attempt&& attempt, OnSleep&& on_sleep)
+    {
+        for (uint32_t i = 1; i < spin_limit; ++i)
+        {
+            if (attempt())
+            {
+                return true;
+            }
+            Internal::cpuRelax();
+        }
+
+        RingWaitClock::time_point deadline;
+        if constexpr (std::is_invocable_r_v<RingWaitClock::time_point, Deadline&>)
+        {
+            deadline = get_deadline();
+        }
+        else
+        {
+            deadline = get_deadline;
+        }
+
+        for (uint32_t i = 0; i < yield_limit; ++i)
+        {
+            if (attempt())
+            {
+                return true;
+            }
+            if (RingWaitClock::now() >= deadline)
+            {
+                return false;
+            }
+            std::this_thread::yield();
+        }
+
+        while (true)
+        {
+            const uint32_t epoch = _epoch.load(std::memory_order_acquire);
+            _sleepers.fetch_add(1, std::memory_order_seq_cst);
+            // Order the sleepers count before the loads of attempt(), pairs with the fence in wake: either attempt()
+            // sees the publication or wake sees the sleeper.
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+
+            if (attempt())
+            {
+                _sleepers.fetch_sub(1, std::memory_order_relaxed);
+                return true;
+            }
+
+            if (RingWaitClock::now() >= deadline)
+            {
+                _sleepers.fetch_sub(1, std::memory_order_relaxed);
+                return false;
+            }
+
+            on_sleep();
+            sleep(epoch, deadline);
+            _sleepers.fetch_sub(1, std::memory_order_relaxed);
+        }
+    }
+
+    void notify () noexcept
+    {
+        wake(INT_MAX);
+    }
+
+    /**
+     * Wake a single sleeper, for waiters that all wait for the same kind of work and any one of them can take it.
+     * Returns false if nobody was sleeping, so a caller with several groups of waiters can try the next group.
+     */
+    bool notifyOne () noexcept
+    {
+        return wake(1);
+    }
+};
+
+} // namespace Concurrency
+
+#endif // RING_WAIT_STRATEGY_H
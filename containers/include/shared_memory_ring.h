@@ -0,0 +1,284 @@
+#ifndef SHARED_MEMORY_RING_H
+#define SHARED_MEMORY_RING_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "lock_free_ring.h"
+
+
+/**
+ * This file contains an interprocess SPSC ring: a LockFreeRing whose indices and slots live in a shared memory
+ * mapping (a named POSIX shared memory object or a memfd), so a producer process and a consumer process exchange
+ * elements without any copy through the kernel.
+ *
+ * Layout of the mapping: a header describing the ring (magic, layout version, slot count, element size and alignment),
+ * then the LockFreeRing object, then its slot array. The ring refers to its slots with an offset, so every process can
+ * map the region at a different address.
+ *
+ * Elements must be trivially copyable since they are shared between processes as raw bytes.
+ */
+
+namespace Concurrency {
+
+namespace Internal {
+
+struct SharedMemoryRingHeader
+{
+    static constexpr uint64_t magic_value    = 0x474E495243504953; // "SIPCRING"
+    static constexpr uint32_t layout_version = 1;
+
+    uint64_t              magic;
+    uint32_t              version;
+    uint32_t              slot_count;
+    uint32_t              element_size;
+    uint32_t              element_alignment;
+    std::atomic<uint32_t> ready;
+};
+
+/**
+ * Hands out the slot area that follows the ring in the shared mapping.
+ */
+struct SharedMemoryStorage
+{
+    static constexpr bool position_independent = true;
+
+    void*  slots;
+    size_t slots_size;
+
+    void* allocate (const size_t bytes, const size_t)
+    {
+        if (bytes > slots_size)
+        {
+            throw std::bad_alloc();
+        }
+        return slots;
+    }
+
+    void deallocate (void*, const size_t, const size_t) noexcept
+    {
+    }
+};
+
+} // namespace Internal
+
+template<typename T, uint32_t N>
+requires std::is_trivially_copyable_v<T>
+class SharedMemoryRing
+{
+public:
+    using Ring = LockFreeRing<T, N, LockFreeRingType::SPSC, Internal::SharedMemoryStorage>;
+
+private:
+    using Header = Internal::SharedMemoryRingHeader;
+
+    static_assert(std::atomic<uint32_t>::is_always_lock_free, "Shared indices need address-free atomics");
+
+    static constexpr size_t alignTo (const size_t number, const size_t align) noexcept
+    {
+        return (number + (align - 1)) & ~(align - 1);
+    }
+
+    static constexpr size_t ring_offset  = alignTo(sizeof(Header), alignof(Ring));
+    static constexpr size_t slots_offset = alignTo(ring_offset + sizeof(Ring), 64);
+    static constexpr size_t slots_size   = sizeof(Internal::LockFreeRingSlot<T, false>) * N;
+    static constexpr size_t mapping_size = slots_offset + slots_size;
+
+    int         _fd;
+    std::byte*  _mapping;
+    std::string _name;
+    bool        _owner;
+
+    SharedMemoryRing (const int fd, std::string name, const bool owner)
+        : _fd(fd), _mapping(nullptr), _name(std::move(name)), _owner(owner)
+    {
+    }
+
+    [[noreturn]] static void throwErrno (const char* what)
+    {
+        throw std::system_error(errno, std::generic_category(), what);
+    }
+
+    Header* header () const noexcept
+    {
+        return std::launder(reinterpret_cast<Header*>(_mapping));
+    }
+
+    void map ()
+    {
+        void* mapping = mmap(nullptr, mapping_size, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0);
+        if (mapping == MAP_FAILED)
+        {
+            throwErrno("mmap");
+        }
+        _mapping = static_cast<std::byte*>(mapping);
+    }
+
+    void initialize ()
+    {
+        if (ftruncate(_fd, mapping_size) != 0)
+        {
+            throwErrno("ftruncate");
+        }
+        map();
+
+        Header* new_header = new (_mapping) Header{.magic             = Header::magic_value,
+                                                   .version           = Header::layout_version,
+                                                   .slot_count        = N,
+                                                   .element_size      = sizeof(T),
+                                                   .element_alignment = alignof(T),
+                                                   .ready             = 0};
+
+        new (_mapping + ring_offset) Ring(Internal::SharedMemoryStorage{_mapping + slots_offset, slots_size});
+        new_header->ready.store(1, std::memory_order_release);
+    }
+
+    void validate ()
+    {
+        struct stat file_stat {};
+        if (fstat(_fd, &file_stat) != 0)
+        {
+            throwErrno("fstat");
+        }
+        if (static_cast<size_t>(file_stat.st_size) < mapping_size)
+        {
+            throw std::runtime_error("SharedMemoryRing: shared memory is smaller than the ring layout");
+        }
+        map();
+
+        const Header* attached_header = header();
+        if (attached_header->ready.load(std::memory_order_acquire) == 0)
+        {
+            throw std::runtime_error("SharedMemoryRing: ring is not initialized yet");
+        }
+        if (attached_header->magic != Header::magic_value || attached_header->version != Header::layout_version)
+        {
+            throw std::runtime_error("SharedMemoryRing: unknown shared memory layout");
+        }
+        if (attached_header->slot_count != N || attached_header->element_size != sizeof(T)
+            || attached_header->element_alignment != alignof(T))
+        {
+            throw std::runtime_error("SharedMemoryRing: ring was created with another element type or size");
+        }
+    }
+
+public:
+    /**
+     * Create a ring in a new named POSIX shared memory object. `name` must start with '/'.
+     * The object is unlinked when the creating SharedMemoryRing is destroyed.
+     */
+    static SharedMemoryRing create (const std::string& name)
+    {
+        const int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, S_IRUSR | S_IWUSR);
+        if (fd < 0)
+        {
+            throwErrno("shm_open");
+        }
+
+        SharedMemoryRing shared_ring(fd, name, true);
+        shared_ring.initialize();
+        return shared_ring;
+    }
+
+    // Attach to a ring created by another process with create(name).
+    static SharedMemoryRing attach (const std::string& name)
+    {
+        const int fd = shm_open(name.c_str(), O_RDWR, 0);
+        if (fd < 0)
+        {
+            throwErrno("shm_open");
+        }
+
+        SharedMemoryRing shared_ring(fd, {}, false);
+        shared_ring.validate();
+        return shared_ring;
+    }
+
+    /**
+     * Create a ring in an anonymous memfd. Share it by inheriting fd() across fork or sending it over a unix socket,
+     * then attach(fd) on the other side.
+     */
+    static SharedMemoryRing createAnonymous ()
+    {
+        const int fd = memfd_create("SharedMemoryRing", MFD_CLOEXEC);
+        if (fd < 0)
+        {
+            throwErrno("memfd_create");
+        }
+
+        SharedMemoryRing shared_ring(fd, {}, true);
+        shared_ring.initialize();
+        return shared_ring;
+    }
+
+    // Attach to a ring through a file descriptor of its memfd or shared memory object. The descriptor is duplicated.
+    static SharedMemoryRing attach (const int fd)
+    {
+        const int own_fd = dup(fd);
+        if (own_fd < 0)
+        {
+            throwErrno("dup");
+        }
+
+        SharedMemoryRing shared_ring(own_fd, {}, false);
+        shared_ring.validate();
+        return shared_ring;
+    }
+
+    SharedMemoryRing (SharedMemoryRing&& other) noexcept
+        : _fd(std::exchange(other._fd, -1)), _mapping(std::exchange(other._mapping, nullptr)),
+          _name(std::move(other._name)), _owner(std::exchange(other._owner, false))
+    {
+    }
+
+    SharedMemoryRing (const SharedMemoryRing&)            = delete;
+    SharedMemoryRing& operator= (const SharedMemoryRing&) = delete;
+    SharedMemoryRing& operator= (SharedMemoryRing&&)      = delete;
+
+    ~SharedMemoryRing ()
+    {
+        if (_mapping != nullptr)
+        {
+            munmap(_mapping, mapping_size);
+        }
+        if (_fd >= 0)
+        {
+            close(_fd);
+        }
+        if (_owner && !_name.empty())
+        {
+            shm_unlink(_name.c_str());
+        }
+    }
+
+    [[nodiscard]] int fd () const noexcept
+    {
+        return _fd;
+    }
+
+    Ring& ring () noexcept
+    {
+        return *std::launder(reinterpret_cast<Ring*>(_mapping + ring_offset));
+    }
+
+    Ring* operator-> () noexcept
+    {
+        return &ring();
+    }
+};
+
+} // namespace Concurrency
+
+#endif // SHARED_MEMORY_RING_H
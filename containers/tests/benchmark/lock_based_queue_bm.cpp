@@ -3,6 +3,7 @@
 #include <atomic>
 
 #include "lock_based_queue.h"
+#include "lock_free_queue.h"
 
 
 static void enqueueDequeueSingleThread(benchmark::State& state) {
@@ -120,3 +121,75 @@ BENCHMARK_DEFINE_F(ConcurrentQueueFixture, EnqueueDequeueMPMC)(benchmark::State&
     }
 }
 BENCHMARK_REGISTER_F(ConcurrentQueueFixture, EnqueueDequeueMPMC)->Threads(4)->Threads(8)->Range(8, 8 << 17);
+
+
+/**
+ * Mutex based ConcurrentQueue against LockFreeQueue with several producers and consumers.
+ * Producers push their share of the elements, consumers pop their share, so every iteration moves exactly
+ * `number_of_elements` elements whatever the split of threads.
+ */
+template<typename Queue>
+class QueueComparisonFixture : public benchmark::Fixture {
+public:
+
+    Queue queue;
+
+    void run(benchmark::State& state, const int producers)
+    {
+        const int  number_of_elements = state.range(0);
+        const int  consumers          = state.threads() - producers;
+        const bool is_producer        = state.thread_index() < producers;
+        const int  share              = number_of_elements / (is_producer ? producers : consumers);
+
+        for (auto _ : state)
+        {
+            if (is_producer)
+            {
+                for (int i = 0; i < share; ++i)
+                {
+                    queue.push(i);
+                }
+            }
+            else
+            {
+                for (int received_elements = 0; received_elements < share;)
+                {
+                    if (queue.pop().has_value())
+                    {
+                        ++received_elements;
+                    }
+                }
+            }
+        }
+
+        state.SetItemsProcessed(state.iterations() * share);
+    }
+};
+
+BENCHMARK_TEMPLATE_DEFINE_F(QueueComparisonFixture, ConcurrentQueueMPSC, Concurrency::ConcurrentQueue<int>)
+(benchmark::State& state)
+{
+    run(state, state.threads() - 1);
+}
+BENCHMARK_REGISTER_F(QueueComparisonFixture, ConcurrentQueueMPSC)->Threads(2)->Threads(4)->Threads(8)->Arg(8 << 10);
+
+BENCHMARK_TEMPLATE_DEFINE_F(QueueComparisonFixture, LockFreeQueueMPSC, Concurrency::LockFreeQueue<int>)
+(benchmark::State& state)
+{
+    run(state, state.threads() - 1);
+}
+BENCHMARK_REGISTER_F(QueueComparisonFixture, LockFreeQueueMPSC)->Threads(2)->Threads(4)->Threads(8)->Arg(8 << 10);
+
+BENCHMARK_TEMPLATE_DEFINE_F(QueueComparisonFixture, ConcurrentQueueMPMC, Concurrency::ConcurrentQueue<int>)
+(benchmark::State& state)
+{
+    run(state, state.threads() / 2);
+}
+BENCHMARK_REGISTER_F(QueueComparisonFixture, ConcurrentQueueMPMC)->Threads(2)->Threads(4)->Threads(8)->Arg(8 << 10);
+
+BENCHMARK_TEMPLATE_DEFINE_F(QueueComparisonFixture, LockFreeQueueMPMC, Concurrency::LockFreeQueue<int>)
+(benchmark::State& state)
+{
+    run(state, state.threads() / 2);
+}
+BENCHMARK_REGISTER_F(QueueComparisonFixture, LockFreeQueueMPMC)->Threads(2)->Threads(4)->Threads(8)->Arg(8 << 10);
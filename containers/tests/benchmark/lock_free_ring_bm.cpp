@@ -1,5 +1,11 @@
 #include <benchmark/benchmark.h>
 
+#include <atomic>
+#include <chrono>
+#include <numeric>
+#include <thread>
+#include <vector>
+
 #include "lock_free_ring.h"
 
 
@@ -103,3 +109,332 @@ BENCHMARK_REGISTER_F(LockFreeRingFixture, EnqueueDequeueSPSC)->Threads(2)->Range
                                                             ->Name("LockFreeRing/EnqueueDequeueSPSC")
                                                             ->ReportAggregatesOnly(true)
                                                             ->Repetitions(100);
+
+
+/**
+ * Producers are the threads with the lowest indices, the rest are consumers.
+ * Every producer enqueues its share of the elements, consumers dequeue until all of them were received.
+ */
+template <Concurrency::LockFreeRingType RING_TYPE>
+class LockFreeRingMultiThreadFixture : public benchmark::Fixture {
+public:
+
+    void SetUp(::benchmark::State& state)
+    {
+        if (state.thread_index() == 0)
+        {
+            while (queue.dequeue().has_value())
+            {
+            }
+            received_elements.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    void TearDown(::benchmark::State&)
+    {
+    }
+
+    void run(benchmark::State& state, const int producers)
+    {
+        const int number_of_elements = state.range(0);
+        if (state.thread_index() < producers)
+        {
+            for (auto _ : state)
+            {
+                for (int i = 0; i < number_of_elements / producers; ++i)
+                {
+                    while (!queue.enqueue(i))
+                    {
+                    }
+                }
+            }
+        }
+        else
+        {
+            const int expected_elements = (number_of_elements / producers) * producers;
+            for (auto _ : state)
+            {
+                while (received_elements.load(std::memory_order_relaxed) < expected_elements)
+                {
+                    if (queue.dequeue().has_value())
+                    {
+                        received_elements.fetch_add(1, std::memory_order_relaxed);
+                    }
+                }
+            }
+        }
+    }
+
+    Concurrency::LockFreeRing<int, 8 << 10, RING_TYPE> queue;
+    std::atomic<int> received_elements = 0;
+};
+
+BENCHMARK_TEMPLATE_DEFINE_F(LockFreeRingMultiThreadFixture, EnqueueDequeueMPSC, Concurrency::LockFreeRingType::MPSC)
+(benchmark::State& state)
+{
+    run(state, state.threads() - 1);
+}
+BENCHMARK_REGISTER_F(LockFreeRingMultiThreadFixture, EnqueueDequeueMPSC)->Threads(2)->Threads(4)->Threads(8)
+                                                            ->Range(8, 8 << 16)->Iterations(1)
+                                                            ->Name("LockFreeRing/EnqueueDequeueMPSC")
+                                                            ->ReportAggregatesOnly(true)
+                                                            ->Repetitions(100);
+
+BENCHMARK_TEMPLATE_DEFINE_F(LockFreeRingMultiThreadFixture, EnqueueDequeueSPMC, Concurrency::LockFreeRingType::SPMC)
+(benchmark::State& state)
+{
+    run(state, 1);
+}
+BENCHMARK_REGISTER_F(LockFreeRingMultiThreadFixture, EnqueueDequeueSPMC)->Threads(2)->Threads(4)->Threads(8)
+                                                            ->Range(8, 8 << 16)->Iterations(1)
+                                                            ->Name("LockFreeRing/EnqueueDequeueSPMC")
+                                                            ->ReportAggregatesOnly(true)
+                                                            ->Repetitions(100);
+
+BENCHMARK_TEMPLATE_DEFINE_F(LockFreeRingMultiThreadFixture, EnqueueDequeueMPMC, Concurrency::LockFreeRingType::MPMC)
+(benchmark::State& state)
+{
+    run(state, state.threads() / 2);
+}
+BENCHMARK_REGISTER_F(LockFreeRingMultiThreadFixture, EnqueueDequeueMPMC)->Threads(2)->Threads(4)->Threads(8)
+                                                            ->Range(8, 8 << 16)->Iterations(1)
+                                                            ->Name("LockFreeRing/EnqueueDequeueMPMC")
+                                                            ->ReportAggregatesOnly(true)
+                                                            ->Repetitions(100);
+
+
+/**
+ * Same as enqueueDequeueSingleThread, but moving the elements in batches of state.range(1) elements.
+ * Batches of 1 element give the single element API baseline.
+ */
+static void enqueueDequeueSingleThreadBulk(benchmark::State& state) {
+
+    Concurrency::LockFreeRing<int, 8 << 10> q;
+    const int number_of_elements = state.range(0);
+    const int batch_size = state.range(1);
+
+    std::vector<int> input(batch_size);
+    std::iota(input.begin(), input.end(), 0);
+    std::vector<int> output(batch_size);
+
+    for (auto _ : state)
+    {
+        for (int i = 0; i < number_of_elements; i += batch_size)
+        {
+            q.enqueueBulk(input);
+        }
+
+        for (int i = 0; i < number_of_elements; i += batch_size)
+        {
+            benchmark::DoNotOptimize(q.dequeueBulk(output.begin(), batch_size));
+            benchmark::DoNotOptimize(output.data());
+        }
+    }
+}
+BENCHMARK(enqueueDequeueSingleThreadBulk)->Name("LockFreeRing/enqueueDequeueSingleThreadBulk")
+                                         ->ArgsProduct({{8 << 10}, {1, 4, 16, 64}});
+
+BENCHMARK_DEFINE_F(LockFreeRingFixture, EnqueueDequeueSPSCBulk)(benchmark::State& state)
+{
+    const int number_of_elements = state.range(0);
+    const int batch_size = state.range(1);
+    switch (state.thread_index())
+    {
+        case 0:
+        {
+            std::vector<int> input(batch_size);
+            std::iota(input.begin(), input.end(), 0);
+            for (auto _ : state)
+            {
+                for (int i = 0; i < number_of_elements; i += batch_size)
+                {
+                    assert(queue.enqueueBulk(input) == static_cast<uint32_t>(batch_size));
+                }
+            }
+            break;
+        }
+
+        case 1:
+            std::vector<int> output(batch_size);
+            int received_elements = 0;
+            for (auto _ : state)
+            {
+                while (received_elements < number_of_elements)
+                {
+                    received_elements += queue.dequeueBulk(output.begin(), batch_size);
+                    benchmark::DoNotOptimize(output.data());
+                }
+            }
+            break;
+    }
+}
+BENCHMARK_REGISTER_F(LockFreeRingFixture, EnqueueDequeueSPSCBulk)->Threads(2)
+                                                            ->ArgsProduct({{8 << 16}, {1, 4, 16, 64}})
+                                                            ->Iterations(1)
+                                                            ->Name("LockFreeRing/EnqueueDequeueSPSCBulk")
+                                                            ->ReportAggregatesOnly(true)
+                                                            ->Repetitions(100);
+
+BENCHMARK_TEMPLATE_DEFINE_F(LockFreeRingMultiThreadFixture, EnqueueDequeueMPMCBulk, Concurrency::LockFreeRingType::MPMC)
+(benchmark::State& state)
+{
+    const int number_of_elements = state.range(0);
+    const int batch_size = state.range(1);
+    const int producers = state.threads() / 2;
+    if (state.thread_index() < producers)
+    {
+        std::vector<int> input(batch_size);
+        std::iota(input.begin(), input.end(), 0);
+        for (auto _ : state)
+        {
+            for (int i = 0; i < number_of_elements / producers; i += batch_size)
+            {
+                auto first = input.begin();
+                while (first != input.end())
+                {
+                    first += queue.enqueueBulk(first, input.end());
+                }
+            }
+        }
+    }
+    else
+    {
+        const int expected_elements = (number_of_elements / producers / batch_size) * batch_size * producers;
+        std::vector<int> output(batch_size);
+        for (auto _ : state)
+        {
+            while (received_elements.load(std::memory_order_relaxed) < expected_elements)
+            {
+                const uint32_t dequeued = queue.dequeueBulk(output.begin(), batch_size);
+                received_elements.fetch_add(static_cast<int>(dequeued), std::memory_order_relaxed);
+                benchmark::DoNotOptimize(output.data());
+            }
+        }
+    }
+}
+BENCHMARK_REGISTER_F(LockFreeRingMultiThreadFixture, EnqueueDequeueMPMCBulk)->Threads(4)->Threads(8)
+                                                            ->ArgsProduct({{8 << 16}, {1, 4, 16, 64}})
+                                                            ->Iterations(1)
+                                                            ->Name("LockFreeRing/EnqueueDequeueMPMCBulk")
+                                                            ->ReportAggregatesOnly(true)
+                                                            ->Repetitions(100);
+
+
+/**
+ * Stream elements through a ring of several MB, with the slots on the heap or on (huge) pages mapped by MmapStorage.
+ */
+template <typename Storage>
+static void enqueueDequeueLargeRing(benchmark::State& state, Storage storage) {
+
+    Concurrency::LockFreeRing<int, Concurrency::dynamic_ring_size, Concurrency::LockFreeRingType::SPSC, Storage>
+            q(8 << 20, storage);
+    const int number_of_elements = state.range(0);
+
+    for (auto _ : state)
+    {
+        for (int i = 0; i < number_of_elements; ++i)
+        {
+            q.enqueue(i);
+        }
+
+        for (int i = 0; i < number_of_elements; ++i)
+        {
+            [[maybe_unused]] std::optional<int> res = q.dequeue();
+            benchmark::DoNotOptimize(res);
+        }
+    }
+}
+BENCHMARK_CAPTURE(enqueueDequeueLargeRing, Heap, Concurrency::HeapStorage{})
+        ->Name("LockFreeRing/enqueueDequeueLargeRing/Heap")->Range(8 << 10, 8 << 20);
+BENCHMARK_CAPTURE(enqueueDequeueLargeRing, Mmap, Concurrency::MmapStorage{})
+        ->Name("LockFreeRing/enqueueDequeueLargeRing/Mmap")->Range(8 << 10, 8 << 20);
+BENCHMARK_CAPTURE(enqueueDequeueLargeRing, MmapHugePages,
+                  Concurrency::MmapStorage{.huge_pages = Concurrency::MmapStorage::HugePages::Explicit})
+        ->Name("LockFreeRing/enqueueDequeueLargeRing/MmapHugePages")->Range(8 << 10, 8 << 20);
+
+
+/**
+ * Wake-up latency of the blocking dequeue: the producer leaves the consumer idle for a while, so it ends up in the
+ * slow path of its wait strategy, then enqueues the current time. The consumer reports how long it took to see it.
+ * The consumer's CPU time shows what waiting costs with each strategy.
+ */
+template <typename WaitStrategy>
+class LockFreeRingWakeUpFixture : public benchmark::Fixture {
+public:
+
+    void SetUp(::benchmark::State& state)
+    {
+        if (state.thread_index() == 0)
+        {
+            while (queue.dequeue().has_value())
+            {
+            }
+        }
+    }
+
+    void TearDown(::benchmark::State&)
+    {
+    }
+
+    static int64_t nowNs()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    void run(benchmark::State& state)
+    {
+        const auto idle_time = std::chrono::microseconds(state.range(0));
+        switch (state.thread_index())
+        {
+            case 0:
+                for (auto _ : state)
+                {
+                    std::this_thread::sleep_for(idle_time);
+                    queue.enqueue(nowNs());
+                }
+                break;
+
+            case 1:
+                int64_t total_latency = 0;
+                for (auto _ : state)
+                {
+                    const std::optional<int64_t> sent = queue.dequeueWait(std::chrono::seconds(1));
+                    total_latency += nowNs() - sent.value_or(nowNs());
+                }
+                state.counters["wake_up_latency_ns"] = benchmark::Counter(static_cast<double>(total_latency),
+                                                                          benchmark::Counter::kAvgIterations);
+                break;
+        }
+    }
+
+    Concurrency::LockFreeRing<int64_t, 1024, Concurrency::LockFreeRingType::SPSC, Concurrency::HeapStorage,
+                              WaitStrategy> queue;
+};
+
+BENCHMARK_TEMPLATE_DEFINE_F(LockFreeRingWakeUpFixture, WakeUpBusySpin, Concurrency::BusySpinWait)
+(benchmark::State& state)
+{
+    run(state);
+}
+BENCHMARK_REGISTER_F(LockFreeRingWakeUpFixture, WakeUpBusySpin)->Name("LockFreeRing/WakeUp/BusySpin")
+                                                               ->Threads(2)->Arg(10)->Arg(100)->Arg(1000)
+                                                               ->Iterations(1000)->UseRealTime();
+
+BENCHMARK_TEMPLATE_DEFINE_F(LockFreeRingWakeUpFixture, WakeUpSpinThenYield, Concurrency::SpinThenYieldWait)
+(benchmark::State& state)
+{
+    run(state);
+}
+BENCHMARK_REGISTER_F(LockFreeRingWakeUpFixture, WakeUpSpinThenYield)->Name("LockFreeRing/WakeUp/SpinThenYield")
+                                                                    ->Threads(2)->Arg(10)->Arg(100)->Arg(1000)
+                                                                    ->Iterations(1000)->UseRealTime();
+
+BENCHMARK_TEMPLATE_DEFINE_F(LockFreeRingWakeUpFixture, WakeUpParking, Concurrency::ParkingWait)
+(benchmark::State& state)
+{
+    run(state);
+}
+BENCHMARK_REGISTER_F(LockFreeRingWakeUpFixture, WakeUpParking)->Name("LockFreeRing/WakeUp/Parking")
+                                                              ->Threads(2)->Arg(10)->Arg(100)->Arg(1000)
+                                                              ->Iterations(1000)->UseRealTime();
@@ -0,0 +1,184 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <future>
+#include <latch>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "lock_free_queue.h"
+
+namespace {
+
+struct EnqueueFuncArgs
+{
+    Concurrency::LockFreeQueue<int>& queue;
+    std::latch&                      latch;
+    int                              min;
+    int                              max;
+};
+
+struct DequeueFuncArgs
+{
+    Concurrency::LockFreeQueue<int>& queue;
+    std::latch&                      latch;
+    std::atomic<int>&                received_elems;
+    int                              number_of_elems;
+};
+
+void enqueueFunc(EnqueueFuncArgs args)
+{
+    args.latch.arrive_and_wait();
+
+    for (int i = args.min; i < args.max; ++i)
+    {
+        ASSERT_TRUE(args.queue.push(i));
+    }
+}
+
+std::vector<int> dequeueFunc(DequeueFuncArgs args)
+{
+    std::vector<int> result;
+    args.latch.arrive_and_wait();
+
+    while (args.received_elems.load(std::memory_order_relaxed) < args.number_of_elems)
+    {
+        std::optional<int> item = args.queue.pop();
+        if (item.has_value())
+        {
+            result.push_back(item.value());
+            args.received_elems.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    return result;
+}
+
+void pressureTest(const int producers, const int consumers, const int elems_per_producer)
+{
+    Concurrency::LockFreeQueue<int> queue;
+    std::latch                      latch(producers + consumers);
+    std::atomic<int>                received_elems = 0;
+    const int                       number_of_elems = producers * elems_per_producer;
+
+    std::vector<std::future<std::vector<int>>> dequeue_futs;
+    for (int i = 0; i < consumers; ++i)
+    {
+        dequeue_futs.push_back(std::async(std::launch::async, dequeueFunc,
+                                          DequeueFuncArgs{.queue           = queue,
+                                                          .latch           = latch,
+                                                          .received_elems  = received_elems,
+                                                          .number_of_elems = number_of_elems}));
+    }
+
+    std::vector<std::jthread> enqueue_threads;
+    for (int i = 0; i < producers; ++i)
+    {
+        enqueue_threads.emplace_back(enqueueFunc, EnqueueFuncArgs{.queue = queue,
+                                                                  .latch = latch,
+                                                                  .min   = i * elems_per_producer,
+                                                                  .max   = (i + 1) * elems_per_producer});
+    }
+
+    std::vector<int> dequeued_nums(number_of_elems, 0);
+    for (auto& dequeue_fut : dequeue_futs)
+    {
+        std::vector<int> dequeue_res = dequeue_fut.get();
+
+        // Elements of one producer are popped in the order they were pushed.
+        std::vector<int> last_of_producer(producers, -1);
+        for (const int element : dequeue_res)
+        {
+            ++dequeued_nums[element];
+            EXPECT_GT(element, last_of_producer[element / elems_per_producer]);
+            last_of_producer[element / elems_per_producer] = element;
+        }
+    }
+
+    EXPECT_TRUE(
+            std::all_of(dequeued_nums.begin(), dequeued_nums.end(), [](const int element) { return element == 1; }));
+    EXPECT_FALSE(queue.pop().has_value());
+}
+
+} // namespace
+
+TEST(LockFreeQueue, QueueIsEmpty_Pop_ReturnNull)
+{
+    Concurrency::LockFreeQueue<int> queue;
+    EXPECT_FALSE(queue.pop().has_value());
+}
+
+TEST(LockFreeQueue, PopItems_OrderIsFIFO)
+{
+    Concurrency::LockFreeQueue<int> queue;
+    queue.push(42);
+    queue.push(11);
+
+    EXPECT_EQ(queue.pop().value(), 42);
+    EXPECT_EQ(queue.pop().value(), 11);
+    EXPECT_FALSE(queue.pop().has_value());
+}
+
+TEST(LockFreeQueue, PushAcrossBlocks_OrderIsFIFO)
+{
+    Concurrency::LockFreeQueue<int> queue;
+
+    for (int round = 0; round < 3; ++round)
+    {
+        for (int i = 0; i < 1000; ++i)
+        {
+            ASSERT_TRUE(queue.push(i));
+        }
+
+        for (int i = 0; i < 1000; ++i)
+        {
+            ASSERT_EQ(queue.pop().value(), i);
+        }
+        EXPECT_FALSE(queue.pop().has_value());
+    }
+}
+
+TEST(LockFreeQueue, MoveOnlyElements)
+{
+    Concurrency::LockFreeQueue<std::unique_ptr<int>> queue;
+    queue.push(std::make_unique<int>(7));
+
+    std::optional<std::unique_ptr<int>> element = queue.pop();
+    ASSERT_TRUE(element.has_value());
+    EXPECT_EQ(**element, 7);
+}
+
+TEST(LockFreeQueue, Destruction_DestroysRemainingElements)
+{
+    auto counter = std::make_shared<int>(0);
+    {
+        Concurrency::LockFreeQueue<std::shared_ptr<int>> queue;
+        for (int i = 0; i < 100; ++i)
+        {
+            queue.push(counter);
+        }
+        for (int i = 0; i < 40; ++i)
+        {
+            queue.pop();
+        }
+        EXPECT_EQ(counter.use_count(), 61);
+    }
+    EXPECT_EQ(counter.use_count(), 1);
+}
+
+TEST(LockFreeQueue, PressureTest)
+{
+    pressureTest(2, 2, 5000);
+}
+
+TEST(LockFreeQueue, PressureTestMPMC)
+{
+    pressureTest(4, 4, 50'000);
+}
+
+TEST(LockFreeQueue, PressureTestMPSC)
+{
+    pressureTest(4, 1, 50'000);
+}
@@ -1,9 +1,16 @@
 #include <gtest/gtest.h>
 #include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <future>
+#include <iterator>
 #include <latch>
+#include <memory>
 #include <numeric>
+#include <optional>
+#include <stdexcept>
 #include <thread>
+#include <vector>
 
 #include "lock_free_ring.h"
 
@@ -11,54 +18,172 @@
 
 namespace {
 
-template <uint32_t RingSize>
+template <typename Ring>
 struct EnqueueFuncArgs
 {
-    Concurrency::LockFreeRing<int, RingSize>&   queue;
+    Ring&                                       queue;
     std::latch&                                 latch;
     int                                         number_of_elems;
+    int                                         first_elem = 0;
 };
 
-template <uint32_t RingSize>
+template <typename Ring>
 struct DequeueFuncArgs
 {
-    Concurrency::LockFreeRing<int, RingSize>&   queue;
+    Ring&                                       queue;
     std::latch&                                 latch;
+    std::atomic<int>&                           received_elems;
+    int                                         number_of_elems;
 };
 
-template <uint32_t RingSize>
-void enqueueFunc(EnqueueFuncArgs<RingSize> args)
+template <typename Ring>
+void enqueueFunc(EnqueueFuncArgs<Ring> args)
 {
     args.latch.arrive_and_wait();
 
     int enqueued_elems = 0;
     while (enqueued_elems < args.number_of_elems)
     {
-        if (args.queue.enqueue(enqueued_elems))
+        if (args.queue.enqueue(args.first_elem + enqueued_elems))
         {
             ++enqueued_elems;
         }
     }
 }
 
-template <uint32_t RingSize>
-std::vector<int> dequeueFunc(DequeueFuncArgs<RingSize> args)
+/**
+ * Dequeue until all the consumers together received `number_of_elems` elements.
+ */
+template <typename Ring>
+std::vector<int> dequeueFunc(DequeueFuncArgs<Ring> args)
 {
     std::vector<int> result;
     args.latch.arrive_and_wait();
 
-    for (size_t i = 0; i < 500'000; ++i)
+    while (args.received_elems.load(std::memory_order_relaxed) < args.number_of_elems)
     {
         std::optional<int> item = args.queue.dequeue();
         if (item.has_value())
         {
             result.push_back(item.value());
+            args.received_elems.fetch_add(1, std::memory_order_relaxed);
         }
     }
 
     return result;
 }
 
+/**
+ * Not default constructible, counts how many times it was constructed, moved and destroyed.
+ */
+struct Message
+{
+    static inline int constructed = 0;
+    static inline int moved       = 0;
+    static inline int destroyed   = 0;
+
+    int              id;
+    std::vector<int> payload;
+
+    Message(const int message_id, const size_t payload_size)
+        : id(message_id), payload(payload_size, message_id)
+    {
+        ++constructed;
+    }
+
+    Message(Message&& other) noexcept
+        : id(other.id), payload(std::move(other.payload))
+    {
+        ++moved;
+    }
+
+    ~Message()
+    {
+        ++destroyed;
+    }
+
+    static void resetCounters()
+    {
+        constructed = 0;
+        moved       = 0;
+        destroyed   = 0;
+    }
+};
+
+// Copying an element marked `throws` fails.
+struct CopyThrows
+{
+    int  value;
+    bool throws;
+
+    CopyThrows(const int value, const bool throws = false) noexcept
+        : value(value), throws(throws)
+    {
+    }
+
+    CopyThrows(const CopyThrows& other)
+        : value(other.value), throws(other.throws)
+    {
+        if (throws)
+        {
+            throw std::runtime_error("copy failed");
+        }
+    }
+
+    CopyThrows(CopyThrows&& other) noexcept = default;
+};
+
+/**
+ * Run `producers` enqueue threads and `consumers` dequeue threads over `ring`, then check that every enqueued number
+ * was received exactly once and that each producer's numbers were received in order by every consumer.
+ */
+template <typename Ring>
+void pressureTest(Ring& ring, const int producers, const int consumers, const int elems_per_producer)
+{
+    const int        num_of_elems = producers * elems_per_producer;
+    std::latch       latch(producers + consumers);
+    std::atomic<int> received_elems = 0;
+
+    std::vector<std::future<std::vector<int>>> dequeue_futs;
+    for (int i = 0; i < consumers; ++i)
+    {
+        dequeue_futs.push_back(std::async(std::launch::async, dequeueFunc<Ring>,
+                DequeueFuncArgs<Ring>{.queue = ring, .latch = latch, .received_elems = received_elems,
+                                      .number_of_elems = num_of_elems}));
+    }
+
+    std::vector<std::jthread> enqueue_threads;
+    for (int i = 0; i < producers; ++i)
+    {
+        enqueue_threads.emplace_back(enqueueFunc<Ring>,
+                EnqueueFuncArgs<Ring>{.queue = ring, .latch = latch, .number_of_elems = elems_per_producer,
+                                      .first_elem = i * elems_per_producer});
+    }
+
+    std::vector<int> dequeued_nums(num_of_elems, 0);
+    size_t           total_dequeued = 0;
+
+    for (auto& dequeue_fut : dequeue_futs)
+    {
+        std::vector<int> dequeue_res = dequeue_fut.get();
+        total_dequeued += dequeue_res.size();
+
+        std::vector<int> last_seen(producers, -1);
+        for (const int element : dequeue_res)
+        {
+            ++dequeued_nums[element];
+
+            const int producer = element / elems_per_producer;
+            EXPECT_LT(last_seen[producer], element);
+            last_seen[producer] = element;
+        }
+    }
+
+    ASSERT_EQ(total_dequeued, static_cast<size_t>(num_of_elems));
+    EXPECT_TRUE(
+            std::all_of(dequeued_nums.begin(), dequeued_nums.end(), [](const int element) { return element == 1; }));
+}
+
 } // namespace
 
 TEST(LockFreeRing, QueueIsEmpty_Pop_ReturnNull)
@@ -84,30 +209,481 @@ TEST(LockFreeRing, PopItems_OrderIsFIFO)
     EXPECT_FALSE(queue.dequeue().has_value());
 }
 
+TEST(LockFreeRing, RingIsFull_DequeueOne_EnqueueSucceeds)
+{
+    Concurrency::LockFreeRing<int, 8> queue;
+
+    for (int i = 0; i < 7; ++i)
+    {
+        ASSERT_TRUE(queue.enqueue(i));
+    }
+    EXPECT_FALSE(queue.enqueue(7));
+
+    // The producer only knows about the freed slot after refreshing its copy of the tail.
+    ASSERT_EQ(queue.dequeue().value(), 0);
+    EXPECT_TRUE(queue.enqueue(7));
+    EXPECT_FALSE(queue.enqueue(8));
+
+    for (int i = 1; i < 8; ++i)
+    {
+        ASSERT_EQ(queue.dequeue().value(), i);
+    }
+    EXPECT_FALSE(queue.dequeue().has_value());
+}
+
 TEST(LockFreeRing, PressureTest)
 {
     Concurrency::LockFreeRing<int, 4096> queue;
-    std::latch                        latch(2);
-    constexpr size_t                  num_of_elems = 50'000;
+    pressureTest(queue, 1, 1, 50'000);
+}
 
-    std::jthread enqueue_thread(enqueueFunc<4096>,
-                                 EnqueueFuncArgs{.queue = queue, .latch = latch, .number_of_elems = num_of_elems});
+template <typename Ring>
+class LockFreeRingTypesTest : public testing::Test
+{
+};
 
-    auto dequeue_fut = std::async(std::launch::async, dequeueFunc<4096>, DequeueFuncArgs{.queue = queue, .latch = latch});
+using SequencedRingTypes = testing::Types<Concurrency::LockFreeRing<int, 8, Concurrency::LockFreeRingType::MPSC>,
+                                          Concurrency::LockFreeRing<int, 8, Concurrency::LockFreeRingType::SPMC>,
+                                          Concurrency::LockFreeRing<int, 8, Concurrency::LockFreeRingType::MPMC>>;
+TYPED_TEST_SUITE(LockFreeRingTypesTest, SequencedRingTypes);
 
-    std::vector<int> dequeued_nums(num_of_elems, 0);
+TYPED_TEST(LockFreeRingTypesTest, QueueIsEmpty_Pop_ReturnNull)
+{
+    TypeParam queue;
+    EXPECT_FALSE(queue.dequeue().has_value());
+}
+
+TYPED_TEST(LockFreeRingTypesTest, FillRing_EveryPositionIsUsable_OrderIsFIFO)
+{
+    TypeParam queue;
+
+    // Go around the ring a few times to exercise the sequence wrap.
+    for (int lap = 0; lap < 3; ++lap)
+    {
+        for (int i = 0; i < 8; ++i)
+        {
+            ASSERT_TRUE(queue.enqueue(lap * 8 + i));
+        }
+        EXPECT_FALSE(queue.enqueue(-1));
+        EXPECT_EQ(queue.size(), 8u);
+
+        for (int i = 0; i < 8; ++i)
+        {
+            auto deq_res = queue.dequeue();
+            ASSERT_TRUE(deq_res.has_value());
+            EXPECT_EQ(deq_res.value(), lap * 8 + i);
+        }
+        EXPECT_FALSE(queue.dequeue().has_value());
+    }
+}
+
+TEST(LockFreeRing, MPSCPressureTest)
+{
+    Concurrency::LockFreeRing<int, 1024, Concurrency::LockFreeRingType::MPSC> queue;
+    pressureTest(queue, 4, 1, 20'000);
+}
+
+TEST(LockFreeRing, SPMCPressureTest)
+{
+    Concurrency::LockFreeRing<int, 1024, Concurrency::LockFreeRingType::SPMC> queue;
+    pressureTest(queue, 1, 4, 50'000);
+}
+
+TEST(LockFreeRing, MPMCPressureTest)
+{
+    Concurrency::LockFreeRing<int, 1024, Concurrency::LockFreeRingType::MPMC> queue;
+    pressureTest(queue, 4, 4, 20'000);
+}
+
+TEST(LockFreeRing, EnqueueBulk_RingAlmostFull_OnlyFreeSpaceIsEnqueued)
+{
+    Concurrency::LockFreeRing<int, 8> queue;
+    const std::vector<int>            input {1, 2, 3, 4, 5};
+
+    EXPECT_EQ(queue.enqueueBulk(input), 5u);
+    EXPECT_EQ(queue.enqueueBulk(input.begin(), input.end()), 2u);
+    EXPECT_EQ(queue.enqueueBulk(input), 0u);
+    EXPECT_EQ(queue.size(), 7u);
 
-    std::vector<int> dequeue_res = dequeue_fut.get();
+    std::vector<int> output;
+    EXPECT_EQ(queue.dequeueBulk(std::back_inserter(output), 3), 3u);
+    EXPECT_EQ(queue.dequeueBulk(std::back_inserter(output), 100), 4u);
+    EXPECT_EQ(queue.dequeueBulk(std::back_inserter(output), 100), 0u);
 
-    ASSERT_EQ(dequeue_res.size(), num_of_elems);
+    EXPECT_EQ(output, (std::vector<int>{1, 2, 3, 4, 5, 1, 2}));
+}
+
+TYPED_TEST(LockFreeRingTypesTest, EnqueueBulk_WrapAround_OrderIsFIFO)
+{
+    TypeParam queue;
+    int       next_input  = 0;
+    int       next_output = 0;
 
-    for (const int element : dequeue_res)
+    for (int round = 0; round < 10; ++round)
     {
-        ++dequeued_nums[element];
+        std::vector<int> input(5);
+        std::iota(input.begin(), input.end(), next_input);
+
+        const uint32_t free_space = queue.freeSpace();
+        const uint32_t enqueued   = queue.enqueueBulk(input);
+        EXPECT_EQ(enqueued, std::min<uint32_t>(5, free_space));
+        next_input += static_cast<int>(enqueued);
+
+        std::vector<int> output;
+        const uint32_t   dequeued = queue.dequeueBulk(std::back_inserter(output), 3);
+        ASSERT_EQ(dequeued, output.size());
+
+        for (const int element : output)
+        {
+            EXPECT_EQ(element, next_output++);
+        }
+    }
+}
+
+TEST(LockFreeRing, MPMCBulkPressureTest)
+{
+    using Ring = Concurrency::LockFreeRing<int, 1024, Concurrency::LockFreeRingType::MPMC>;
+
+    constexpr int    producers          = 4;
+    constexpr int    consumers          = 4;
+    constexpr int    elems_per_producer = 20'000;
+    constexpr int    num_of_elems       = producers * elems_per_producer;
+    Ring             queue;
+    std::atomic<int> received_elems = 0;
+
+    std::vector<std::future<std::vector<int>>> dequeue_futs;
+    for (int i = 0; i < consumers; ++i)
+    {
+        dequeue_futs.push_back(std::async(std::launch::async, [&queue, &received_elems]()
+        {
+            std::vector<int> result;
+            while (received_elems.load(std::memory_order_relaxed) < num_of_elems)
+            {
+                const uint32_t dequeued = queue.dequeueBulk(std::back_inserter(result), 32);
+                received_elems.fetch_add(static_cast<int>(dequeued), std::memory_order_relaxed);
+            }
+            return result;
+        }));
+    }
+
+    std::vector<std::jthread> enqueue_threads;
+    for (int i = 0; i < producers; ++i)
+    {
+        enqueue_threads.emplace_back([&queue, i]()
+        {
+            std::vector<int> input(elems_per_producer);
+            std::iota(input.begin(), input.end(), i * elems_per_producer);
+
+            auto first = input.begin();
+            while (first != input.end())
+            {
+                first += queue.enqueueBulk(first, std::min(first + 32, input.end()));
+            }
+        });
+    }
+
+    std::vector<int> dequeued_nums(num_of_elems, 0);
+    for (auto& dequeue_fut : dequeue_futs)
+    {
+        for (const int element : dequeue_fut.get())
+        {
+            ++dequeued_nums[element];
+        }
     }
 
     EXPECT_TRUE(
             std::all_of(dequeued_nums.begin(), dequeued_nums.end(), [](const int element) { return element == 1; }));
 }
 
+TEST(LockFreeRing, Emplace_ElementIsConstructedInPlace)
+{
+    Message::resetCounters();
+    {
+        Concurrency::LockFreeRing<Message, 4> queue;
+        EXPECT_EQ(Message::constructed, 0);
+
+        ASSERT_TRUE(queue.emplace(1, 16));
+        ASSERT_TRUE(queue.emplace(2, 16));
+        EXPECT_EQ(Message::constructed, 2);
+        EXPECT_EQ(Message::moved, 0);
+
+        const Message* message = queue.peek();
+        ASSERT_NE(message, nullptr);
+        EXPECT_EQ(message->id, 1);
+        EXPECT_EQ(message->payload.size(), 16u);
+        queue.release();
+
+        EXPECT_EQ(Message::moved, 0);
+        EXPECT_EQ(Message::destroyed, 1);
+    }
+
+    // The element left in the ring is destroyed with it.
+    EXPECT_EQ(Message::destroyed, 2);
+}
+
+template <typename Ring>
+class LockFreeRingThrowingElementTest : public testing::Test
+{
+};
+
+using ThrowingElementRingTypes =
+        testing::Types<Concurrency::LockFreeRing<CopyThrows, 8>,
+                       Concurrency::LockFreeRing<CopyThrows, 8, Concurrency::LockFreeRingType::MPSC>,
+                       Concurrency::LockFreeRing<CopyThrows, 8, Concurrency::LockFreeRingType::SPMC>,
+                       Concurrency::LockFreeRing<CopyThrows, 8, Concurrency::LockFreeRingType::MPMC>>;
+TYPED_TEST_SUITE(LockFreeRingThrowingElementTest, ThrowingElementRingTypes);
+
+TYPED_TEST(LockFreeRingThrowingElementTest, EmplaceThrows_NothingIsEnqueued)
+{
+    TypeParam        queue;
+    const CopyThrows failing(1, true);
+    static_assert(!noexcept(queue.emplace(failing)));
+    static_assert(noexcept(queue.emplace(2)));
+
+    EXPECT_THROW(queue.emplace(failing), std::runtime_error);
+    EXPECT_EQ(queue.size(), 0u);
+
+    ASSERT_TRUE(queue.emplace(2));
+    const std::optional<CopyThrows> element = queue.dequeue();
+    ASSERT_TRUE(element.has_value());
+    EXPECT_EQ(element->value, 2);
+    EXPECT_FALSE(queue.dequeue().has_value());
+}
+
+TYPED_TEST(LockFreeRingThrowingElementTest, EnqueueBulkThrows_ElementsBeforeItAreEnqueued)
+{
+    TypeParam               queue;
+    std::vector<CopyThrows> input {1, 2, 3, 4};
+    input[2].throws = true;
+
+    EXPECT_THROW(queue.enqueueBulk(input), std::runtime_error);
+    EXPECT_EQ(queue.size(), 2u);
+
+    // The ring is still usable after the failed construction.
+    EXPECT_EQ(queue.enqueueBulk(input.begin() + 3, input.end()), 1u);
+    std::vector<CopyThrows> output;
+    EXPECT_EQ(queue.dequeueBulk(std::back_inserter(output), 100), 3u);
+    ASSERT_EQ(output.size(), 3u);
+    EXPECT_EQ(output[0].value, 1);
+    EXPECT_EQ(output[1].value, 2);
+    EXPECT_EQ(output[2].value, 4);
+}
+
+TEST(LockFreeRing, ClaimCommit_ElementIsVisibleOnlyAfterCommit)
+{
+    Concurrency::LockFreeRing<Message, 4> queue;
+
+    Message* slot = queue.tryClaim();
+    ASSERT_NE(slot, nullptr);
+    std::construct_at(slot, 42, 8);
+
+    EXPECT_EQ(queue.peek(), nullptr);
+    queue.commit();
+
+    const Message* message = queue.peek();
+    ASSERT_NE(message, nullptr);
+    EXPECT_EQ(message, slot);
+    EXPECT_EQ(message->id, 42);
+    queue.release();
+
+    EXPECT_EQ(queue.peek(), nullptr);
+}
+
+TEST(LockFreeRing, ClaimRingIsFull_ReturnNull)
+{
+    Concurrency::LockFreeRing<Message, 4> queue;
+
+    for (int i = 0; i < 3; ++i)
+    {
+        Message* slot = queue.tryClaim();
+        ASSERT_NE(slot, nullptr);
+        std::construct_at(slot, i, 1);
+        queue.commit();
+    }
+
+    EXPECT_EQ(queue.tryClaim(), nullptr);
+    EXPECT_FALSE(queue.emplace(3, 1));
+
+    auto deq_res = queue.dequeue();
+    ASSERT_TRUE(deq_res.has_value());
+    EXPECT_EQ(deq_res->id, 0);
+    EXPECT_NE(queue.tryClaim(), nullptr);
+}
+
+TEST(LockFreeRing, MPSCPeekRelease_SPMCClaimCommit)
+{
+    Concurrency::LockFreeRing<Message, 4, Concurrency::LockFreeRingType::MPSC> mpsc_queue;
+    ASSERT_TRUE(mpsc_queue.emplace(7, 1));
+    ASSERT_NE(mpsc_queue.peek(), nullptr);
+    EXPECT_EQ(mpsc_queue.peek()->id, 7);
+    mpsc_queue.release();
+    EXPECT_EQ(mpsc_queue.peek(), nullptr);
 
+    Concurrency::LockFreeRing<Message, 4, Concurrency::LockFreeRingType::SPMC> spmc_queue;
+    for (int i = 0; i < 4; ++i)
+    {
+        Message* slot = spmc_queue.tryClaim();
+        ASSERT_NE(slot, nullptr);
+        std::construct_at(slot, i, 1);
+        spmc_queue.commit();
+    }
+    EXPECT_EQ(spmc_queue.tryClaim(), nullptr);
+
+    for (int i = 0; i < 4; ++i)
+    {
+        auto deq_res = spmc_queue.dequeue();
+        ASSERT_TRUE(deq_res.has_value());
+        EXPECT_EQ(deq_res->id, i);
+    }
+}
+
+TEST(LockFreeRing, DynamicSize_SizeIsNotPowerOf2_Throws)
+{
+    using Ring = Concurrency::LockFreeRing<int, Concurrency::dynamic_ring_size>;
+    EXPECT_THROW(Ring(100), std::invalid_argument);
+    EXPECT_THROW(Ring(0), std::invalid_argument);
+}
+
+TEST(LockFreeRing, DynamicSize_CapacityComesFromConstructor)
+{
+    Concurrency::LockFreeRing<int, Concurrency::dynamic_ring_size> queue(16);
+    EXPECT_EQ(queue.capacity(), 15u);
+
+    for (int i = 0; i < 15; ++i)
+    {
+        ASSERT_TRUE(queue.enqueue(i));
+    }
+    EXPECT_FALSE(queue.enqueue(15));
+
+    for (int i = 0; i < 15; ++i)
+    {
+        ASSERT_EQ(queue.dequeue().value(), i);
+    }
+}
+
+TEST(LockFreeRing, MmapStorage_HugePages_RingIsUsable)
+{
+    using Storage = Concurrency::MmapStorage;
+    using Ring    = Concurrency::LockFreeRing<int, Concurrency::dynamic_ring_size, Concurrency::LockFreeRingType::MPMC,
+                                              Storage>;
+
+    // Explicit huge pages fall back to transparent ones when none are reserved on the machine.
+    for (const auto huge_pages : {Storage::HugePages::None, Storage::HugePages::Transparent,
+                                  Storage::HugePages::Explicit})
+    {
+        Ring queue(1 << 20, Storage{.huge_pages = huge_pages, .numa_node = 0});
+        EXPECT_EQ(queue.capacity(), 1u << 20);
+
+        const std::vector<int> input(4096, 42);
+        for (int i = 0; i < 256; ++i)
+        {
+            ASSERT_EQ(queue.enqueueBulk(input), 4096u);
+        }
+        EXPECT_EQ(queue.enqueueBulk(input), 0u);
+
+        std::vector<int> output;
+        EXPECT_EQ(queue.dequeueBulk(std::back_inserter(output), 1 << 20), 1u << 20);
+        EXPECT_TRUE(std::all_of(output.begin(), output.end(), [](const int element) { return element == 42; }));
+    }
+}
+
+TEST(LockFreeRing, DynamicSizePressureTest)
+{
+    Concurrency::LockFreeRing<int, Concurrency::dynamic_ring_size, Concurrency::LockFreeRingType::MPSC,
+                              Concurrency::MmapStorage> queue(1024);
+    pressureTest(queue, 4, 1, 20'000);
+}
+
+template <typename WaitStrategy>
+class LockFreeRingWaitTest : public testing::Test
+{
+public:
+    template <uint32_t RingSize = 8>
+    using Ring = Concurrency::LockFreeRing<int, RingSize, Concurrency::LockFreeRingType::SPSC,
+                                           Concurrency::HeapStorage, WaitStrategy>;
+};
+
+using WaitStrategies = testing::Types<Concurrency::BusySpinWait, Concurrency::SpinThenYieldWait,
+                                      Concurrency::ParkingWait>;
+TYPED_TEST_SUITE(LockFreeRingWaitTest, WaitStrategies);
+
+TYPED_TEST(LockFreeRingWaitTest, DequeueWait_RingStaysEmpty_TimesOut)
+{
+    typename TestFixture::template Ring<> queue;
+
+    const auto start = std::chrono::steady_clock::now();
+    EXPECT_FALSE(queue.dequeueWait(std::chrono::milliseconds(50)).has_value());
+    EXPECT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(50));
+}
+
+TYPED_TEST(LockFreeRingWaitTest, DequeueWait_ProducerEnqueuesLater_ElementIsReceived)
+{
+    typename TestFixture::template Ring<> queue;
+
+    std::jthread producer([&queue]()
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        queue.enqueue(42);
+    });
+
+    const auto deq_res = queue.dequeueWait(std::chrono::seconds(5));
+    ASSERT_TRUE(deq_res.has_value());
+    EXPECT_EQ(deq_res.value(), 42);
+}
+
+TYPED_TEST(LockFreeRingWaitTest, EnqueueWait_RingIsFull_WaitsForConsumer)
+{
+    typename TestFixture::template Ring<> queue;
+    for (int i = 0; i < 7; ++i)
+    {
+        ASSERT_TRUE(queue.enqueue(i));
+    }
+    EXPECT_FALSE(queue.enqueueWait(7, std::chrono::milliseconds(10)));
+
+    std::jthread consumer([&queue]()
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        queue.dequeue();
+    });
+
+    EXPECT_TRUE(queue.enqueueWait(7, std::chrono::seconds(5)));
+}
+
+TYPED_TEST(LockFreeRingWaitTest, PressureTest)
+{
+    typename TestFixture::template Ring<1024> queue;
+    constexpr int                             num_of_elems = 20'000;
+
+    std::jthread producer([&queue]()
+    {
+        for (int i = 0; i < num_of_elems; ++i)
+        {
+            ASSERT_TRUE(queue.enqueueWait(i, std::chrono::seconds(5)));
+        }
+    });
+
+    for (int i = 0; i < num_of_elems; ++i)
+    {
+        const auto deq_res = queue.dequeueWait(std::chrono::seconds(5));
+        ASSERT_TRUE(deq_res.has_value());
+        ASSERT_EQ(deq_res.value(), i);
+    }
+}
+
+TEST(ParkingWait, DeadlineCallable_OnlyAskedOnceDoneSpinning)
+{
+    Concurrency::ParkingWait wait;
+    int                      deadline_calls = 0;
+    const auto deadline = [&deadline_calls]()
+    {
+        ++deadline_calls;
+        return Concurrency::RingWaitClock::now() + std::chrono::milliseconds(10);
+    };
+
+    int attempts = 0;
+    EXPECT_TRUE(wait.waitUntil(deadline, [&attempts]() { return ++attempts == 2; }));
+    EXPECT_EQ(deadline_calls, 0);
+
+    EXPECT_FALSE(wait.waitUntil(deadline, []() { return false; }));
+    EXPECT_EQ(deadline_calls, 1);
+}
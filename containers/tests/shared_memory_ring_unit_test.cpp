@@ -0,0 +1,147 @@
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "shared_memory_ring.h"
+
+
+namespace {
+
+struct Message
+{
+    uint32_t sequence;
+    uint32_t checksum;
+    char     payload[56];
+};
+
+constexpr uint32_t ring_size       = 1024;
+constexpr uint32_t number_of_elems = 200'000;
+
+using SharedRing = Concurrency::SharedMemoryRing<Message, ring_size>;
+
+std::string uniqueName(const char* test_name)
+{
+    return std::string("/concurrency_") + test_name + "_" + std::to_string(getpid());
+}
+
+Message makeMessage(const uint32_t sequence)
+{
+    Message message {.sequence = sequence, .checksum = sequence * 2654435761u, .payload = {}};
+    message.payload[sequence % sizeof(message.payload)] = static_cast<char>(sequence);
+    return message;
+}
+
+/**
+ * Runs in the child process: produce every message, then exit without returning into gtest.
+ */
+[[noreturn]] void produceAndExit(SharedRing& shared_ring)
+{
+    for (uint32_t i = 0; i < number_of_elems;)
+    {
+        if (shared_ring->emplace(makeMessage(i)))
+        {
+            ++i;
+        }
+    }
+    _exit(0);
+}
+
+/**
+ * Consume in the parent process and check that messages arrive complete and in order.
+ */
+void consumeAndCheck(SharedRing& shared_ring, const pid_t producer)
+{
+    uint32_t expected = 0;
+    while (expected < number_of_elems)
+    {
+        const Message* message = shared_ring->peek();
+        if (message == nullptr)
+        {
+            continue;
+        }
+
+        const Message reference     = makeMessage(expected);
+        const size_t  payload_index = expected % sizeof(reference.payload);
+        ASSERT_EQ(message->sequence, expected);
+        ASSERT_EQ(message->checksum, reference.checksum);
+        ASSERT_EQ(message->payload[payload_index], reference.payload[payload_index]);
+
+        shared_ring->release();
+        ++expected;
+    }
+
+    int status = 0;
+    ASSERT_EQ(waitpid(producer, &status, 0), producer);
+    EXPECT_TRUE(WIFEXITED(status));
+    EXPECT_EQ(WEXITSTATUS(status), 0);
+    EXPECT_EQ(shared_ring->peek(), nullptr);
+}
+
+} // namespace
+
+TEST(SharedMemoryRing, CreateAndAttachByName_RingIsShared)
+{
+    const std::string name = uniqueName("attach");
+    SharedRing        creator = SharedRing::create(name);
+    SharedRing        attached = SharedRing::attach(name);
+
+    ASSERT_TRUE(creator->enqueue(makeMessage(7)));
+
+    auto deq_res = attached->dequeue();
+    ASSERT_TRUE(deq_res.has_value());
+    EXPECT_EQ(deq_res->sequence, 7u);
+    EXPECT_FALSE(creator->dequeue().has_value());
+}
+
+TEST(SharedMemoryRing, CreateTwice_Throws)
+{
+    const std::string name = uniqueName("twice");
+    SharedRing        creator = SharedRing::create(name);
+
+    EXPECT_THROW(SharedRing::create(name), std::system_error);
+}
+
+TEST(SharedMemoryRing, AttachWithOtherLayout_Throws)
+{
+    const std::string name = uniqueName("layout");
+    SharedRing        creator = SharedRing::create(name);
+
+    EXPECT_THROW((Concurrency::SharedMemoryRing<Message, ring_size / 2>::attach(name)), std::runtime_error);
+    EXPECT_THROW((Concurrency::SharedMemoryRing<uint64_t, ring_size>::attach(name)), std::runtime_error);
+    EXPECT_THROW(SharedRing::attach(uniqueName("missing")), std::system_error);
+}
+
+TEST(SharedMemoryRing, TwoProcessesByName)
+{
+    const std::string name = uniqueName("processes");
+    SharedRing        consumer_ring = SharedRing::create(name);
+
+    const pid_t producer = fork();
+    ASSERT_GE(producer, 0);
+    if (producer == 0)
+    {
+        SharedRing producer_ring = SharedRing::attach(name);
+        produceAndExit(producer_ring);
+    }
+
+    consumeAndCheck(consumer_ring, producer);
+}
+
+TEST(SharedMemoryRing, TwoProcessesByMemfd)
+{
+    SharedRing consumer_ring = SharedRing::createAnonymous();
+
+    const pid_t producer = fork();
+    ASSERT_GE(producer, 0);
+    if (producer == 0)
+    {
+        SharedRing producer_ring = SharedRing::attach(consumer_ring.fd());
+        produceAndExit(producer_ring);
+    }
+
+    consumeAndCheck(consumer_ring, producer);
+}
@@ -0,0 +1,423 @@
+#ifndef COROUTINE_TASK_H
+#define COROUTINE_TASK_H
+
+#include <atomic>
+#include <condition_variable>
+#include <coroutine>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <utility>
+
+#include "threadpool.h"
+
+namespace Concurrency {
+
+template<typename T = void>
+class Task;
+
+namespace Internal {
+
+/**
+ * Who resumes whom when a Task completes. `_continuation` holds the coroutine awaiting the task, or one of the two
+ * markers: the task is done, or its Task was destroyed while it was still running and it destroys itself at the end.
+ * Awaiting a started task and completing it race on the exchange, whoever comes second resumes the awaiting coroutine.
+ */
+class TaskPromiseBase
+{
+private:
+    static inline char done_marker     = 0;
+    static inline char detached_marker = 0;
+
+    std::atomic<void*> _continuation {nullptr};
+    std::exception_ptr _exception;
+
+protected:
+    void rethrowIfFailed () const
+    {
+        if (_exception)
+        {
+            std::rethrow_exception(_exception);
+        }
+    }
+
+public:
+    struct FinalAwaiter
+    {
+        bool await_ready () const noexcept
+        {
+            return false;
+        }
+
+        // Symmetric transfer: the awaiting coroutine runs on this thread, without growing the stack.
+        template<typename Promise>
+        std::coroutine_handle<> await_suspend (std::coroutine_handle<Promise> handle) noexcept
+        {
+            TaskPromiseBase& promise  = handle.promise();
+            void* const      awaiting = promise._continuation.exchange(&done_marker, std::memory_order_acq_rel);
+            if (awaiting == &detached_marker)
+            {
+                handle.destroy();
+            }
+            else if (awaiting != nullptr)
+            {
+                return std::coroutine_handle<>::from_address(awaiting);
+            }
+            return std::noop_coroutine();
+        }
+
+        void await_resume () const noexcept
+        {
+        }
+    };
+
+    std::suspend_always initial_suspend () const noexcept
+    {
+        return {};
+    }
+
+    FinalAwaiter final_suspend () const noexcept
+    {
+        return {};
+    }
+
+    void unhandled_exception () noexcept
+    {
+        _exception = std::current_exception();
+    }
+
+    // Returns false if the task is already done, the caller then continues without suspending.
+    bool setContinuation (const std::coroutine_handle<> awaiting) noexcept
+    {
+        void* expected = nullptr;
+        return _continuation.compare_exchange_strong(expected, awaiting.address(), std::memory_order_acq_rel);
+    }
+
+    [[nodiscard]] bool isDone () const noexcept
+    {
+        return _continuation.load(std::memory_order_acquire) == &done_marker;
+    }
+
+    // Returns true if the task is done and the caller must destroy it, otherwise it destroys itself when done.
+    bool detach () noexcept
+    {
+        return _continuation.exchange(&detached_marker, std::memory_order_acq_rel) == &done_marker;
+    }
+};
+
+template<typename T>
+class TaskPromise : public TaskPromiseBase
+{
+private:
+    std::optional<T> _value;
+
+public:
+    Task<T> get_return_object () noexcept;
+
+    template<typename Value>
+    void return_value (Value&& value)
+    {
+        _value.emplace(std::forward<Value>(value));
+    }
+
+    T takeResult ()
+    {
+        rethrowIfFailed();
+        return std::move(*_value);
+    }
+};
+
+template<>
+class TaskPromise<void> : public TaskPromiseBase
+{
+public:
+    Task<void> get_return_object () noexcept;
+
+    void return_void () const noexcept
+    {
+    }
+
+    void takeResult () const
+    {
+        rethrowIfFailed();
+    }
+};
+
+} // namespace Internal
+
+/**
+ * Lazy coroutine returning T. Nothing runs until the task is awaited or started.
+ *
+ * `co_await task` runs the task on the awaiting thread until its first suspension, typically
+ * `co_await thread_pool.schedule()`, and resumes the awaiting coroutine on whichever thread completes the task, without
+ * blocking any thread meanwhile. start() begins a task without waiting for it, to run several tasks at once and
+ * await them later. A started task that is destroyed unawaited finishes on its own and frees itself.
+ */
+template<typename T>
+class [[nodiscard]] Task
+{
+public:
+    using promise_type = Internal::TaskPromise<T>;
+
+private:
+    std::coroutine_handle<promise_type> _handle;
+    bool                                _started = false;
+
+    friend promise_type;
+
+    explicit Task (const std::coroutine_handle<promise_type> handle) noexcept
+        : _handle(handle)
+    {
+    }
+
+    // Waits for the task without taking its result.
+    struct DoneAwaiter
+    {
+        Task& task;
+
+        bool await_ready () const noexcept
+        {
+            return task.isDone();
+        }
+
+        std::coroutine_handle<> await_suspend (const std::coroutine_handle<> awaiting) noexcept
+        {
+            if (!task._started)
+            {
+                // Nothing else can complete the task yet, start it right here.
+                task._started = true;
+                task._handle.promise().setContinuation(awaiting);
+                return task._handle;
+            }
+
+            if (task._handle.promise().setContinuation(awaiting))
+            {
+                return std::noop_coroutine();
+            }
+            // Completed meanwhile.
+            return awaiting;
+        }
+
+        void await_resume () const noexcept
+        {
+        }
+    };
+
+    struct Awaiter : DoneAwaiter
+    {
+        T await_resume ()
+        {
+            return this->task.result();
+        }
+    };
+
+public:
+    Task (Task&& other) noexcept
+        : _handle(std::exchange(other._handle, nullptr)), _started(other._started)
+    {
+    }
+
+    Task& operator= (Task&& other) noexcept
+    {
+        if (this != &other)
+        {
+            release();
+            _handle  = std::exchange(other._handle, nullptr);
+            _started = other._started;
+        }
+        return *this;
+    }
+
+    Task (const Task&)            = delete;
+    Task& operator= (const Task&) = delete;
+
+    ~Task ()
+    {
+        release();
+    }
+
+    // Run the task on this thread until it first suspends.
+    void start ()
+    {
+        if (!_started)
+        {
+            _started = true;
+            _handle.resume();
+        }
+    }
+
+    [[nodiscard]] bool isDone () const noexcept
+    {
+        return _started && _handle.promise().isDone();
+    }
+
+    Awaiter operator co_await () & noexcept
+    {
+        return Awaiter {{*this}};
+    }
+
+    Awaiter operator co_await () && noexcept
+    {
+        return Awaiter {{*this}};
+    }
+
+    // `co_await task.whenDone()` waits like `co_await task` but leaves the result, or the exception, in the task.
+    DoneAwaiter whenDone () noexcept
+    {
+        return DoneAwaiter {*this};
+    }
+
+    // Only once done, and only once. Rethrows the exception that ended the task.
+    T result ()
+    {
+        return _handle.promise().takeResult();
+    }
+
+private:
+    void release () noexcept
+    {
+        if (!_handle)
+        {
+            return;
+        }
+
+        if (!_started || _handle.promise().detach())
+        {
+            _handle.destroy();
+        }
+        _handle = nullptr;
+    }
+};
+
+namespace Internal {
+
+template<typename T>
+Task<T> TaskPromise<T>::get_return_object () noexcept
+{
+    return Task<T>(std::coroutine_handle<TaskPromise<T>>::from_promise(*this));
+}
+
+inline Task<void> TaskPromise<void>::get_return_object () noexcept
+{
+    return Task<void>(std::coroutine_handle<TaskPromise<void>>::from_promise(*this));
+}
+
+/**
+ * Coroutine that awaits a task for syncWait and signals the waiting thread from its final suspension point, once it
+ * doesn't touch its frame anymore. The signal is taken under a mutex so the waiting thread, which owns the signal,
+ * can't return before the signalling thread is done with it.
+ */
+class SyncWaitTask
+{
+public:
+    struct Signal
+    {
+        std::mutex              mutex;
+        std::condition_variable condition;
+        std::atomic<bool>       done {false};
+    };
+
+    struct promise_type
+    {
+        Signal* signal = nullptr;
+
+        SyncWaitTask get_return_object () noexcept
+        {
+            return SyncWaitTask(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+
+        std::suspend_always initial_suspend () const noexcept
+        {
+            return {};
+        }
+
+        auto final_suspend () const noexcept
+        {
+            struct SignalAwaiter
+            {
+                bool await_ready () const noexcept
+                {
+                    return false;
+                }
+
+                void await_suspend (const std::coroutine_handle<promise_type> handle) const noexcept
+                {
+                    Signal& signal = *handle.promise().signal;
+                    std::lock_guard lock(signal.mutex);
+                    signal.done.store(true, std::memory_order_release);
+                    signal.condition.notify_all();
+                }
+
+                void await_resume () const noexcept
+                {
+                }
+            };
+            return SignalAwaiter {};
+        }
+
+        void return_void () const noexcept
+        {
+        }
+
+        void unhandled_exception () const noexcept
+        {
+        }
+    };
+
+    explicit SyncWaitTask (const std::coroutine_handle<promise_type> handle) noexcept
+        : _handle(handle)
+    {
+    }
+
+    SyncWaitTask (const SyncWaitTask&)            = delete;
+    SyncWaitTask& operator= (const SyncWaitTask&) = delete;
+
+    ~SyncWaitTask ()
+    {
+        _handle.destroy();
+    }
+
+    void start (Signal& signal)
+    {
+        _handle.promise().signal = &signal;
+        _handle.resume();
+    }
+
+private:
+    std::coroutine_handle<promise_type> _handle;
+};
+
+template<typename T>
+SyncWaitTask awaitDone (Task<T>& task)
+{
+    co_await task.whenDone();
+}
+
+} // namespace Internal
+
+/**
+ * Run a task to completion from code that isn't a coroutine and return its result, or rethrow its exception.
+ * The calling thread runs pending tasks of thread_pool while the task isn't done, so it can be called from a task of
+ * the pool.
+ */
+template<typename T>
+T syncWait (ThreadPool& thread_pool, Task<T> task)
+{
+    Internal::SyncWaitTask::Signal signal;
+    Internal::SyncWaitTask         waiter = Internal::awaitDone(task);
+    waiter.start(signal);
+
+    thread_pool.helpUntil([&signal]() { return signal.done.load(std::memory_order_acquire); }, [&signal]()
+    {
+        std::unique_lock lock(signal.mutex);
+        signal.condition.wait(lock, [&signal]() { return signal.done.load(std::memory_order_acquire); });
+    });
+
+    // The signalling thread may still hold the lock.
+    std::lock_guard lock(signal.mutex);
+    return task.result();
+}
+
+} // namespace Concurrency
+
+#endif // COROUTINE_TASK_H
@@ -0,0 +1,259 @@
+#ifndef CPU_TOPOLOGY_H
+#define CPU_TOPOLOGY_H
+
+#include <algorithm>
+#include <charconv>
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include <pthread.h>
+#include <sched.h>
+
+namespace Concurrency {
+
+/**
+ * CPUs grouped into domains that share memory or a last level cache, e.g. NUMA nodes on a multi-socket machine.
+ * A ThreadPool built from a topology runs one worker per CPU, keeps the workers of a domain together, and steals
+ * within a domain before it steals across domains.
+ */
+struct CpuTopology
+{
+    std::vector<std::vector<int>> domains;
+    // Pin every worker to its CPU. Without pinning the workers are still grouped, but the OS can move them.
+    bool                          pin_workers = true;
+
+    [[nodiscard]] size_t numberOfCpus () const noexcept
+    {
+        size_t number_of_cpus = 0;
+        for (const std::vector<int>& domain : domains)
+        {
+            number_of_cpus += domain.size();
+        }
+        return number_of_cpus;
+    }
+
+    /**
+     * Parse a Linux cpu list, as in /sys and `taskset -c`: "0-3,8,10-11". Whitespace around the list is ignored,
+     * an empty list is valid. Returns std::nullopt if the list is malformed or has a CPU not below CPU_SETSIZE, which
+     * can't be pinned to.
+     */
+    static std::optional<std::vector<int>> parseCpuList (std::string_view cpu_list)
+    {
+        constexpr std::string_view whitespace = " \t\n";
+        const size_t               first      = cpu_list.find_first_not_of(whitespace);
+        if (first == std::string_view::npos)
+        {
+            return std::vector<int>{};
+        }
+        cpu_list = cpu_list.substr(first, cpu_list.find_last_not_of(whitespace) - first + 1);
+
+        std::vector<int> cpus;
+        while (true)
+        {
+            const size_t           comma = cpu_list.find(',');
+            const std::string_view item  = cpu_list.substr(0, comma);
+
+            const size_t dash        = item.find('-');
+            const auto   range_first = parseCpu(item.substr(0, dash));
+            const auto   range_last  = dash == std::string_view::npos ? range_first : parseCpu(item.substr(dash + 1));
+            if (!range_first.has_value() || !range_last.has_value() || range_last.value() < range_first.value())
+            {
+                return std::nullopt;
+            }
+            // Never steps past range_last, whatever its value.
+            for (int cpu = range_first.value(); cpu < range_last.value(); ++cpu)
+            {
+                cpus.push_back(cpu);
+            }
+            cpus.push_back(range_last.value());
+
+            if (comma == std::string_view::npos)
+            {
+                return cpus;
+            }
+            cpu_list.remove_prefix(comma + 1);
+        }
+    }
+
+    // A single domain with the CPUs of the list. Returns std::nullopt if the list is malformed or empty.
+    static std::optional<CpuTopology> fromCpuList (const std::string_view cpu_list)
+    {
+        std::optional<std::vector<int>> cpus = parseCpuList(cpu_list);
+        if (!cpus.has_value() || cpus.value().empty())
+        {
+            return std::nullopt;
+        }
+        return CpuTopology{.domains = {std::move(cpus.value())}};
+    }
+
+    /**
+     * The CPUs this process may run on, grouped by NUMA node, or by L3 cache if there is a single node.
+     * Falls back to a single domain when /sys can't be read.
+     */
+    static CpuTopology discover ()
+    {
+        const std::vector<int> allowed = allowedCpus();
+
+        CpuTopology topology {.domains = numaNodes(allowed)};
+        if (topology.domains.size() < 2)
+        {
+            topology.domains = l3Domains(allowed);
+        }
+        if (topology.domains.size() < 2)
+        {
+            topology.domains = {allowed};
+        }
+        return topology;
+    }
+
+    // The CPUs in the affinity mask of the calling thread.
+    static std::vector<int> allowedCpus ()
+    {
+        std::vector<int> cpus;
+
+        cpu_set_t cpu_set;
+        CPU_ZERO(&cpu_set);
+        if (sched_getaffinity(0, sizeof(cpu_set), &cpu_set) == 0)
+        {
+            for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+            {
+                if (CPU_ISSET(cpu, &cpu_set))
+                {
+                    cpus.push_back(cpu);
+                }
+            }
+        }
+
+        if (cpus.empty())
+        {
+            for (int cpu = 0; cpu < static_cast<int>(std::max(std::thread::hardware_concurrency(), 1u)); ++cpu)
+            {
+                cpus.push_back(cpu);
+            }
+        }
+        return cpus;
+    }
+
+    // Restrict the calling thread to one CPU. Returns false if the OS refused.
+    static bool pinCurrentThread (const int cpu) noexcept
+    {
+        cpu_set_t cpu_set;
+        CPU_ZERO(&cpu_set);
+        CPU_SET(cpu, &cpu_set);
+        return pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set) == 0;
+    }
+
+private:
+    static std::optional<int> parseCpu (const std::string_view text) noexcept
+    {
+        int        cpu = 0;
+        const auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), cpu);
+        if (error != std::errc() || end != text.data() + text.size() || cpu < 0 || cpu >= CPU_SETSIZE)
+        {
+            return std::nullopt;
+        }
+        return cpu;
+    }
+
+    static std::optional<std::vector<int>> readCpuList (const std::filesystem::path& path)
+    {
+        std::ifstream file(path);
+        std::string   cpu_list;
+        if (!file || !std::getline(file, cpu_list))
+        {
+            return std::nullopt;
+        }
+        return parseCpuList(cpu_list);
+    }
+
+    // Keep the allowed CPUs of every group and drop the groups left empty.
+    static std::vector<std::vector<int>> restrictTo (const std::vector<std::vector<int>>& groups,
+                                                     const std::vector<int>&              allowed)
+    {
+        std::vector<std::vector<int>> domains;
+        for (const std::vector<int>& group : groups)
+        {
+            std::vector<int> domain;
+            std::copy_if(group.begin(), group.end(), std::back_inserter(domain), [&allowed](const int cpu)
+            {
+                return std::find(allowed.begin(), allowed.end(), cpu) != allowed.end();
+            });
+
+            if (!domain.empty())
+            {
+                domains.push_back(std::move(domain));
+            }
+        }
+        return domains;
+    }
+
+    static std::vector<std::vector<int>> numaNodes (const std::vector<int>& allowed)
+    {
+        constexpr std::string_view node_prefix = "node";
+
+        // Ordered by node number.
+        std::map<int, std::vector<int>> nodes;
+        std::error_code                 error;
+        for (const auto& entry : std::filesystem::directory_iterator("/sys/devices/system/node", error))
+        {
+            const std::string name = entry.path().filename().string();
+            if (!name.starts_with(node_prefix))
+            {
+                continue;
+            }
+
+            const std::optional<int>              node = parseCpu(std::string_view(name).substr(node_prefix.size()));
+            const std::optional<std::vector<int>> cpus = readCpuList(entry.path() / "cpulist");
+            if (node.has_value() && cpus.has_value())
+            {
+                nodes[node.value()] = cpus.value();
+            }
+        }
+
+        std::vector<std::vector<int>> groups;
+        for (auto& [node, cpus] : nodes)
+        {
+            groups.push_back(std::move(cpus));
+        }
+        return restrictTo(groups, allowed);
+    }
+
+    static std::vector<std::vector<int>> l3Domains (const std::vector<int>& allowed)
+    {
+        std::vector<std::vector<int>> groups;
+        for (const int cpu : allowed)
+        {
+            const std::filesystem::path cache = "/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/cache";
+            std::error_code             error;
+            for (const auto& entry : std::filesystem::directory_iterator(cache, error))
+            {
+                std::ifstream level_file(entry.path() / "level");
+                int           level = 0;
+                if (!(level_file >> level) || level != 3)
+                {
+                    continue;
+                }
+
+                std::optional<std::vector<int>> shared = readCpuList(entry.path() / "shared_cpu_list");
+                if (shared.has_value() && std::find(groups.begin(), groups.end(), shared.value()) == groups.end())
+                {
+                    groups.push_back(std::move(shared.value()));
+                }
+            }
+        }
+        return restrictTo(groups, allowed);
+    }
+};
+
+} // namespace Concurrency
+
+#endif // CPU_TOPOLOGY_H
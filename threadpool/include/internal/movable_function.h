@@ -1,57 +1,168 @@
 #ifndef MOVABLE_FUNCTION_H
 #define MOVABLE_FUNCTION_H
 
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
 namespace Concurrency::Internal {
 
+/**
+ * A type whose bytes copied to another address are the same object, so moving it doesn't need its move constructor.
+ * Trivially copyable types are, other types opt in with `static constexpr bool trivially_relocatable = true`.
+ */
+template <typename T>
+inline constexpr bool is_trivially_relocatable_v = std::is_trivially_copyable_v<T> || requires
+{
+    requires T::trivially_relocatable;
+};
+
+/**
+ * A task that must not be destroyed without running, e.g. by a shutdown or an overflow policy that drops queued tasks:
+ * something waits for it. Callables opt in with `static constexpr bool must_run = true`, or are wrapped in MustRunTask.
+ */
+template <typename T>
+inline constexpr bool is_must_run_v = requires
+{
+    requires T::must_run;
+};
+
+template <typename Func>
+struct MustRunTask
+{
+    static constexpr bool must_run              = true;
+    static constexpr bool trivially_relocatable = is_trivially_relocatable_v<Func>;
+
+    Func function;
+
+    void operator()()
+    {
+        function();
+    }
+};
+
+template <typename Func>
+MustRunTask (Func) -> MustRunTask<Func>;
+
+/**
+ * Move-only type-erased `void()` callable.
+ *
+ * Small callables are stored inline, others on the heap. Calls and destruction go through a static table of function
+ * pointers per callable type instead of virtual functions on a heap object, so a small task costs no allocation and
+ * no extra indirection.
+ *
+ * A callable is stored inline only if it is trivially relocatable, so a MovableFunction can always be moved by copying
+ * its bytes, which WorkStealingQueue relies on. The pool's own wrappers opt in whenever what they wrap does. A lambda
+ * capturing e.g. a std::shared_ptr or a std::string can't, and neither can a std::packaged_task: submit() still
+ * allocates the task besides the shared state of its future, spawn() only allocates its TaskState.
+ */
 class MovableFunction
 {
 
 private:
 
-    struct CallableWrapperBase
+    struct VTable
     {
-        virtual void call () = 0;
-
-        virtual ~CallableWrapperBase () = default;
+        void (*call) (std::byte* storage);
+        void (*destroy) (std::byte* storage) noexcept;
+        bool must_run;
     };
 
     template <typename Callable>
-    struct CallableWrapper final : CallableWrapperBase
+    static Callable* inlineCallable (std::byte* storage) noexcept
     {
-        Callable func;
+        return std::launder(reinterpret_cast<Callable*>(storage));
+    }
 
-        explicit CallableWrapper (Callable&& f)
-            : func(std::move(f))
-        {
+    template <typename Callable>
+    static Callable* heapCallable (std::byte* storage) noexcept
+    {
+        return *std::launder(reinterpret_cast<Callable**>(storage));
+    }
 
-        }
+    template <typename Callable>
+    static constexpr VTable inline_vtable {
+        .call     = [](std::byte* storage) { (*inlineCallable<Callable>(storage))(); },
+        .destroy  = [](std::byte* storage) noexcept { std::destroy_at(inlineCallable<Callable>(storage)); },
+        .must_run = is_must_run_v<Callable>
+    };
 
-        void call () override
-        {
-            func();
-        }
+    template <typename Callable>
+    static constexpr VTable heap_vtable {
+        .call     = [](std::byte* storage) { (*heapCallable<Callable>(storage))(); },
+        .destroy  = [](std::byte* storage) noexcept { delete heapCallable<Callable>(storage); },
+        .must_run = is_must_run_v<Callable>
     };
 
+public:
 
-    std::unique_ptr<CallableWrapperBase> _func;
+    static constexpr size_t inline_size      = 48;
+    static constexpr size_t inline_alignment = alignof(std::max_align_t);
+
+    template <typename Callable>
+    static constexpr bool stored_inline = sizeof(Callable) <= inline_size && alignof(Callable) <= inline_alignment
+                                        && is_trivially_relocatable_v<Callable>;
+
+private:
+
+    alignas(inline_alignment) mutable std::byte _storage[inline_size] {};
+    const VTable*                               _vtable = nullptr;
+
+    void reset () noexcept
+    {
+        if (_vtable != nullptr)
+        {
+            _vtable->destroy(_storage);
+            _vtable = nullptr;
+        }
+    }
+
+    void takeFrom (MovableFunction& other) noexcept
+    {
+        std::memcpy(_storage, other._storage, inline_size);
+        _vtable       = other._vtable;
+        other._vtable = nullptr;
+    }
 
 public:
 
+    // Both representations are plain bytes, a MovableFunction can be moved to another address with memcpy.
+    // WorkStealingQueue relies on this.
+    static constexpr bool trivially_relocatable = true;
+
     template <typename Func>
+    requires (!std::is_same_v<std::decay_t<Func>, MovableFunction>)
     MovableFunction (Func&& func)
-        : _func(std::make_unique<CallableWrapper<Func>>(std::move(func)))
     {
+        using Callable = std::decay_t<Func>;
 
+        if constexpr (stored_inline<Callable>)
+        {
+            new (_storage) Callable(std::forward<Func>(func));
+            _vtable = &inline_vtable<Callable>;
+        }
+        else
+        {
+            new (_storage) Callable*(new Callable(std::forward<Func>(func)));
+            _vtable = &heap_vtable<Callable>;
+        }
     }
 
     MovableFunction (MovableFunction&& other) noexcept
-        : _func(std::move(other._func))
     {
+        takeFrom(other);
     }
 
     MovableFunction& operator= (MovableFunction&& other) noexcept
     {
-        _func = std::move(other._func);
+        if (this != &other)
+        {
+            reset();
+            takeFrom(other);
+        }
         return *this;
     }
 
@@ -59,9 +170,14 @@ public:
     MovableFunction (const MovableFunction& other) = delete;
     MovableFunction& operator= (const MovableFunction& other) = delete;
 
+    ~MovableFunction ()
+    {
+        reset();
+    }
+
     void call () const
     {
-        _func->call();
+        _vtable->call(_storage);
     }
 
     void operator()() const
@@ -69,6 +185,12 @@ public:
         call();
     }
 
+    // See is_must_run_v.
+    [[nodiscard]] bool mustRun () const noexcept
+    {
+        return _vtable->must_run;
+    }
+
 };
 
 } // namespace Concurerncy::Internal
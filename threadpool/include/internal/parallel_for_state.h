@@ -0,0 +1,72 @@
+#ifndef PARALLEL_FOR_STATE_H
+#define PARALLEL_FOR_STATE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+
+namespace Concurrency::Internal {
+
+/**
+ * State shared by the caller of ThreadPool::parallelFor and the tasks its range is split into.
+ * Owned by the caller and every queued task, the last one to let go deletes it, so the task that finishes the range
+ * can still notify the caller after the caller has seen it finished.
+ */
+template<typename Func>
+struct ParallelForState
+{
+    explicit ParallelForState (Func& function, const size_t number_of_elements) noexcept
+        : function(function), remaining(number_of_elements)
+    {
+    }
+
+    Func&                   function;
+    std::atomic<size_t>     remaining;
+    // Split off ranges that no thread has started yet. A range is only split again once all of them are taken.
+    std::atomic<size_t>     unclaimed {0};
+    std::atomic<uint32_t>   references {1};
+    std::atomic<uint32_t>   finished {0};
+    std::atomic<bool>       failed {false};
+    std::exception_ptr      exception;
+
+    void acquire () noexcept
+    {
+        references.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void release () noexcept
+    {
+        if (references.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            delete this;
+        }
+    }
+
+    // Only the first exception is kept, the elements after it are skipped.
+    void setException (std::exception_ptr thrown) noexcept
+    {
+        if (!failed.exchange(true, std::memory_order_relaxed))
+        {
+            exception = std::move(thrown);
+        }
+    }
+
+    void complete (const size_t number_of_elements) noexcept
+    {
+        if (remaining.fetch_sub(number_of_elements, std::memory_order_acq_rel) == number_of_elements)
+        {
+            finished.store(1, std::memory_order_release);
+            finished.notify_all();
+        }
+    }
+
+    [[nodiscard]] bool isFinished () const noexcept
+    {
+        return finished.load(std::memory_order_acquire) != 0;
+    }
+};
+
+} // namespace Concurrency::Internal
+
+#endif // PARALLEL_FOR_STATE_H
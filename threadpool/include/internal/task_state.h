@@ -0,0 +1,250 @@
+#ifndef TASK_STATE_H
+#define TASK_STATE_H
+
+#include <atomic>
+#include <climits>
+#include <cstdint>
+#include <exception>
+#include <future>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <variant>
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "cancellation.h"
+
+namespace Concurrency::Internal {
+
+/**
+ * Shared state between a task spawned on the pool and its TaskFuture: the result (or exception), a ready flag that
+ * can be waited on, and a count of the two owners. The last owner to let go deletes it.
+ */
+template<typename R>
+class TaskResult
+{
+private:
+    static_assert(!std::is_reference_v<R>, "Tasks returning references are not supported");
+
+    using ValueType = std::conditional_t<std::is_void_v<R>, std::monostate, R>;
+
+    // States of _ready, a futex word. Only a waiter going to sleep marks it, markReady wakes only if marked.
+    static constexpr uint32_t not_ready = 0;
+    static constexpr uint32_t ready     = 1;
+    static constexpr uint32_t sleeping  = 2;
+
+    mutable std::atomic<uint32_t> _ready {not_ready};
+    std::atomic<uint32_t>         _references {2};
+    std::optional<ValueType>      _value;
+    std::exception_ptr            _exception;
+
+    static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "futex needs a plain 32-bit word");
+
+    void wakeAll () const noexcept
+    {
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(&_ready), FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+    }
+
+protected:
+    template<typename Func>
+    void setValueFrom (Func& function) noexcept
+    {
+        try
+        {
+            if constexpr (std::is_void_v<R>)
+            {
+                function();
+                _value.emplace();
+            }
+            else
+            {
+                _value.emplace(function());
+            }
+
+        } catch (...)
+        {
+            _exception = std::current_exception();
+        }
+    }
+
+    void setException (std::exception_ptr exception) noexcept
+    {
+        _exception = std::move(exception);
+    }
+
+    void markReady () noexcept
+    {
+        if (_ready.exchange(ready, std::memory_order_acq_rel) == sleeping)
+        {
+            wakeAll();
+        }
+    }
+
+public:
+    TaskResult () = default;
+    virtual ~TaskResult () = default;
+
+    TaskResult (const TaskResult&)            = delete;
+    TaskResult& operator= (const TaskResult&) = delete;
+
+    [[nodiscard]] bool isReady () const noexcept
+    {
+        return _ready.load(std::memory_order_acquire) == ready;
+    }
+
+    void waitReady () const noexcept
+    {
+        waitReady([]() { return false; });
+    }
+
+    /**
+     * Sleep until the state is ready or interrupted() holds. Returns isReady(). Someone setting what interrupted()
+     * reads must call wakeSleepers() after.
+     */
+    template<typename Interrupted>
+    bool waitReady (Interrupted interrupted) const noexcept
+    {
+        while (true)
+        {
+            uint32_t state = not_ready;
+            if (!_ready.compare_exchange_strong(state, sleeping, std::memory_order_seq_cst) && state == ready)
+            {
+                return true;
+            }
+
+            // Pairs with the fence of wakeSleepers: either interrupted() holds or the waker sees the sleeping mark.
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (interrupted())
+            {
+                return false;
+            }
+            syscall(SYS_futex, reinterpret_cast<uint32_t*>(&_ready), FUTEX_WAIT_PRIVATE, sleeping, nullptr, nullptr, 0);
+        }
+    }
+
+    /**
+     * Wake the threads in waitReady so they check interrupted() again. Moving the word off `sleeping` makes a waiter
+     * about to sleep see the change, the waiters woken up mark it again before they go back to sleep.
+     */
+    void wakeSleepers () const noexcept
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        uint32_t state = sleeping;
+        if (_ready.compare_exchange_strong(state, not_ready, std::memory_order_seq_cst))
+        {
+            wakeAll();
+        }
+    }
+
+    void release () noexcept
+    {
+        if (_references.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            delete this;
+        }
+    }
+
+    // Only once the state is ready.
+    R takeValue ()
+    {
+        if (_exception)
+        {
+            std::rethrow_exception(_exception);
+        }
+
+        if constexpr (!std::is_void_v<R>)
+        {
+            return std::move(*_value);
+        }
+    }
+};
+
+// Wakes a thread in interruptibleWait for a TaskFuture, through the future's state.
+template<typename R>
+struct TaskResultWaiter : InterruptWaiter
+{
+    const TaskResult<R>& result;
+
+    explicit TaskResultWaiter (const TaskResult<R>& result) noexcept
+        : result(result)
+    {
+        wake = [](InterruptWaiter& waiter) noexcept { static_cast<TaskResultWaiter&>(waiter).result.wakeSleepers(); };
+    }
+};
+
+// The state together with the function, so spawning a task is a single allocation.
+template<typename R, typename Func>
+class TaskState final : public TaskResult<R>
+{
+private:
+    Func _function;
+
+public:
+    explicit TaskState (Func&& function)
+        : _function(std::move(function))
+    {
+    }
+
+    void run () noexcept
+    {
+        this->setValueFrom(_function);
+        this->markReady();
+        this->release();
+    }
+
+    // The task is destroyed without having run, e.g. its pool was destroyed first.
+    void abandon () noexcept
+    {
+        this->setException(std::make_exception_ptr(std::future_error(std::future_errc::broken_promise)));
+        this->markReady();
+        this->release();
+    }
+};
+
+/**
+ * What goes into the pool's queues for a spawned task: an owning pointer to the state, run at most once.
+ * It is only a pointer, so it fits MovableFunction's inline storage and can be relocated as bytes.
+ */
+template<typename R, typename Func>
+class SpawnedTask
+{
+private:
+    TaskState<R, Func>* _state;
+
+public:
+    static constexpr bool trivially_relocatable = true;
+
+    explicit SpawnedTask (TaskState<R, Func>* state) noexcept
+        : _state(state)
+    {
+    }
+
+    SpawnedTask (SpawnedTask&& other) noexcept
+        : _state(std::exchange(other._state, nullptr))
+    {
+    }
+
+    SpawnedTask (const SpawnedTask&)            = delete;
+    SpawnedTask& operator= (const SpawnedTask&) = delete;
+    SpawnedTask& operator= (SpawnedTask&&)      = delete;
+
+    ~SpawnedTask ()
+    {
+        if (_state != nullptr)
+        {
+            _state->abandon();
+        }
+    }
+
+    void operator() ()
+    {
+        std::exchange(_state, nullptr)->run();
+    }
+};
+
+} // namespace Concurrency::Internal
+
+#endif // TASK_STATE_H
@@ -0,0 +1,200 @@
+#ifndef TIMER_QUEUE_H
+#define TIMER_QUEUE_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "ring_wait_strategy.h"
+#include "internal/movable_function.h"
+
+namespace Concurrency::Internal {
+
+/**
+ * Tasks waiting for a point in time, earliest first, for the timers of ThreadPool. A binary heap under a mutex: timers
+ * are pushed and fire far less often than tasks run, what matters is that looking at the next deadline is a single
+ * relaxed load, which the workers do on every search for a task.
+ * Timers due at the same time fire in the order they were pushed.
+ */
+class TimerQueue
+{
+private:
+    struct Timer
+    {
+        RingWaitClock::time_point due;
+        uint64_t                  sequence;
+        MovableFunction           task;
+
+        // Later first, so the heap's top is the earliest timer.
+        bool operator< (const Timer& other) const noexcept
+        {
+            return due != other.due ? due > other.due : sequence > other.sequence;
+        }
+    };
+
+    static constexpr RingWaitClock::rep none = RingWaitClock::time_point::max().time_since_epoch().count();
+
+    mutable std::mutex              _mutex;
+    std::vector<Timer>              _timers;
+    uint64_t                        _next_sequence = 0;
+    // Set by clear(), pushes fail from then on. Only accessed under the mutex.
+    bool                            _closed        = false;
+    // Deadline of the heap's top, `none` when empty. Only written under the mutex.
+    std::atomic<RingWaitClock::rep> _next_due {none};
+
+    void publishNextDue () noexcept
+    {
+        _next_due.store(_timers.empty() ? none : _timers.front().due.time_since_epoch().count(),
+                        std::memory_order_seq_cst);
+    }
+
+public:
+    /**
+     * Returns false if the timer couldn't be queued or the queue is closed. Sets became_first if it is now the earliest
+     * timer, whoever waits for the earliest deadline has to look again.
+     */
+    bool push (const RingWaitClock::time_point due, MovableFunction&& task, bool& became_first)
+    {
+        std::lock_guard lock(_mutex);
+        if (_closed)
+        {
+            return false;
+        }
+        try
+        {
+            _timers.push_back(Timer {due, _next_sequence++, std::move(task)});
+        } catch (std::exception&)
+        {
+            return false;
+        }
+        std::push_heap(_timers.begin(), _timers.end());
+
+        became_first = _timers.front().sequence == _next_sequence - 1;
+        publishNextDue();
+        return true;
+    }
+
+    // Deadline of the earliest timer, time_point::max() if there is none.
+    [[nodiscard]] RingWaitClock::time_point nextDue () const noexcept
+    {
+        return RingWaitClock::time_point(RingWaitClock::duration(_next_due.load(std::memory_order_seq_cst)));
+    }
+
+    [[nodiscard]] bool empty () const noexcept
+    {
+        return _next_due.load(std::memory_order_seq_cst) == none;
+    }
+
+    // The earliest timer if it is due at now.
+    std::optional<MovableFunction> popDue (const RingWaitClock::time_point now)
+    {
+        std::lock_guard lock(_mutex);
+        if (_timers.empty() || _timers.front().due > now)
+        {
+            return std::nullopt;
+        }
+
+        std::pop_heap(_timers.begin(), _timers.end());
+        std::optional<MovableFunction> task(std::move(_timers.back().task));
+        _timers.pop_back();
+        publishNextDue();
+        return task;
+    }
+
+    /**
+     * Destroy every timer without running it and close the queue, later pushes fail: a push that raced with clear()
+     * would leave a timer nobody runs. Returns how many there were.
+     */
+    size_t clear ()
+    {
+        std::vector<Timer> timers;
+        {
+            std::lock_guard lock(_mutex);
+            _closed = true;
+            timers.swap(_timers);
+            publishNextDue();
+        }
+        // Outside the lock, destroying a task can run arbitrary code.
+        return timers.size();
+    }
+};
+
+/**
+ * Whether a periodic timer is cancelled and how many of its runs are in progress, so cancel() can wait for a run that
+ * passed its check just before. The low bit is the cancel mark, the rest counts the runs.
+ */
+class PeriodicTimerState
+{
+private:
+    static constexpr uint32_t cancelled = 1;
+    static constexpr uint32_t one_run   = 2;
+
+    std::atomic<uint32_t> _state {0};
+
+    // The timer whose run this thread is in, a run that cancels its own timer must not wait for itself.
+    inline static thread_local const PeriodicTimerState* running = nullptr;
+
+public:
+    [[nodiscard]] bool isCancelled () const noexcept
+    {
+        return (_state.load(std::memory_order_acquire) & cancelled) != 0;
+    }
+
+    // Marks the timer cancelled and waits for the run in progress, unless called from that run.
+    void cancel () noexcept
+    {
+        uint32_t state = _state.fetch_or(cancelled, std::memory_order_acq_rel) | cancelled;
+        if (running == this)
+        {
+            return;
+        }
+        while (state != cancelled)
+        {
+            _state.wait(state, std::memory_order_acquire);
+            state = _state.load(std::memory_order_acquire);
+        }
+    }
+
+    // A run in progress for its lifetime. Check started() before running: a cancelled timer doesn't start a run.
+    class Run
+    {
+    private:
+        PeriodicTimerState&       _timer;
+        const PeriodicTimerState* _previous;
+        bool                      _started;
+
+    public:
+        explicit Run (PeriodicTimerState& timer) noexcept
+            : _timer(timer), _previous(std::exchange(running, &timer)),
+              _started((timer._state.fetch_add(one_run, std::memory_order_acq_rel) & cancelled) == 0)
+        {
+        }
+
+        ~Run ()
+        {
+            running = _previous;
+            // The last run to end after a cancel lets cancel() return.
+            if (_timer._state.fetch_sub(one_run, std::memory_order_acq_rel) == (cancelled | one_run))
+            {
+                _timer._state.notify_all();
+            }
+        }
+
+        Run (const Run&)            = delete;
+        Run& operator= (const Run&) = delete;
+
+        [[nodiscard]] bool started () const noexcept
+        {
+            return _started;
+        }
+    };
+};
+
+} // namespace Concurrency::Internal
+
+#endif // TIMER_QUEUE_H
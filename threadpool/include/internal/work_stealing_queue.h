@@ -1,81 +1,229 @@
 #ifndef WORK_STEALING_QUEUE_H
 #define WORK_STEALING_QUEUE_H
 
-#include <mutex>
-#include <deque>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <new>
 #include <optional>
+#include <vector>
 
 #include "movable_function.h"
 
 namespace Concurrency::Internal {
 
+/**
+ * Chase-Lev work-stealing deque, with the memory orderings of Lê et al., "Correct and Efficient Work-Stealing for Weak
+ * Memory Models".
+ *
+ * The owner thread pushes and pops at the bottom (LIFO) without any read-modify-write, except a CAS when it takes the
+ * last element. Other threads steal from the top (FIFO) with a CAS. The array grows when full. Arrays it outgrew are
+ * kept until the queue is destroyed because a thief may still be reading one.
+ *
+ * A thief reads a slot before it knows whether it won the element, so slots are copied word by word with relaxed
+ * atomics and the element type must be trivially relocatable: its bytes moved to another address are the same object.
+ */
 class WorkStealingQueue
 {
 private:
     using ElemT = MovableFunction;
+    using Word  = uintptr_t;
 
-    mutable std::mutex _queue_mutex;
-    std::deque<ElemT>      _queue;
+    static_assert(ElemT::trivially_relocatable, "Elements are moved between slots as raw words");
 
-public:
+    static constexpr size_t  cache_line_size  = 64;
+    static constexpr int64_t initial_capacity = 64;
+    static constexpr size_t  words_per_elem   = (sizeof(ElemT) + sizeof(Word) - 1) / sizeof(Word);
 
-    WorkStealingQueue	() = default;
-    ~WorkStealingQueue	() = default;
+    struct Slot
+    {
+        alignas(std::max(alignof(ElemT), alignof(Word))) Word words[words_per_elem];
+    };
 
-    WorkStealingQueue (WorkStealingQueue&& other) noexcept
+    struct Array
     {
-        std::swap(_queue, other._queue);
+        int64_t                 mask;
+        std::unique_ptr<Slot[]> slots;
+
+        explicit Array (const int64_t capacity)
+            : mask(capacity - 1), slots(new Slot[capacity])
+        {
+        }
+
+        Slot& at (const int64_t index) const noexcept
+        {
+            return slots[index & mask];
+        }
+    };
+
+    alignas(cache_line_size) std::atomic<int64_t> _top {0};
+    alignas(cache_line_size) std::atomic<int64_t> _bottom {0};
+    std::atomic<Array*>                           _array {nullptr};
+    std::vector<std::unique_ptr<Array>>           _arrays;
+
+    static void copySlot (const Slot& from, Slot& to) noexcept
+    {
+        for (size_t i = 0; i < words_per_elem; ++i)
+        {
+            const Word word = std::atomic_ref<const Word>(from.words[i]).load(std::memory_order_relaxed);
+            std::atomic_ref<Word>(to.words[i]).store(word, std::memory_order_relaxed);
+        }
     }
 
-    WorkStealingQueue& operator= (WorkStealingQueue&& other) noexcept
+    static void storeElement (Slot& slot, ElemT&& element) noexcept
     {
-        std::swap(_queue, other._queue);
-        return *this;
+        Slot relocated;
+        new (relocated.words) ElemT(std::move(element));
+        copySlot(relocated, slot);
     }
 
-    WorkStealingQueue				(const WorkStealingQueue& other) = delete;
-    WorkStealingQueue& operator=	(const WorkStealingQueue& other) = delete;
+    // Take ownership of the element whose bytes were copied out of the queue.
+    static ElemT takeElement (Slot& relocated) noexcept
+    {
+        ElemT* element = std::launder(reinterpret_cast<ElemT*>(relocated.words));
+        ElemT  result(std::move(*element));
+        std::destroy_at(element);
+        return result;
+    }
 
-    bool enqueue (ElemT element)
+    Array* grow (const Array* array, const int64_t top, const int64_t bottom)
     {
-        std::scoped_lock lock(_queue_mutex);
         try
         {
-            _queue.push_front(std::move(element));
-            return true;
+            auto bigger = std::make_unique<Array>((array->mask + 1) * 2);
+            for (int64_t i = top; i < bottom; ++i)
+            {
+                copySlot(array->at(i), bigger->at(i));
+            }
+            _arrays.push_back(std::move(bigger));
 
         } catch (std::exception &)
         {
-            return false;
+            return nullptr;
+        }
+
+        Array* new_array = _arrays.back().get();
+        _array.store(new_array, std::memory_order_release);
+        return new_array;
+    }
+
+public:
+
+    WorkStealingQueue ()
+    {
+        _arrays.push_back(std::make_unique<Array>(initial_capacity));
+        _array.store(_arrays.back().get(), std::memory_order_relaxed);
+    }
+
+    ~WorkStealingQueue ()
+    {
+        const Array* array = _array.load(std::memory_order_relaxed);
+        for (int64_t i = _top.load(std::memory_order_relaxed); i < _bottom.load(std::memory_order_relaxed); ++i)
+        {
+            Slot element;
+            copySlot(array->at(i), element);
+            takeElement(element);
         }
     }
 
+    // Moving is only meant for setting up the pool's queues, it must not race with any other operation.
+    WorkStealingQueue (WorkStealingQueue&& other) noexcept
+        : _top(other._top.exchange(0, std::memory_order_relaxed)),
+          _bottom(other._bottom.exchange(0, std::memory_order_relaxed)),
+          _array(other._array.exchange(nullptr, std::memory_order_relaxed)),
+          _arrays(std::move(other._arrays))
+    {
+    }
+
+    WorkStealingQueue& operator=	(WorkStealingQueue&& other) = delete;
+    WorkStealingQueue				(const WorkStealingQueue& other) = delete;
+    WorkStealingQueue& operator=	(const WorkStealingQueue& other) = delete;
+
+    // Owner only. On failure the element is left untouched.
+    bool enqueue (ElemT&& element)
+    {
+        const int64_t bottom = _bottom.load(std::memory_order_relaxed);
+        const int64_t top    = _top.load(std::memory_order_acquire);
+        Array*        array  = _array.load(std::memory_order_relaxed);
+
+        if (bottom - top > array->mask)
+        {
+            array = grow(array, top, bottom);
+            if (array == nullptr)
+            {
+                return false;
+            }
+        }
+
+        storeElement(array->at(bottom), std::move(element));
+        _bottom.store(bottom + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Owner only. Takes the most recently enqueued element.
     std::optional<ElemT> dequeue()
     {
-        std::scoped_lock lock(_queue_mutex);
-        if (_queue.empty())
+        const int64_t bottom = _bottom.load(std::memory_order_relaxed) - 1;
+        const Array*  array  = _array.load(std::memory_order_relaxed);
+        _bottom.store(bottom, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t top = _top.load(std::memory_order_relaxed);
+
+        if (top > bottom)
         {
+            _bottom.store(bottom + 1, std::memory_order_relaxed);
             return std::nullopt;
         }
 
-        ElemT result = std::move(_queue.front());
-        _queue.pop_front();
+        Slot element;
+        copySlot(array->at(bottom), element);
 
-        return result;
+        // Last element, thieves may be after it too.
+        if (top == bottom)
+        {
+            const bool won = _top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst,
+                                                          std::memory_order_relaxed);
+            _bottom.store(bottom + 1, std::memory_order_relaxed);
+            if (!won)
+            {
+                return std::nullopt;
+            }
+        }
+
+        return takeElement(element);
+    }
+
+    // Any thread. Only a hint when other threads use the queue.
+    [[nodiscard]] size_t size () const noexcept
+    {
+        const int64_t top    = _top.load(std::memory_order_relaxed);
+        const int64_t bottom = _bottom.load(std::memory_order_relaxed);
+        return bottom > top ? static_cast<size_t>(bottom - top) : 0;
     }
 
+    // Any thread. Takes the least recently enqueued element, returns nullopt if empty or if it lost a race for it.
     std::optional<ElemT> steal()
     {
-        std::scoped_lock lock(_queue_mutex);
-        if (_queue.empty())
+        int64_t top = _top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        const int64_t bottom = _bottom.load(std::memory_order_acquire);
+
+        if (top >= bottom)
         {
             return std::nullopt;
         }
 
-        ElemT result = std::move(_queue.back());
-        _queue.pop_back();
+        const Array* array = _array.load(std::memory_order_acquire);
+        Slot         element;
+        copySlot(array->at(top), element);
 
-        return result;
+        if (!_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+        {
+            return std::nullopt;
+        }
+
+        return takeElement(element);
     }
 };
 
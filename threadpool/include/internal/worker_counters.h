@@ -0,0 +1,93 @@
+#ifndef WORKER_COUNTERS_H
+#define WORKER_COUNTERS_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+#include "threadpool_metrics.h"
+
+namespace Concurrency::Internal {
+
+// Durations recorded into a LatencyHistogram from several threads.
+class AtomicHistogram
+{
+private:
+    std::array<std::atomic<uint64_t>, LatencyHistogram::number_of_buckets> _buckets {};
+
+public:
+    void record (const std::chrono::nanoseconds duration) noexcept
+    {
+        const auto   nanoseconds = static_cast<uint64_t>(std::max<int64_t>(duration.count(), 1));
+        const size_t bucket      = std::min<size_t>(std::bit_width(nanoseconds) - 1,
+                                                    LatencyHistogram::number_of_buckets - 1);
+        _buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void addTo (LatencyHistogram& histogram) const noexcept
+    {
+        for (size_t i = 0; i < LatencyHistogram::number_of_buckets; ++i)
+        {
+            histogram.buckets[i] += _buckets[i].load(std::memory_order_relaxed);
+        }
+    }
+};
+
+/**
+ * Counters of one worker slot of a ThreadPool, on their own cache lines. A worker slot has a single writer, but the
+ * slot of the threads outside the pool is shared, so every update is a relaxed fetch_add.
+ * With CONCURRENCY_THREADPOOL_METRICS=0 this is empty and every update compiles to nothing.
+ */
+struct alignas(64) WorkerCounters
+{
+    static constexpr bool enabled    = CONCURRENCY_THREADPOOL_METRICS != 0;
+    static constexpr bool histograms = CONCURRENCY_THREADPOOL_TASK_HISTOGRAMS != 0;
+
+    enum Counter
+    {
+        local_pickups,
+        shared_pickups,
+        shared_pushes,
+        idle_spins,
+        parks,
+        unparks,
+        idle_nanoseconds,
+        number_of_counters
+    };
+
+#if CONCURRENCY_THREADPOOL_METRICS
+    std::array<std::atomic<uint64_t>, number_of_counters> counters {};
+
+    void add (const Counter counter, const uint64_t value = 1) noexcept
+    {
+        counters[counter].fetch_add(value, std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] uint64_t get (const Counter counter) const noexcept
+    {
+        return counters[counter].load(std::memory_order_relaxed);
+    }
+#else
+    void add (Counter, uint64_t = 1) noexcept
+    {
+    }
+
+    [[nodiscard]] uint64_t get (Counter) const noexcept
+    {
+        return 0;
+    }
+#endif
+
+#if CONCURRENCY_THREADPOOL_TASK_HISTOGRAMS
+    AtomicHistogram queue_wait;
+    AtomicHistogram run_time;
+#endif
+};
+
+} // namespace Concurrency::Internal
+
+#endif // WORKER_COUNTERS_H
@@ -0,0 +1,254 @@
+#ifndef TASK_GRAPH_H
+#define TASK_GRAPH_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "threadpool.h"
+
+namespace Concurrency {
+
+/**
+ * A DAG of tasks run on a ThreadPool. A node runs once all the nodes that precede it are done. The worker that
+ * finishes a node decrements the dependency counters of its successors, runs one successor that became ready itself
+ * and queues the others on its own work-stealing queue, so no worker ever blocks waiting for an input.
+ *
+ * A graph can be run again once it has finished, running it allocates nothing besides what the pool's queues need.
+ * Nodes and edges can't be added while the graph runs, and the graph must not have cycles.
+ */
+class TaskGraph
+{
+private:
+    struct Node
+    {
+        explicit Node (MovableFunction&& function)
+            : function(std::move(function))
+        {
+        }
+
+        MovableFunction     function;
+        std::vector<Node*>  successors;
+        size_t              dependencies = 0;
+        // Dependencies still running in the current run.
+        std::atomic<size_t> remaining {0};
+    };
+
+public:
+    // Handle to a node of a TaskGraph, valid as long as the graph.
+    class TaskNode
+    {
+    private:
+        Node* _node;
+
+        friend class TaskGraph;
+
+        explicit TaskNode (Node* node) noexcept
+            : _node(node)
+        {
+        }
+
+    public:
+        // This node runs before every given node.
+        template<typename... Nodes>
+        TaskNode& precede (const Nodes&... nodes)
+        {
+            (addEdge(*this, nodes), ...);
+            return *this;
+        }
+
+        // This node runs after every given node.
+        template<typename... Nodes>
+        TaskNode& succeed (const Nodes&... nodes)
+        {
+            (addEdge(nodes, *this), ...);
+            return *this;
+        }
+
+    private:
+        static void addEdge (const TaskNode& from, const TaskNode& to)
+        {
+            from._node->successors.push_back(to._node);
+            ++to._node->dependencies;
+        }
+    };
+
+    TaskGraph () = default;
+
+    TaskGraph (const TaskGraph&)            = delete;
+    TaskGraph& operator= (const TaskGraph&) = delete;
+
+    // Waits for a run still in progress, running tasks of its pool meanwhile like wait().
+    ~TaskGraph ()
+    {
+        waitFinished();
+    }
+
+    // function is called once per run.
+    template<typename Func>
+    TaskNode emplace (Func&& function)
+    {
+        _nodes.push_back(std::make_unique<Node>(MovableFunction(std::forward<Func>(function))));
+        return TaskNode(_nodes.back().get());
+    }
+
+    [[nodiscard]] size_t size () const noexcept
+    {
+        return _nodes.size();
+    }
+
+    /**
+     * Start a run on thread_pool, the nodes without dependencies are queued right away.
+     * Returns false if the graph is still running.
+     */
+    bool run (ThreadPool& thread_pool)
+    {
+        if (_running.exchange(true, std::memory_order_acquire))
+        {
+            return false;
+        }
+
+        _thread_pool = &thread_pool;
+        _exception   = nullptr;
+        _failed.store(false, std::memory_order_relaxed);
+        _pending.store(_nodes.size(), std::memory_order_relaxed);
+        if (_nodes.empty())
+        {
+            finish();
+            return true;
+        }
+
+        for (const std::unique_ptr<Node>& node : _nodes)
+        {
+            node->remaining.store(node->dependencies, std::memory_order_relaxed);
+        }
+        for (const std::unique_ptr<Node>& node : _nodes)
+        {
+            if (node->dependencies == 0)
+            {
+                schedule(node.get());
+            }
+        }
+        return true;
+    }
+
+    /**
+     * Wait for the current run to finish, running tasks of its pool meanwhile, and rethrow the first exception thrown
+     * by a node. Once a node threw, the nodes not started yet are skipped. Must not be called from a node of the graph.
+     */
+    void wait ()
+    {
+        waitFinished();
+
+        std::lock_guard lock(_mutex);
+        if (_exception)
+        {
+            std::rethrow_exception(_exception);
+        }
+    }
+
+private:
+    std::vector<std::unique_ptr<Node>> _nodes;
+    ThreadPool*                        _thread_pool = nullptr;
+    std::atomic<bool>                  _running {false};
+    // Nodes of the current run not done yet.
+    std::atomic<size_t>                _pending {0};
+    std::atomic<bool>                  _failed {false};
+    std::exception_ptr                 _exception;
+
+    // Only for the end of a run: after finish() the graph can be destroyed, the lock keeps that from happening
+    // while the last node still uses it.
+    std::mutex                         _mutex;
+    std::condition_variable            _finished;
+
+    /**
+     * Help the pool until the current run is finished: on a worker of the pool the nodes may be queued behind the
+     * caller, on its own work-stealing queue. The pool is only touched while a run is in progress, a graph that ran
+     * may be destroyed after its pool.
+     */
+    void waitFinished ()
+    {
+        if (_running.load(std::memory_order_acquire))
+        {
+            _thread_pool->helpUntil([this]() { return !_running.load(std::memory_order_acquire); }, [this]()
+            {
+                std::unique_lock lock(_mutex);
+                _finished.wait(lock, [this]() { return !_running.load(std::memory_order_acquire); });
+            });
+        }
+
+        // The last node may still be in finish().
+        std::lock_guard lock(_mutex);
+    }
+
+    void schedule (Node* node)
+    {
+        if (!_thread_pool->pushTask(MovableFunction(Internal::MustRunTask {[this, node]() { runNode(node); }})))
+        {
+            // The pool doesn't take tasks anymore, run it here rather than never finish.
+            runNode(node);
+        }
+    }
+
+    void runNode (Node* node)
+    {
+        while (node != nullptr)
+        {
+            if (!_failed.load(std::memory_order_relaxed))
+            {
+                try
+                {
+                    node->function();
+                } catch (...)
+                {
+                    if (!_failed.exchange(true, std::memory_order_relaxed))
+                    {
+                        _exception = std::current_exception();
+                    }
+                }
+            }
+
+            // Keep one successor for this thread, it continues the chain without going through a queue.
+            Node* next = nullptr;
+            for (Node* successor : node->successors)
+            {
+                if (successor->remaining.fetch_sub(1, std::memory_order_acq_rel) != 1)
+                {
+                    continue;
+                }
+
+                if (next == nullptr)
+                {
+                    next = successor;
+                }
+                else
+                {
+                    schedule(successor);
+                }
+            }
+
+            // A pending successor keeps the run going, so the graph is only finished when there is no next node.
+            if (_pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            {
+                finish();
+            }
+            node = next;
+        }
+    }
+
+    void finish ()
+    {
+        std::lock_guard lock(_mutex);
+        _running.store(false, std::memory_order_release);
+        _finished.notify_all();
+    }
+};
+
+} // namespace Concurrency
+
+#endif // TASK_GRAPH_H
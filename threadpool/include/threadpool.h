@@ -4,144 +4,1901 @@
 #include <future>
 #include <thread>
 #include <vector>
+#include <algorithm>
+#include <array>
 #include <atomic>
+#include <chrono>
 #include <memory>
+#include <cstdint>
+#include <concepts>
+#include <coroutine>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <mutex>
+#include <optional>
+#include <ranges>
 
-#include "lock_based_queue.h"
+#include "cancellation.h"
+#include "cpu_topology.h"
+#include "interruptible_wait.h"
+#include "lock_free_queue.h"
+#include "ring_wait_strategy.h"
+#include "threadpool_metrics.h"
 #include "internal/movable_function.h"
+#include "internal/parallel_for_state.h"
+#include "internal/task_state.h"
+#include "internal/timer_queue.h"
 #include "internal/work_stealing_queue.h"
+#include "internal/worker_counters.h"
 
 namespace Concurrency {
 
 using Internal::MovableFunction;
 using Internal::WorkStealingQueue;
 
+template<typename R>
+class TaskFuture;
+class TaskGraph;
+
+/**
+ * How much an idle worker takes from a victim's queue.
+ * One: a single task, the oldest one.
+ * Half: about half of the victim's tasks, the first one runs and the rest go to the thief's own queue. Fewer steals
+ * when a few workers produce most of the tasks, at the cost of moving tasks that the victim might have run itself.
+ */
+enum class StealPolicy
+{
+	One,
+	Half
+};
+
+/**
+ * Order in which the pool starts queued tasks. A task queued with Normal priority from a worker of the pool goes to
+ * the worker's own queue, the fast path of fork-join, and runs after High tasks but before Normal tasks queued from
+ * outside. Lower priorities still get a share of the starts while higher priority tasks are queued, see
+ * ThreadPool::findPendingTask.
+ */
+enum class TaskPriority
+{
+	High,
+	Normal,
+	Low
+};
+
+// Totals over all threads since the pool was created. Every stolen task also counts as a success for its first task.
+struct StealStatistics
+{
+	uint64_t attempts		= 0;
+	uint64_t successes		= 0;
+	uint64_t stolen_tasks	= 0;
+};
+
+/**
+ * What a thread outside the pool does when it queues a task while the shared queues are full, see QueueBound.
+ * Block: wait for room.
+ * FailFast: the push fails, submit and spawn return std::nullopt and post returns false.
+ * CallerRuns: run the task on the calling thread instead, which slows the producer down to the pace of the pool.
+ * DropOldest: drop the task that has waited longest in the lowest priority queue that has one, its future reports
+ * std::future_error(broken_promise), and queue the new task. The pool's own tasks, e.g. the halves of a parallelFor, are
+ * run by the caller instead of dropped.
+ */
+enum class OverflowPolicy
+{
+	Block,
+	FailFast,
+	CallerRuns,
+	DropOldest
+};
+
+/**
+ * Bound on the tasks waiting in the shared queues of a ThreadPool: the priority queues and the domain queues. Only
+ * threads outside the pool are held to it. Tasks queued by workers count but are never refused, a worker waiting for
+ * room could be waiting for itself.
+ */
+struct QueueBound
+{
+	size_t			capacity	= std::numeric_limits<size_t>::max();
+	OverflowPolicy	policy		= OverflowPolicy::Block;
+};
+
+/**
+ * What ThreadPool::shutdown does with the tasks not started yet. It waits for the pool to run out of tasks until the
+ * deadline, then drops the tasks still queued. Tasks already running always finish.
+ */
+struct DrainPolicy
+{
+	RingWaitClock::time_point deadline;
+
+	static DrainPolicy drainAll () noexcept
+	{
+		return {RingWaitClock::time_point::max()};
+	}
+
+	static DrainPolicy drainUntil (const RingWaitClock::time_point deadline) noexcept
+	{
+		return {deadline};
+	}
+
+	static DrainPolicy cancelNow () noexcept
+	{
+		return {RingWaitClock::time_point::min()};
+	}
+};
+
+/**
+ * Where a ThreadPool is in its shutdown, see ThreadPool::shutdown.
+ * Running: the pool accepts tasks.
+ * Draining: shutdown has started, tasks from outside the pool are refused and the queued tasks run as the DrainPolicy
+ * says.
+ * Stopping: the workers exit once they are done with the task they run, the tasks still queued are dropped.
+ */
+enum class PoolState
+{
+	Running,
+	Draining,
+	Stopping
+};
+
+/**
+ * Worker limits of an elastic ThreadPool. The pool starts min_workers workers and adds workers, up to max_workers,
+ * when a task is queued while every worker is busy, or when a worker enters a ThreadPool::BlockingRegion and fewer
+ * than min_workers workers are left to run tasks. A worker beyond min_workers that has had nothing to run for
+ * idle_timeout exits.
+ */
+struct ElasticLimits
+{
+	size_t					min_workers		= 1;
+	size_t					max_workers		= std::thread::hardware_concurrency();
+	RingWaitClock::duration	idle_timeout	= std::chrono::seconds(1);
+};
+
+/**
+ * Handle of a task that ThreadPool::submitEvery runs periodically. Dropping the handle doesn't stop the timer, copies
+ * stop the same timer.
+ */
+class PeriodicTimer
+{
+private:
+	std::shared_ptr<Internal::PeriodicTimerState> _state;
+
+	friend class ThreadPool;
+
+	explicit PeriodicTimer (std::shared_ptr<Internal::PeriodicTimerState> state) noexcept
+		: _state(std::move(state))
+	{
+	}
+
+public:
+	/**
+	 * No run starts after this returns: waits for a run in progress to finish, unless called from that run. The run
+	 * must not wait for the thread that cancels.
+	 */
+	void cancel () const noexcept
+	{
+		_state->cancel();
+	}
+
+	[[nodiscard]] bool isCancelled () const noexcept
+	{
+		return _state->isCancelled();
+	}
+};
+
 class ThreadPool
 {
 private:
 
+	static constexpr size_t cache_line_size = 64;
+
+	// An idle worker retries this many times spinning, then this many times yielding, before it parks.
+	static constexpr uint32_t idle_spin_limit	= 64;
+	static constexpr uint32_t idle_yield_limit	= 16;
+
+	// A thread waiting for a result tries this many times to find a task to run before it blocks.
+	static constexpr uint32_t help_attempts		= 64;
+
+	struct alignas(cache_line_size) StealCounters
+	{
+		std::atomic<uint64_t> attempts		{0};
+		std::atomic<uint64_t> successes		{0};
+		std::atomic<uint64_t> stolen_tasks	{0};
+	};
+
+	// Workers sharing memory or a cache. Its workers have consecutive indexes.
+	struct Domain
+	{
+		// Tasks submitted to this domain only, other domains take them when they have nothing else to do.
+		LockFreeQueue<MovableFunction>	tasks;
+		// Idle workers of the domain park here.
+		ParkingWait						idle;
+		size_t							first_worker		= 0;
+		size_t							number_of_workers	= 0;
+	};
+
 	std::atomic_flag					_done;
-    ConcurrentQueue<MovableFunction>	_global_tasks;
+	std::atomic_flag					_shutting_down;
+	// Tasks queued or running. Written by every push and every finished task, so on its own line.
+	alignas(cache_line_size) std::atomic<size_t>	_pending_tasks {0};
+	// Tasks in the shared queues, or with a place reserved in them. Written by every shared push and pop.
+	alignas(cache_line_size) std::atomic<size_t>	_shared_tasks {0};
+	std::atomic<size_t>					_queue_capacity	{QueueBound().capacity};
+	std::atomic<OverflowPolicy>			_overflow_policy	{QueueBound().policy};
+	// Threads outside the pool waiting for room in the shared queues, and how many there are.
+	ParkingWait							_queue_space;
+	std::atomic<size_t>					_blocked_producers {0};
+	// Tasks of submitAt, submitAfter and submitEvery that aren't due yet. One idle worker at a time, the keeper,
+	// sleeps in _timer_wait until the earliest is due, the other idle workers park in their domain.
+	Internal::TimerQueue				_timers;
+	std::atomic_flag					_timer_keeper;
+	ParkingWait							_timer_wait;
+	static constexpr size_t number_of_priorities = 3;
+
+	// Against starvation, every normal_turn-th search looks at Normal tasks first, every low_turn-th at Low tasks.
+	// Every timer_turn-th search looks for a due timer first, a busy pool only reads the clock that often. The timer's
+	// turn is one search later, so due timers never take the turn of Low or Normal tasks.
+	static constexpr uint32_t normal_turn	= 4;
+	static constexpr uint32_t low_turn		= 16;
+	static constexpr uint32_t timer_turn	= 8;
+	static constexpr uint32_t timer_offset	= 1;
+
+	// One queue per TaskPriority.
+	std::array<LockFreeQueue<MovableFunction>, number_of_priorities>	_global_tasks;
 	std::vector<WorkStealingQueue>		_local_tasks_queues;
+	std::vector<std::unique_ptr<Domain>>	_domains;
+	std::vector<size_t>					_worker_domains;
+	// CPU of every worker, empty if the workers aren't pinned.
+	std::vector<int>					_worker_cpus;
+	// One slot per worker, the last one is shared by threads outside the pool that help with runPendingTask.
+	std::vector<StealCounters>			_steal_counters;
+	// Same slots, see metrics().
+	std::vector<Internal::WorkerCounters>	_worker_counters;
+	StealPolicy							_steal_policy;
+	// Threads in waitIdle.
+	ParkingWait							_drained;
+
+	// A fixed pool has min_workers == max_workers and never adds or retires workers.
+	ElasticLimits						_limits;
+	bool								_elastic;
+	std::atomic<size_t>					_live_workers		{0};
+	// Workers inside a BlockingRegion.
+	std::atomic<size_t>					_blocked_workers	{0};
+	// Only one thread adds a worker at a time, the others don't wait for it.
+	std::atomic_flag					_adding_worker;
+	// Guards _threads and _free_slots. Every worker has a slot: its local queue, steal counters and thread. The
+	// slots of workers that aren't running are free, their queues are empty so stealing can still look at them.
+	std::mutex							_workers_mutex;
+	std::vector<size_t>					_free_slots;
     std::vector<std::jthread>           _threads;
 
+	template<typename R>
+	friend class TaskFuture;
+	friend class TaskGraph;
+
 	inline static thread_local WorkStealingQueue*	_this_thread_local_tasks	= nullptr;
 	inline static thread_local size_t				_this_thread_idx			= 0;
+	inline static thread_local uint32_t				_victim_random_state		= 0;
+	inline static thread_local uint32_t				_tasks_found				= 0;
 
     void workerFunc (const size_t thread_index)
     {
     	_this_thread_idx = thread_index;
     	_this_thread_local_tasks = &_local_tasks_queues[thread_index];
 
-    	while (!_done.test(std::memory_order_relaxed))
+    	if (!_worker_cpus.empty())
     	{
-    		runPendingTask();
+    		// Best effort, a worker the OS refuses to pin still works.
+    		CpuTopology::pinCurrentThread(_worker_cpus[thread_index]);
     	}
-    }
 
-	std::optional<MovableFunction> stealTasksFromOtherThreads ()
-    {
-    	/**
-	     * We don't every thread to start from the first queue, creating contention on it.
-	     * Instead, each thread starts from the next thread's queue in the list.
-	     */
-    	const size_t number_of_local_tasks_queues = _local_tasks_queues.size();
-    	for (size_t i = 0; i < number_of_local_tasks_queues; ++i)
+    	Domain&                   domain   = *_domains[_worker_domains[thread_index]];
+    	Internal::WorkerCounters& counters = _worker_counters[thread_index];
+    	while (!_done.test(std::memory_order_relaxed))
     	{
-    		const size_t index = (_this_thread_idx + i) % number_of_local_tasks_queues;
-    		auto task = _local_tasks_queues[index].dequeue();
+    		std::optional<MovableFunction> task;
+    		const bool timer_keeper = !_timers.empty() && !_timer_keeper.test_and_set(std::memory_order_seq_cst);
+    		const RingWaitClock::time_point timer_due = timer_keeper ? _timers.nextDue()
+    																 : RingWaitClock::time_point::max();
+    		ParkingWait& idle = timer_keeper ? _timer_wait : domain.idle;
+    		// Only read the clock once a search came back empty, a busy worker doesn't pay for idle time. The idle
+    		// timeout of an elastic pool counts from then too, the wait asks for the deadline once it is done spinning.
+    		RingWaitClock::time_point idle_since;
+    		RingWaitClock::time_point idle_deadline = RingWaitClock::time_point::max();
+    		const auto deadline = [this, &idle_since, &idle_deadline, timer_due]()
+    		{
+    			if (_elastic)
+    			{
+    				if (idle_since == RingWaitClock::time_point())
+    				{
+    					idle_since = RingWaitClock::now();
+    				}
+    				idle_deadline = idle_since + _limits.idle_timeout;
+    			}
+    			return std::min(idle_deadline, timer_due);
+    		};
+    		const bool woken = idle.waitUntil(deadline, [this, &task, &counters, &idle_since, timer_keeper, timer_due]()
+    		{
+    			task = findPendingTask();
+    			if (task.has_value() || _done.test(std::memory_order_relaxed))
+    			{
+    				return true;
+    			}
+    			// Look again at the timers: the keeper when an earlier one was pushed, the others when the keeper left.
+    			if (timer_keeper ? _timers.nextDue() < timer_due
+    							 : !_timers.empty() && !_timer_keeper.test(std::memory_order_seq_cst))
+    			{
+    				return true;
+    			}
+
+    			if constexpr (Internal::WorkerCounters::enabled)
+    			{
+    				if (idle_since == RingWaitClock::time_point())
+    				{
+    					idle_since = RingWaitClock::now();
+    				}
+    				counters.add(Internal::WorkerCounters::idle_spins);
+    			}
+    			return false;
+    		}, [&counters]() noexcept { counters.add(Internal::WorkerCounters::parks); });
+
+    		if constexpr (Internal::WorkerCounters::enabled)
+    		{
+    			if (idle_since != RingWaitClock::time_point())
+    			{
+    				const auto idle_time = std::chrono::duration_cast<std::chrono::nanoseconds>(RingWaitClock::now()
+    																						  - idle_since);
+    				counters.add(Internal::WorkerCounters::idle_nanoseconds, static_cast<uint64_t>(idle_time.count()));
+    			}
+    		}
+
+    		if (timer_keeper)
+    		{
+    			_timer_keeper.clear(std::memory_order_seq_cst);
+    			// Busy from now on, hand the timers over to a parked worker.
+    			if (task.has_value() && !_timers.empty())
+    			{
+    				wakeWorker(_worker_domains[thread_index]);
+    			}
+    		}
+
     		if (task.has_value())
     		{
-    			return task;
+    			runTask(task.value());
+    		}
+    		else if (!woken && RingWaitClock::now() >= idle_deadline && retireWorker(thread_index))
+    		{
+    			// A task queued while we were timing out may have woken us instead of another parked worker.
+    			domain.idle.notifyOne();
+    			return;
     		}
     	}
-
-    	return std::nullopt;
     }
 
-public:
-    explicit ThreadPool(size_t number_of_threads = std::thread::hardware_concurrency())
+	// Leave the pool if it has more workers than min_workers. The local queue is empty, only its owner pushes to it.
+	bool retireWorker (const size_t thread_index)
 	{
-		if (number_of_threads > std::thread::hardware_concurrency())
+		std::lock_guard lock(_workers_mutex);
+		if (_live_workers.load(std::memory_order_relaxed) <= _limits.min_workers)
 		{
-			number_of_threads = std::thread::hardware_concurrency();
+			return false;
 		}
 
-		_local_tasks_queues.reserve(number_of_threads);
-		for (size_t i = 0; i < number_of_threads; ++i)
+		_live_workers.fetch_sub(1, std::memory_order_relaxed);
+		_free_slots.push_back(thread_index);
+		return true;
+	}
+
+	/**
+	 * In an elastic pool, start a worker if there are tasks no worker has taken, or if workers blocked in a
+	 * BlockingRegion leave fewer than min_workers to run tasks. Called once parked workers were woken, or when
+	 * none was parked, so a pool with idle workers doesn't grow.
+	 */
+	void addWorkerIfNeeded ()
+	{
+		if (!_elastic)
 		{
-			_local_tasks_queues.emplace_back();
-			_threads.emplace_back(&ThreadPool::workerFunc, this, i);
+			return;
+		}
+
+		const size_t live_workers		= _live_workers.load(std::memory_order_relaxed);
+		const size_t blocked_workers	= std::min(_blocked_workers.load(std::memory_order_relaxed), live_workers);
+		const bool   backed_up			= _pending_tasks.load(std::memory_order_relaxed) > live_workers;
+		const bool   too_few_running	= live_workers - blocked_workers < _limits.min_workers;
+		if (live_workers >= _limits.max_workers || !(backed_up || too_few_running)
+			|| _adding_worker.test_and_set(std::memory_order_acquire))
+		{
+			return;
+		}
+
+		{
+			std::lock_guard lock(_workers_mutex);
+			if (!_done.test(std::memory_order_relaxed) && !_free_slots.empty())
+			{
+				const size_t slot = _free_slots.back();
+				try
+				{
+					// Joins the worker that last had the slot, it has already left.
+					_threads[slot] = std::jthread(&ThreadPool::workerFunc, this, slot);
+					_free_slots.pop_back();
+					_live_workers.fetch_add(1, std::memory_order_relaxed);
+				} catch (const std::system_error&)
+				{
+					// Out of threads, the workers we have will get to the tasks.
+				}
+			}
 		}
+		_adding_worker.clear(std::memory_order_release);
 	}
 
-	~ThreadPool ()
-    {
-    	_done.test_and_set(std::memory_order_relaxed);
-    }
+	std::optional<MovableFunction> findPendingTask ()
+	{
+		/**
+		 * High tasks first, then our own queue, then Normal and Low tasks from outside. The turn of a lower priority
+		 * comes every few tasks found, it's looked at first then, so a backlog of higher priority tasks only slows
+		 * lower priority tasks down instead of starving them. Due timers are taken on their own turn, or when there is
+		 * nothing else to run.
+		 */
+		const bool                own_worker	= isCurrentThreadOwnWorker();
+		Internal::WorkerCounters& counters		= _worker_counters[own_worker ? _this_thread_idx
+																		   : _local_tasks_queues.size()];
 
+		std::optional<MovableFunction> task;
+		if (_tasks_found % timer_turn == timer_offset)
+		{
+			task = takeDueTimer(counters);
+		}
 
-	static bool isCurrentThreadAPoolThread ()
-    {
-    	return _this_thread_local_tasks != nullptr;
-    }
+		if (!task.has_value() && _tasks_found % low_turn == 0)
+		{
+			task = popGlobalTask(TaskPriority::Low, counters);
+		}
+
+		// Low's turn is also Normal's, Normal gets it when there is no Low task.
+		if (!task.has_value() && _tasks_found % normal_turn == 0)
+		{
+			task = popGlobalTask(TaskPriority::Normal, counters);
+		}
+
+		if (!task.has_value())
+		{
+			task = popGlobalTask(TaskPriority::High, counters);
+		}
+
+		// A worker of another pool helping this one must not run its own pool's tasks here, they would finish here.
+		if (!task.has_value() && own_worker)
+		{
+			task = _this_thread_local_tasks->dequeue();
+			if (task.has_value())
+			{
+				counters.add(Internal::WorkerCounters::local_pickups);
+			}
+		}
+
+		Domain* own_domain = own_worker ? _domains[_worker_domains[_this_thread_idx]].get() : nullptr;
+		if (!task.has_value() && own_domain != nullptr)
+		{
+			task = popSharedTask(own_domain->tasks, counters);
+		}
+
+		// Try to get a task from global queue if local queue doesn't have any task
+		if (!task.has_value())
+		{
+			task = popGlobalTask(TaskPriority::Normal, counters);
+		}
+
+		if (!task.has_value())
+		{
+			task = popGlobalTask(TaskPriority::Low, counters);
+		}
 
-	void runPendingTask ()
+		if (!task.has_value())
+		{
+			task = stealTasksFromOtherThreads();
+		}
+
+		// Tasks meant for another domain, only when there is nothing else to run.
+		for (size_t i = 0; !task.has_value() && i < _domains.size(); ++i)
+		{
+			if (_domains[i].get() != own_domain)
+			{
+				task = popSharedTask(_domains[i]->tasks, counters);
+			}
+		}
+
+		if (!task.has_value())
+		{
+			task = takeDueTimer(counters);
+		}
+
+		if (task.has_value())
+		{
+			++_tasks_found;
+		}
+		return task;
+	}
+
+	std::optional<MovableFunction> popGlobalTask (const TaskPriority priority, Internal::WorkerCounters& counters)
+	{
+		return popSharedTask(_global_tasks[static_cast<size_t>(priority)], counters);
+	}
+
+	std::optional<MovableFunction> popSharedTask (LockFreeQueue<MovableFunction>& tasks,
+												  Internal::WorkerCounters& counters)
+	{
+		std::optional<MovableFunction> task = tasks.pop();
+		if (task.has_value())
+		{
+			releaseSharedPlace();
+			counters.add(Internal::WorkerCounters::shared_pickups);
+		}
+		return task;
+	}
+
+	/**
+	 * The earliest timer if it is due, counted as a pending task from now on. Costs a load while there are no timers,
+	 * and a clock read while none is due. Wakes another worker if more timers are due.
+	 */
+	std::optional<MovableFunction> takeDueTimer (Internal::WorkerCounters& counters)
+	{
+		if (_timers.empty())
+		{
+			return std::nullopt;
+		}
+
+		const RingWaitClock::time_point now = RingWaitClock::now();
+		if (_timers.nextDue() > now)
+		{
+			return std::nullopt;
+		}
+
+		std::optional<MovableFunction> task = _timers.popDue(now);
+		if (task.has_value())
+		{
+			_pending_tasks.fetch_add(1, std::memory_order_seq_cst);
+			counters.add(Internal::WorkerCounters::shared_pickups);
+			if (_timers.nextDue() <= now)
+			{
+				wakeWorker(currentDomain());
+			}
+		}
+		return task;
+	}
+
+	// Counters of the calling worker, or the slot shared by threads outside the pool.
+	Internal::WorkerCounters& currentCounters () noexcept
+	{
+		return _worker_counters[isCurrentThreadOwnWorker() ? _this_thread_idx : _local_tasks_queues.size()];
+	}
+
+	// True if the calling thread is a worker of this pool, not only of any pool.
+	bool isCurrentThreadOwnWorker () const noexcept
+	{
+		return _this_thread_local_tasks != nullptr && _this_thread_idx < _local_tasks_queues.size()
+			&& &_local_tasks_queues[_this_thread_idx] == _this_thread_local_tasks;
+	}
+
+	static size_t randomVictim (const size_t number_of_queues) noexcept
+	{
+		// xorshift32, seeded once per thread.
+		uint32_t state = _victim_random_state;
+		if (state == 0)
+		{
+			state = static_cast<uint32_t>(std::hash<std::thread::id>{}(std::this_thread::get_id())) | 1;
+		}
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		_victim_random_state = state;
+
+		return state % number_of_queues;
+	}
+
+	std::optional<MovableFunction> stealTasksFromOtherThreads ()
     {
-    	std::optional<MovableFunction> task;
-    	if (_this_thread_local_tasks != nullptr)
+    	const size_t	number_of_local_tasks_queues	= _local_tasks_queues.size();
+    	const bool		own_worker						= isCurrentThreadOwnWorker();
+    	StealCounters&	counters						= _steal_counters[own_worker ? _this_thread_idx
+    																				 : number_of_local_tasks_queues];
+
+    	if (!own_worker || _domains.size() == 1)
     	{
-    		task = _this_thread_local_tasks->dequeue();
+    		return stealFromVictims(0, number_of_local_tasks_queues, 0, 0, own_worker, counters);
     	}
 
-    	// Try to get a task from global queue if local queue doesn't have any task
+    	// Workers of the same domain first, their tasks' data is in a cache or memory close to us.
+    	const Domain& domain		= *_domains[_worker_domains[_this_thread_idx]];
+    	const size_t  domain_end	= domain.first_worker + domain.number_of_workers;
+    	auto task = stealFromVictims(domain.first_worker, domain.number_of_workers, 0, 0, own_worker, counters);
     	if (!task.has_value())
     	{
-    		task = _global_tasks.pop();
+    		task = stealFromVictims(0, number_of_local_tasks_queues, domain.first_worker, domain_end, own_worker, counters);
     	}
+    	return task;
+    }
 
-    	if (!task.has_value())
+	// Steal from the workers [first_victim, first_victim + number_of_victims) except those in [skip_begin, skip_end).
+	std::optional<MovableFunction> stealFromVictims (const size_t first_victim, const size_t number_of_victims,
+													 const size_t skip_begin, const size_t skip_end,
+													 const bool own_worker, StealCounters& counters)
+    {
+    	/**
+	     * Start from a random victim so idle threads spread over the queues instead of all hitting the same one, and
+	     * take from the cold end of its queue, away from the owner and its most recent (smallest) tasks.
+	     */
+    	if (number_of_victims == 0)
     	{
-    		task = stealTasksFromOtherThreads();
+    		return std::nullopt;
     	}
 
-    	if (task.has_value())
+    	const size_t random_offset = randomVictim(number_of_victims);
+    	for (size_t i = 0; i < number_of_victims; ++i)
     	{
-    		task.value()();
-    		return;
+    		const size_t index = first_victim + (random_offset + i) % number_of_victims;
+    		if ((own_worker && index == _this_thread_idx) || (index >= skip_begin && index < skip_end))
+    		{
+    			continue;
+    		}
+
+    		WorkStealingQueue& victim = _local_tasks_queues[index];
+    		counters.attempts.fetch_add(1, std::memory_order_relaxed);
+    		auto task = victim.steal();
+    		if (!task.has_value())
+    		{
+    			continue;
+    		}
+
+    		uint64_t stolen_tasks = 1;
+    		if (_steal_policy == StealPolicy::Half && own_worker)
+    		{
+    			const size_t batch_size = (victim.size() + 2) / 2;
+    			for (; stolen_tasks < batch_size; ++stolen_tasks)
+    			{
+    				auto extra_task = victim.steal();
+    				if (!extra_task.has_value())
+    				{
+    					break;
+    				}
+    				if (!_this_thread_local_tasks->enqueue(std::move(extra_task.value())))
+    				{
+    					// Out of memory for our own queue, run it rather than lose it.
+    					runTask(extra_task.value());
+    				}
+    			}
+    		}
+
+    		counters.successes.fetch_add(1, std::memory_order_relaxed);
+    		counters.stolen_tasks.fetch_add(stolen_tasks, std::memory_order_relaxed);
+    		return task;
     	}
 
-    	// No task in the task queues. Yield the thread to the OS.
-    	std::this_thread::yield();
+    	return std::nullopt;
     }
 
-	template<typename Func>
-	std::optional<std::future<std::invoke_result_t<Func>>> submit (Func function)
+	/**
+	 * Wake one parked worker, looking in first_domain first and at the timer keeper last. Costs a fence and a load per
+	 * domain when none sleeps. Returns false if no worker was parked.
+	 */
+	bool wakeWorker (const size_t first_domain) noexcept
 	{
-		using FuncReturnType = std::invoke_result_t<Func>;
-		std::packaged_task<FuncReturnType()> packaged_task(function);
-		auto future = packaged_task.get_future();
-
-		if (isCurrentThreadAPoolThread())
+		for (size_t i = 0; i < _domains.size(); ++i)
 		{
-			const bool push_succeed = _this_thread_local_tasks->enqueue(std::move(packaged_task));
-			if (!push_succeed)
+			if (_domains[(first_domain + i) % _domains.size()]->idle.notifyOne())
 			{
-				return std::nullopt;
+				currentCounters().add(Internal::WorkerCounters::unparks);
+				return true;
 			}
 		}
-		else
+
+		// The fences of the domain wakes order this load after the task's publication, if the keeper isn't there yet
+		// it will find the task before it sleeps.
+		if (_timer_keeper.test(std::memory_order_relaxed) && _timer_wait.notifyOne())
 		{
-			const bool push_succeed = _global_tasks.push(std::move(packaged_task));
-            if (!push_succeed)
-            {
-            	return std::nullopt;
-            }
+			currentCounters().add(Internal::WorkerCounters::unparks);
+			return true;
 		}
+		return false;
+	}
 
-		return future;
+	void wakeAllWorkers () noexcept
+	{
+		for (const std::unique_ptr<Domain>& domain : _domains)
+		{
+			domain->idle.notify();
+		}
+		_timer_wait.notify();
 	}
-};
+
+	/**
+	 * The workers of each domain and their CPUs, or no CPUs if they aren't pinned. An elastic pool has a single domain
+	 * with a slot for each of its max_workers workers, and starts min_workers of them.
+	 */
+	ThreadPool (const std::vector<size_t>& workers_per_domain, std::vector<int> worker_cpus,
+				const StealPolicy steal_policy, const std::optional<ElasticLimits>& elastic_limits = std::nullopt)
+		: _worker_cpus(std::move(worker_cpus)), _steal_policy(steal_policy), _elastic(elastic_limits.has_value())
+	{
+		_timer_wait.spin_limit	= idle_spin_limit;
+		_timer_wait.yield_limit	= idle_yield_limit;
+
+		// Every queue must exist before a worker starts looking at the others.
+		for (const size_t number_of_workers : workers_per_domain)
+		{
+			auto domain = std::make_unique<Domain>();
+			domain->idle.spin_limit		= idle_spin_limit;
+			domain->idle.yield_limit	= idle_yield_limit;
+			domain->first_worker		= _worker_domains.size();
+			domain->number_of_workers	= number_of_workers;
+
+			_worker_domains.insert(_worker_domains.end(), number_of_workers, _domains.size());
+			_domains.push_back(std::move(domain));
+		}
+
+		const size_t number_of_threads = _worker_domains.size();
+		_local_tasks_queues.reserve(number_of_threads);
+		for (size_t i = 0; i < number_of_threads; ++i)
+		{
+			_local_tasks_queues.emplace_back();
+		}
+		_steal_counters = std::vector<StealCounters>(number_of_threads + 1);
+		_worker_counters = std::vector<Internal::WorkerCounters>(number_of_threads + 1);
+
+		_limits = elastic_limits.value_or(ElasticLimits {.min_workers = number_of_threads,
+														 .max_workers = number_of_threads});
+
+		std::lock_guard lock(_workers_mutex);
+		_threads.resize(number_of_threads);
+		for (size_t i = number_of_threads; i > _limits.min_workers; --i)
+		{
+			_free_slots.push_back(i - 1);
+		}
+		for (size_t i = 0; i < _limits.min_workers; ++i)
+		{
+			_threads[i] = std::jthread(&ThreadPool::workerFunc, this, i);
+			_live_workers.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+
+	static ElasticLimits checkedLimits (ElasticLimits limits)
+	{
+		limits.max_workers = std::max<size_t>(limits.max_workers, 1);
+		limits.min_workers = std::clamp<size_t>(limits.min_workers, 1, limits.max_workers);
+		return limits;
+	}
+
+	// A topology without CPUs still gets an unpinned worker, a pool without workers never runs its tasks.
+	static std::vector<size_t> workersPerDomain (const CpuTopology& topology)
+	{
+		std::vector<size_t> workers_per_domain;
+		for (const std::vector<int>& domain : topology.domains)
+		{
+			workers_per_domain.push_back(domain.size());
+		}
+		if (topology.numberOfCpus() == 0)
+		{
+			workers_per_domain.assign(std::max<size_t>(workers_per_domain.size(), 1), 0);
+			workers_per_domain.front() = 1;
+		}
+		return workers_per_domain;
+	}
+
+	static std::vector<int> workerCpus (const CpuTopology& topology)
+	{
+		std::vector<int> worker_cpus;
+		if (topology.pin_workers)
+		{
+			for (const std::vector<int>& domain : topology.domains)
+			{
+				worker_cpus.insert(worker_cpus.end(), domain.begin(), domain.end());
+			}
+		}
+		return worker_cpus;
+	}
+
+public:
+	// At most one worker per CPU, and at least one: a pool without workers never runs its tasks.
+    explicit ThreadPool(const size_t number_of_threads = std::thread::hardware_concurrency(),
+    					const StealPolicy steal_policy = StealPolicy::One)
+		: ThreadPool(std::vector<size_t>{std::clamp<size_t>(number_of_threads, 1,
+															std::max(std::thread::hardware_concurrency(), 1u))},
+					 {}, steal_policy)
+	{
+	}
+
+	/**
+	 * One worker per CPU of the topology, pinned to it if topology.pin_workers. Idle workers steal from the workers of
+	 * their own domain before the others, and postToDomain and submitToDomain queue tasks for one domain.
+	 */
+	explicit ThreadPool(const CpuTopology& topology, const StealPolicy steal_policy = StealPolicy::One)
+		: ThreadPool(workersPerDomain(topology), workerCpus(topology), steal_policy)
+	{
+	}
+
+	/**
+	 * An elastic pool: between limits.min_workers and limits.max_workers workers, see ElasticLimits. Unlike the fixed
+	 * pool, max_workers isn't capped to the number of CPUs: tasks that block in a BlockingRegion don't use one.
+	 */
+	explicit ThreadPool(const ElasticLimits& limits, const StealPolicy steal_policy = StealPolicy::One)
+		: ThreadPool(std::vector<size_t>{checkedLimits(limits).max_workers}, {}, steal_policy, checkedLimits(limits))
+	{
+	}
+
+	// Runs every queued task before the workers exit, unless shutdown was called before.
+	~ThreadPool ()
+    {
+    	shutdown(DrainPolicy::drainAll());
+    }
+
+	/**
+	 * Stop accepting tasks from outside the pool, wait for the pool to run out of tasks as the policy says, then stop
+	 * and join the workers. The tasks still queued after that are destroyed without running: the futures of submit and
+	 * spawn report std::future_error(broken_promise). The pool's own tasks that something waits for, e.g. the halves of a
+	 * parallelFor, run on the calling thread instead.
+	 * Running tasks can still queue tasks until the workers stop, so a task waiting for its own subtasks completes.
+	 * Timers not due by then are dropped as well, and periodic timers stop.
+	 * Returns the number of dropped tasks. Only the first call does anything. Must not be called from a task of the pool.
+	 */
+	size_t shutdown (const DrainPolicy policy = DrainPolicy::drainAll())
+	{
+		if (_shutting_down.test_and_set(std::memory_order_seq_cst))
+		{
+			return 0;
+		}
+		// Producers blocked on a full queue give up.
+		_queue_space.notify();
+
+		if (policy.deadline != RingWaitClock::time_point::min())
+		{
+			waitIdle(policy.deadline);
+		}
+
+		// No worker is added once _done is set, and the workers are joined without the lock a retiring worker takes.
+		std::vector<std::jthread> threads;
+		{
+			std::lock_guard lock(_workers_mutex);
+			_done.test_and_set(std::memory_order_relaxed);
+			threads = std::move(_threads);
+		}
+		wakeAllWorkers();
+		threads.clear();
+
+		return dropPendingTasks();
+	}
+
+	[[nodiscard]] PoolState state () const noexcept
+	{
+		if (_done.test(std::memory_order_relaxed))
+		{
+			return PoolState::Stopping;
+		}
+		return _shutting_down.test(std::memory_order_relaxed) ? PoolState::Draining : PoolState::Running;
+	}
+
+	/**
+	 * Block until every queued task has run, or until the deadline. Returns whether the pool is idle.
+	 * Tasks can be submitted meanwhile, a pool that never runs out of tasks is never idle.
+	 * Must not be called from a task of the pool, that task itself counts as pending.
+	 */
+	bool waitIdle (const RingWaitClock::time_point deadline = RingWaitClock::time_point::max())
+	{
+		return _drained.waitUntil(deadline, [this]()
+		{
+			return _pending_tasks.load(std::memory_order_acquire) == 0;
+		});
+	}
+
+
+	// Workers running right now. Changes over time in an elastic pool.
+	[[nodiscard]] size_t numberOfWorkers () const noexcept
+	{
+		return _live_workers.load(std::memory_order_relaxed);
+	}
+
+	/**
+	 * Marks a task of an elastic pool as blocked, e.g. on I/O, from construction to destruction. If that leaves fewer
+	 * than min_workers workers to run tasks, the pool adds one, up to max_workers. Does nothing on a fixed pool or
+	 * outside a worker of the pool.
+	 */
+	class [[nodiscard]] BlockingRegion
+	{
+	private:
+		ThreadPool* _thread_pool;
+
+	public:
+		explicit BlockingRegion (ThreadPool& thread_pool)
+			: _thread_pool(thread_pool._elastic && thread_pool.isCurrentThreadOwnWorker() ? &thread_pool : nullptr)
+		{
+			if (_thread_pool != nullptr)
+			{
+				_thread_pool->_blocked_workers.fetch_add(1, std::memory_order_relaxed);
+				_thread_pool->addWorkerIfNeeded();
+			}
+		}
+
+		BlockingRegion (const BlockingRegion&)				= delete;
+		BlockingRegion& operator= (const BlockingRegion&)	= delete;
+
+		~BlockingRegion ()
+		{
+			if (_thread_pool != nullptr)
+			{
+				_thread_pool->_blocked_workers.fetch_sub(1, std::memory_order_relaxed);
+			}
+		}
+	};
+
+	BlockingRegion blockingRegion ()
+	{
+		return BlockingRegion(*this);
+	}
+
+	/**
+	 * Snapshot of the pool's counters, see ThreadPoolMetrics. Reads a few cache lines per worker and takes no lock, so
+	 * it can be called at any time from any thread, e.g. every second by a metrics exporter.
+	 */
+	ThreadPoolMetrics metrics () const
+	{
+		ThreadPoolMetrics metrics;
+		metrics.number_of_workers	= numberOfWorkers();
+		metrics.pending_tasks		= _pending_tasks.load(std::memory_order_relaxed);
+		metrics.workers.resize(_worker_counters.size());
+
+		for (size_t i = 0; i < _worker_counters.size(); ++i)
+		{
+			using Counter = Internal::WorkerCounters::Counter;
+			const Internal::WorkerCounters& counters	= _worker_counters[i];
+			const StealCounters&            steals		= _steal_counters[i];
+			WorkerMetrics&                  worker		= metrics.workers[i];
+
+			worker.local_pickups	= counters.get(Counter::local_pickups);
+			worker.shared_pickups	= counters.get(Counter::shared_pickups);
+			worker.shared_pushes	= counters.get(Counter::shared_pushes);
+			worker.idle_spins		= counters.get(Counter::idle_spins);
+			worker.parks			= counters.get(Counter::parks);
+			worker.unparks			= counters.get(Counter::unparks);
+			worker.idle_time		= std::chrono::nanoseconds(counters.get(Counter::idle_nanoseconds));
+
+			const uint64_t steal_attempts = steals.attempts.load(std::memory_order_relaxed);
+			worker.stolen_pickups	= steals.successes.load(std::memory_order_relaxed);
+			worker.failed_steals	= steal_attempts > worker.stolen_pickups ? steal_attempts - worker.stolen_pickups : 0;
+
+			if (i < _local_tasks_queues.size())
+			{
+				worker.local_queue_depth = _local_tasks_queues[i].size();
+			}
+
+#if CONCURRENCY_THREADPOOL_TASK_HISTOGRAMS
+			counters.queue_wait.addTo(metrics.queue_wait);
+			counters.run_time.addTo(metrics.run_time);
+#endif
+		}
+
+		metrics.shared_queue_depth	= _shared_tasks.load(std::memory_order_relaxed);
+		metrics.blocked_producers	= _blocked_producers.load(std::memory_order_relaxed);
+		return metrics;
+	}
+
+	StealStatistics stealStatistics () const noexcept
+	{
+		StealStatistics statistics;
+		for (const StealCounters& counters : _steal_counters)
+		{
+			statistics.attempts		+= counters.attempts.load(std::memory_order_relaxed);
+			statistics.successes	+= counters.successes.load(std::memory_order_relaxed);
+			statistics.stolen_tasks	+= counters.stolen_tasks.load(std::memory_order_relaxed);
+		}
+		return statistics;
+	}
+
+	static bool isCurrentThreadAPoolThread ()
+    {
+    	return _this_thread_local_tasks != nullptr;
+    }
+
+	// Run one pending task if there is any, otherwise yield the thread. Returns whether a task ran.
+	bool runPendingTask ()
+    {
+    	std::optional<MovableFunction> task = findPendingTask();
+    	if (task.has_value())
+    	{
+    		runTask(task.value());
+    		return true;
+    	}
+
+    	// No task in the task queues. Yield the thread to the OS.
+    	std::this_thread::yield();
+    	return false;
+    }
+
+	/**
+	 * Run pending tasks until is_ready(), block with block() once the pool has had nothing to run for a while.
+	 * block() must return once is_ready() holds, it may return earlier.
+	 */
+	template<typename IsReady, typename Block>
+	void helpUntil (IsReady is_ready, Block block)
+	{
+		uint32_t failed_attempts = 0;
+		while (!is_ready())
+		{
+			if (runPendingTask())
+			{
+				failed_attempts = 0;
+			}
+			else if (++failed_attempts >= help_attempts)
+			{
+				block();
+			}
+		}
+	}
+
+	/**
+	 * Bound the shared queues for threads outside the pool, see QueueBound and OverflowPolicy. Can be changed at any
+	 * time, tasks already queued beyond a lower capacity stay queued. The pool starts unbounded.
+	 */
+	void setQueueBound (const QueueBound bound) noexcept
+	{
+		_overflow_policy.store(bound.policy, std::memory_order_relaxed);
+		_queue_capacity.store(std::max<size_t>(bound.capacity, 1), std::memory_order_relaxed);
+		// Blocked producers look again, there may be room now or they may have to follow another policy.
+		_queue_space.notify();
+	}
+
+	template<typename Func>
+	std::optional<std::future<std::invoke_result_t<Func>>> submit (Func function,
+																   const TaskPriority priority = TaskPriority::Normal)
+	{
+		using FuncReturnType = std::invoke_result_t<Func>;
+		std::packaged_task<FuncReturnType()> packaged_task(function);
+		auto future = packaged_task.get_future();
+
+		if (!pushTask(std::move(packaged_task), priority))
+		{
+			return std::nullopt;
+		}
+		return future;
+	}
+
+	// submit that never waits for room or runs the task itself: with full shared queues it fails, whatever the policy.
+	template<typename Func>
+	std::optional<std::future<std::invoke_result_t<Func>>> trySubmit (Func function,
+																	  const TaskPriority priority = TaskPriority::Normal)
+	{
+		using FuncReturnType = std::invoke_result_t<Func>;
+		std::packaged_task<FuncReturnType()> packaged_task(function);
+		auto future = packaged_task.get_future();
+
+		if (!pushTask(std::move(packaged_task), priority, true))
+		{
+			return std::nullopt;
+		}
+		return future;
+	}
+
+	/**
+	 * Fire and forget: no future, no shared state. A small trivially copyable callable doesn't allocate at all.
+	 * Returns false if the task couldn't be queued.
+	 */
+	template<typename Func>
+	bool post (Func&& function, const TaskPriority priority = TaskPriority::Normal)
+	{
+		return pushTask(MovableFunction(std::forward<Func>(function)), priority);
+	}
+
+	/**
+	 * submit and post for a task that is dropped without running if token is cancelled before it starts: the future
+	 * reports std::future_error(broken_promise). While it runs, token is CancellationToken::current(), the task polls
+	 * it with InterruptibleThread::isInterrupted() or CancellationToken::isCurrentCancelled().
+	 * A cancelled task keeps its place in the queue until a worker gets to it, which then costs a pop and no run.
+	 */
+	template<typename Func>
+	std::optional<std::future<std::invoke_result_t<Func>>> submit (const CancellationToken& token, Func function,
+																   const TaskPriority priority = TaskPriority::Normal)
+	{
+		using FuncReturnType = std::invoke_result_t<Func>;
+		std::packaged_task<FuncReturnType()> packaged_task(function);
+		auto future = packaged_task.get_future();
+
+		if (!pushTask(cancellable(token, std::move(packaged_task)), priority))
+		{
+			return std::nullopt;
+		}
+		return future;
+	}
+
+	template<typename Func>
+	bool post (const CancellationToken& token, Func&& function, const TaskPriority priority = TaskPriority::Normal)
+	{
+		return pushTask(cancellable(token, std::forward<Func>(function)), priority);
+	}
+
+	/**
+	 * submit for a point in time: run function once due, or once delay has passed. Timers have no thread of their own,
+	 * the earliest is waited for by an idle worker, and busy workers look at them between tasks, so they fire late
+	 * only when every worker is stuck in a long task.
+	 * A timer becomes a pending task once due: waitIdle doesn't wait for it, and shutdown drops the timers not due yet,
+	 * their futures report std::future_error(broken_promise). Fails once shutdown was called.
+	 */
+	template<typename Func>
+	std::optional<std::future<std::invoke_result_t<Func>>> submitAt (const RingWaitClock::time_point due, Func function)
+	{
+		using FuncReturnType = std::invoke_result_t<Func>;
+		std::packaged_task<FuncReturnType()> packaged_task(function);
+		auto future = packaged_task.get_future();
+
+		if (!pushTimer(due, std::move(packaged_task)))
+		{
+			return std::nullopt;
+		}
+		return future;
+	}
+
+	template<typename Func, typename Rep, typename Period>
+	std::optional<std::future<std::invoke_result_t<Func>>> submitAfter (const std::chrono::duration<Rep, Period> delay,
+																		Func function)
+	{
+		return submitAt(RingWaitClock::now() + std::chrono::ceil<RingWaitClock::duration>(delay), std::move(function));
+	}
+
+	/**
+	 * Run function every period, the first time one period from now, until the timer is cancelled or the pool shuts
+	 * down. Runs never overlap: a run that ends late skips the periods it missed instead of catching up. function runs
+	 * like a posted task, its exceptions aren't caught.
+	 */
+	template<typename Func, typename Rep, typename Period>
+	std::optional<PeriodicTimer> submitEvery (const std::chrono::duration<Rep, Period> period, Func function)
+	{
+		const auto tick  = std::max(std::chrono::ceil<RingWaitClock::duration>(period), RingWaitClock::duration(1));
+		auto       state = std::make_shared<PeriodicTask<Func>>(std::move(function), tick);
+		PeriodicTimer timer(std::shared_ptr<Internal::PeriodicTimerState>(state, &state->timer));
+
+		if (!pushPeriodicTask(std::move(state), RingWaitClock::now() + tick))
+		{
+			return std::nullopt;
+		}
+		return timer;
+	}
+
+	[[nodiscard]] size_t numberOfDomains () const noexcept
+	{
+		return _domains.size();
+	}
+
+	/**
+	 * post and submit for the workers of one domain of the pool's CpuTopology, e.g. to run a task on the NUMA node
+	 * that holds its data. Workers of other domains only run it when they have nothing else to do.
+	 * Fail if domain isn't below numberOfDomains().
+	 */
+	template<typename Func>
+	bool postToDomain (const size_t domain, Func&& function)
+	{
+		return pushTaskToDomain(domain, MovableFunction(std::forward<Func>(function)));
+	}
+
+	template<typename Func>
+	std::optional<std::future<std::invoke_result_t<Func>>> submitToDomain (const size_t domain, Func function)
+	{
+		using FuncReturnType = std::invoke_result_t<Func>;
+		std::packaged_task<FuncReturnType()> packaged_task(function);
+		auto future = packaged_task.get_future();
+
+		if (!pushTaskToDomain(domain, std::move(packaged_task)))
+		{
+			return std::nullopt;
+		}
+		return future;
+	}
+
+	/**
+	 * Like submit, with a TaskFuture instead of std::future: the function, its result and the state shared with the
+	 * future are one allocation, and waiting on the future runs other pending tasks of the pool meanwhile.
+	 */
+	template<typename Func>
+	std::optional<TaskFuture<std::invoke_result_t<std::decay_t<Func>&>>>
+	spawn (Func&& function, const TaskPriority priority = TaskPriority::Normal)
+	{
+		using FuncType       = std::decay_t<Func>;
+		using FuncReturnType = std::invoke_result_t<FuncType&>;
+
+		auto* state = new Internal::TaskState<FuncReturnType, FuncType>(FuncType(std::forward<Func>(function)));
+		TaskFuture<FuncReturnType> future(state, *this);
+
+		if (!pushTask(MovableFunction(Internal::SpawnedTask<FuncReturnType, FuncType>(state)), priority))
+		{
+			return std::nullopt;
+		}
+		return future;
+	}
+
+	// Awaiter of schedule(), see below.
+	class ScheduleAwaiter
+	{
+	private:
+		ThreadPool& _thread_pool;
+		TaskPriority _priority;
+
+	public:
+		ScheduleAwaiter (ThreadPool& thread_pool, const TaskPriority priority) noexcept
+			: _thread_pool(thread_pool), _priority(priority)
+		{
+		}
+
+		bool await_ready () const noexcept
+		{
+			return false;
+		}
+
+		// Keep running on this thread if the pool doesn't take tasks anymore.
+		bool await_suspend (const std::coroutine_handle<> handle)
+		{
+			return _thread_pool.pushTask(MovableFunction(Internal::MustRunTask {[handle]() { handle.resume(); }}),
+										 _priority);
+		}
+
+		void await_resume () const noexcept
+		{
+		}
+	};
+
+	/**
+	 * `co_await thread_pool.schedule()` suspends the calling coroutine and resumes it as a task of the pool.
+	 * If the pool is shutting down the coroutine continues on the calling thread instead.
+	 */
+	ScheduleAwaiter schedule (const TaskPriority priority = TaskPriority::Normal) noexcept
+	{
+		return ScheduleAwaiter(*this, priority);
+	}
+
+	/**
+	 * spawn for every callable of the range, with a single wake-up of the idle workers for the whole batch.
+	 * The callables are moved out of the range if it is an rvalue, copied otherwise.
+	 * Returns std::nullopt if a task couldn't be queued. The tasks queued before it still run, the others are dropped.
+	 */
+	template<std::ranges::input_range Range>
+	requires std::invocable<std::ranges::range_value_t<Range>&>
+	std::optional<std::vector<TaskFuture<std::invoke_result_t<std::ranges::range_value_t<Range>&>>>>
+	submitBulk (Range&& callables)
+	{
+		using FuncType       = std::ranges::range_value_t<Range>;
+		using FuncReturnType = std::invoke_result_t<FuncType&>;
+
+		std::vector<TaskFuture<FuncReturnType>> futures;
+		if constexpr (std::ranges::sized_range<Range>)
+		{
+			futures.reserve(std::ranges::size(callables));
+		}
+
+		bool push_succeed = true;
+		for (auto&& callable : callables)
+		{
+			Internal::TaskState<FuncReturnType, FuncType>* state = nullptr;
+			if constexpr (std::is_lvalue_reference_v<Range>)
+			{
+				state = new Internal::TaskState<FuncReturnType, FuncType>(FuncType(callable));
+			}
+			else
+			{
+				state = new Internal::TaskState<FuncReturnType, FuncType>(FuncType(std::move(callable)));
+			}
+			futures.push_back(TaskFuture<FuncReturnType>(state, *this));
+
+			if (!enqueueTask(MovableFunction(Internal::SpawnedTask<FuncReturnType, FuncType>(state))))
+			{
+				push_succeed = false;
+				break;
+			}
+		}
+
+		if (futures.size() > 1)
+		{
+			wakeAllWorkers();
+			addWorkerIfNeeded();
+		}
+		else if (!wakeWorker(currentDomain()))
+		{
+			addWorkerIfNeeded();
+		}
+
+		if (!push_succeed)
+		{
+			return std::nullopt;
+		}
+		return futures;
+	}
+
+	/**
+	 * Call function for every index in [begin, end), or every element for a pair of iterators, and return once all
+	 * calls are done. function is called concurrently from several threads.
+	 *
+	 * Lazy binary splitting: the calling thread works through the range grain elements at a time and, when no
+	 * previously split off half is still waiting to be taken, pushes the second half of what's left as a task first.
+	 * Threads that take such a half do the same, so a large range costs a number of tasks close to the number of
+	 * threads that were idle to take them, not one task per grain.
+	 * The calling thread helps the pool until the whole range is done. The first exception thrown by function is
+	 * rethrown once every started call has returned, the elements not started yet are skipped.
+	 */
+	template<typename Index, typename Func>
+	requires (std::integral<Index> || std::random_access_iterator<Index>)
+	void parallelFor (Index begin, Index end, const size_t grain, Func&& function)
+	{
+		if (!(begin < end))
+		{
+			return;
+		}
+
+		using State = Internal::ParallelForState<std::remove_reference_t<Func>>;
+		auto* state = new State(function, static_cast<size_t>(end - begin));
+
+		runParallelForRange(state, begin, end, std::max<size_t>(grain, 1));
+		helpUntil([state]() { return state->isFinished(); }, [state]() { state->finished.wait(0); });
+
+		std::exception_ptr exception = std::move(state->exception);
+		state->release();
+		if (exception)
+		{
+			std::rethrow_exception(exception);
+		}
+	}
+
+private:
+	// Queue a task without waking any worker, in the domain's queue if there is one.
+	bool enqueueTask (MovableFunction&& task, const TaskPriority priority = TaskPriority::Normal,
+					  Domain* domain = nullptr, const bool fail_if_full = false)
+	{
+		const bool own_worker = isCurrentThreadOwnWorker();
+
+		// Counted before the shutdown check, shutdown sets the flag before it looks at the count: either shutdown
+		// waits for this task or this task sees the flag.
+		_pending_tasks.fetch_add(1, std::memory_order_seq_cst);
+		if (!own_worker && _shutting_down.test(std::memory_order_seq_cst))
+		{
+			finishTask();
+			return false;
+		}
+
+#if CONCURRENCY_THREADPOOL_TASK_HISTOGRAMS
+		const bool must_run = task.mustRun();
+		auto timed_task = [this, queued_at = RingWaitClock::now(), task = std::move(task)]() mutable
+		{
+			Internal::WorkerCounters&       counters	= currentCounters();
+			const RingWaitClock::time_point started_at	= RingWaitClock::now();
+			counters.queue_wait.record(started_at - queued_at);
+			task();
+			counters.run_time.record(RingWaitClock::now() - started_at);
+		};
+		task = must_run ? MovableFunction(Internal::MustRunTask {std::move(timed_task)})
+						: MovableFunction(std::move(timed_task));
+#endif
+
+		const bool shared_queue = domain != nullptr || !own_worker || priority != TaskPriority::Normal;
+		if (shared_queue)
+		{
+			switch (admitSharedTask(own_worker, fail_if_full))
+			{
+			case Admission::Queue:
+				break;
+			case Admission::RunHere:
+				runTask(task);
+				return true;
+			case Admission::Reject:
+				finishTask();
+				return false;
+			}
+		}
+
+		bool push_succeed = false;
+		if (domain != nullptr)
+		{
+			push_succeed = domain->tasks.push(std::move(task));
+		}
+		else if (!shared_queue)
+		{
+			push_succeed = _local_tasks_queues[_this_thread_idx].enqueue(std::move(task));
+		}
+		else
+		{
+			push_succeed = _global_tasks[static_cast<size_t>(priority)].push(std::move(task));
+		}
+
+		if (!push_succeed)
+		{
+			if (shared_queue)
+			{
+				releaseSharedPlace();
+			}
+			finishTask();
+		}
+		else if (shared_queue)
+		{
+			currentCounters().add(Internal::WorkerCounters::shared_pushes);
+		}
+		return push_succeed;
+	}
+
+	enum class Admission
+	{
+		Queue,
+		RunHere,
+		Reject
+	};
+
+	// Take a place in the shared queues for a task, or apply the overflow policy if they are full.
+	Admission admitSharedTask (const bool own_worker, const bool fail_if_full)
+	{
+		if (own_worker || _queue_capacity.load(std::memory_order_relaxed) == QueueBound().capacity)
+		{
+			_shared_tasks.fetch_add(1, std::memory_order_relaxed);
+			return Admission::Queue;
+		}
+
+		while (!tryReserveSharedPlace())
+		{
+			const OverflowPolicy policy = fail_if_full ? OverflowPolicy::FailFast
+													   : _overflow_policy.load(std::memory_order_relaxed);
+			switch (policy)
+			{
+			case OverflowPolicy::Block:
+				_blocked_producers.fetch_add(1, std::memory_order_relaxed);
+				_queue_space.waitUntil(RingWaitClock::time_point::max(), [this]()
+				{
+					return _shared_tasks.load(std::memory_order_relaxed) < _queue_capacity.load(std::memory_order_relaxed)
+						|| _shutting_down.test(std::memory_order_relaxed);
+				});
+				_blocked_producers.fetch_sub(1, std::memory_order_relaxed);
+				if (_shutting_down.test(std::memory_order_relaxed))
+				{
+					return Admission::Reject;
+				}
+				break;
+			case OverflowPolicy::FailFast:
+				return Admission::Reject;
+			case OverflowPolicy::CallerRuns:
+				return Admission::RunHere;
+			case OverflowPolicy::DropOldest:
+				if (!dropOldestSharedTask())
+				{
+					// The queued tasks were all taken meanwhile, or the places are reserved by pushes on their way in.
+					_shared_tasks.fetch_add(1, std::memory_order_relaxed);
+					return Admission::Queue;
+				}
+				break;
+			}
+		}
+		return Admission::Queue;
+	}
+
+	bool tryReserveSharedPlace () noexcept
+	{
+		const size_t capacity		= _queue_capacity.load(std::memory_order_relaxed);
+		size_t       shared_tasks	= _shared_tasks.load(std::memory_order_relaxed);
+		while (shared_tasks < capacity)
+		{
+			if (_shared_tasks.compare_exchange_weak(shared_tasks, shared_tasks + 1, std::memory_order_relaxed))
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void releaseSharedPlace () noexcept
+	{
+		_shared_tasks.fetch_sub(1, std::memory_order_relaxed);
+		// Only a bounded queue can have producers waiting, an unbounded one doesn't pay for the fence of notifyOne.
+		if (_queue_capacity.load(std::memory_order_relaxed) != QueueBound().capacity)
+		{
+			_queue_space.notifyOne();
+		}
+	}
+
+	/**
+	 * DropOldest: the oldest task of the lowest priority queue that has one, then of the domain queues. The pool's own
+	 * tasks that must run are run by the caller instead of dropped.
+	 */
+	bool dropOldestSharedTask ()
+	{
+		std::optional<MovableFunction> task;
+		for (size_t priority = number_of_priorities; !task.has_value() && priority-- > 0;)
+		{
+			task = _global_tasks[priority].pop();
+		}
+		for (size_t i = 0; !task.has_value() && i < _domains.size(); ++i)
+		{
+			task = _domains[i]->tasks.pop();
+		}
+		if (!task.has_value())
+		{
+			return false;
+		}
+
+		releaseSharedPlace();
+		if (task->mustRun())
+		{
+			// A parallelFor, TaskGraph or coroutine waits for it: run it instead, which frees its place all the same.
+			runTask(*task);
+			return true;
+		}
+		task.reset();
+		finishTask();
+		return true;
+	}
+
+	void finishTask () noexcept
+	{
+		if (_pending_tasks.fetch_sub(1, std::memory_order_acq_rel) == 1)
+		{
+			_drained.notify();
+		}
+	}
+
+	void runTask (MovableFunction& task)
+	{
+		struct Finish
+		{
+			ThreadPool* thread_pool;
+			~Finish () { thread_pool->finishTask(); }
+		} finish {this};
+
+		task();
+	}
+
+	/**
+	 * Only once the workers are joined. The tasks that must run are run here: the pool rejects the tasks they queue,
+	 * parallelFor, TaskGraph and coroutines then continue on this thread.
+	 */
+	size_t dropPendingTasks ()
+	{
+		size_t dropped_tasks = 0;
+		const auto drop = [this, &dropped_tasks](MovableFunction& task)
+		{
+			if (task.mustRun())
+			{
+				runTask(task);
+			}
+			else
+			{
+				++dropped_tasks;
+			}
+		};
+
+		for (LockFreeQueue<MovableFunction>& global_tasks : _global_tasks)
+		{
+			for (std::optional<MovableFunction> task = global_tasks.pop(); task.has_value(); task = global_tasks.pop())
+			{
+				drop(*task);
+			}
+		}
+		for (const std::unique_ptr<Domain>& domain : _domains)
+		{
+			for (std::optional<MovableFunction> task = domain->tasks.pop(); task.has_value(); task = domain->tasks.pop())
+			{
+				drop(*task);
+			}
+		}
+		for (WorkStealingQueue& local_tasks : _local_tasks_queues)
+		{
+			for (std::optional<MovableFunction> task = local_tasks.dequeue(); task.has_value();
+				 task = local_tasks.dequeue())
+			{
+				drop(*task);
+			}
+		}
+
+		if (dropped_tasks != 0)
+		{
+			_pending_tasks.fetch_sub(dropped_tasks, std::memory_order_acq_rel);
+		}
+		_shared_tasks.store(0, std::memory_order_relaxed);
+
+		// Timers aren't pending tasks.
+		return dropped_tasks + _timers.clear();
+	}
+
+	bool pushTask (MovableFunction&& task, const TaskPriority priority = TaskPriority::Normal,
+				   const bool fail_if_full = false)
+	{
+		if (!enqueueTask(std::move(task), priority, nullptr, fail_if_full))
+		{
+			return false;
+		}
+
+		// Idle workers park, wake one for the new task, in our domain if one sleeps there.
+		if (!wakeWorker(currentDomain()))
+		{
+			addWorkerIfNeeded();
+		}
+		return true;
+	}
+
+	template<typename Func>
+	struct CancellableTask
+	{
+		// A CancellationToken is a std::shared_ptr, which holds no pointer into itself.
+		static constexpr bool trivially_relocatable = Internal::is_trivially_relocatable_v<Func>;
+
+		CancellationToken	token;
+		Func				function;
+
+		void operator()()
+		{
+			if (token.isCancelled())
+			{
+				return;
+			}
+
+			CancellationToken::Scope scope(token);
+			function();
+		}
+	};
+
+	template<typename Func>
+	static MovableFunction cancellable (const CancellationToken& token, Func&& function)
+	{
+		return MovableFunction(CancellableTask<std::decay_t<Func>> {token, std::forward<Func>(function)});
+	}
+
+	// Queue a task for a point in time, and make sure a worker waits for it if it is the earliest.
+	bool pushTimer (const RingWaitClock::time_point due, MovableFunction&& task)
+	{
+		bool became_first = false;
+		// A push that passed the check while shutdown() ran fails too, clearing the timers closes their queue.
+		if (_shutting_down.test(std::memory_order_seq_cst) || !_timers.push(due, std::move(task), became_first))
+		{
+			return false;
+		}
+
+		// Pairs with the keeper leaving its role: either it sees the timer and hands over, or we see it has left.
+		if (!_timer_keeper.test(std::memory_order_seq_cst))
+		{
+			wakeWorker(currentDomain());
+		}
+		else if (became_first)
+		{
+			_timer_wait.notify();
+		}
+		return true;
+	}
+
+	template<typename Func>
+	struct PeriodicTask
+	{
+		PeriodicTask (Func&& function, const RingWaitClock::duration period)
+			: function(std::move(function)), period(period)
+		{
+		}
+
+		Internal::PeriodicTimerState	timer;
+		Func							function;
+		RingWaitClock::duration			period;
+	};
+
+	// Every run queues the next one once it is done, at the first multiple of the period still ahead.
+	template<typename Func>
+	bool pushPeriodicTask (std::shared_ptr<PeriodicTask<Func>> state, const RingWaitClock::time_point due)
+	{
+		return pushTimer(due, MovableFunction([this, state = std::move(state), due]() mutable
+		{
+			{
+				const Internal::PeriodicTimerState::Run run(state->timer);
+				if (!run.started())
+				{
+					return;
+				}
+				state->function();
+			}
+
+			const RingWaitClock::time_point now  = RingWaitClock::now();
+			RingWaitClock::time_point       next = due + state->period;
+			if (next <= now)
+			{
+				next += ((now - next) / state->period + 1) * state->period;
+			}
+			if (!state->timer.isCancelled())
+			{
+				pushPeriodicTask(std::move(state), next);
+			}
+		}));
+	}
+
+	bool pushTaskToDomain (const size_t domain, MovableFunction&& task)
+	{
+		if (domain >= _domains.size() || !enqueueTask(std::move(task), TaskPriority::Normal, _domains[domain].get()))
+		{
+			return false;
+		}
+
+		// Only the domain's own workers: a busy domain is better than running the task far from its data.
+		_domains[domain]->idle.notifyOne();
+		return true;
+	}
+
+	// Domain of the calling worker. Threads outside the pool spread their wake-ups over the domains.
+	size_t currentDomain () noexcept
+	{
+		if (isCurrentThreadOwnWorker())
+		{
+			return _worker_domains[_this_thread_idx];
+		}
+		return _domains.size() == 1 ? 0 : randomVictim(_domains.size());
+	}
+
+	template<typename Index, typename Func>
+	void runParallelForRange (Internal::ParallelForState<Func>* state, Index begin, Index end, const size_t grain)
+	{
+		using Difference = decltype(end - begin);
+
+		size_t processed = 0;
+		while (static_cast<size_t>(end - begin) > grain)
+		{
+			if (state->unclaimed.load(std::memory_order_relaxed) == 0)
+			{
+				end = splitParallelForRange(state, begin, end, grain);
+			}
+
+			// The half left after a split can be shorter than a grain.
+			const size_t chunk_size = std::min(grain, static_cast<size_t>(end - begin));
+			const Index  chunk_end  = begin + static_cast<Difference>(chunk_size);
+			runParallelForChunk(state, begin, chunk_end);
+			processed += chunk_size;
+			begin = chunk_end;
+		}
+		runParallelForChunk(state, begin, end);
+		processed += static_cast<size_t>(end - begin);
+
+		// A split off half is counted by the thread that runs it.
+		state->complete(processed);
+	}
+
+	// Queue the second half of [begin, end) as a task, returns the end of what's left for the calling thread.
+	template<typename Index, typename Func>
+	Index splitParallelForRange (Internal::ParallelForState<Func>* state, const Index begin, const Index end,
+								 const size_t grain)
+	{
+		const Index middle = begin + (end - begin) / 2;
+
+		state->unclaimed.fetch_add(1, std::memory_order_relaxed);
+		state->acquire();
+		const bool push_succeed = pushTask(MovableFunction(Internal::MustRunTask {[this, state, middle, end, grain]()
+		{
+			state->unclaimed.fetch_sub(1, std::memory_order_relaxed);
+			runParallelForRange(state, middle, end, grain);
+			state->release();
+		}}));
+
+		if (!push_succeed)
+		{
+			state->unclaimed.fetch_sub(1, std::memory_order_relaxed);
+			state->release();
+			return end;
+		}
+		return middle;
+	}
+
+	template<typename Index, typename Func>
+	static void runParallelForChunk (Internal::ParallelForState<Func>* state, const Index begin, const Index end)
+	{
+		if (state->failed.load(std::memory_order_relaxed))
+		{
+			return;
+		}
+
+		try
+		{
+			for (Index i = begin; i != end; ++i)
+			{
+				if constexpr (std::integral<Index>)
+				{
+					std::invoke(state->function, i);
+				}
+				else
+				{
+					std::invoke(state->function, *i);
+				}
+			}
+		} catch (...)
+		{
+			state->setException(std::current_exception());
+		}
+	}
+};
+
+/**
+ * Result of ThreadPool::spawn. Move-only, get() can be called once.
+ * wait() and get() run pending tasks of the pool while the result isn't ready, and only block once the pool has
+ * nothing to run, so waiting from inside a task doesn't hold a worker idle.
+ */
+template<typename R>
+class TaskFuture
+{
+private:
+	Internal::TaskResult<R>*	_state;
+	ThreadPool*					_thread_pool;
+
+	friend class ThreadPool;
+
+	template<typename T>
+	friend bool interruptibleWait (const TaskFuture<T>& future);
+
+	TaskFuture (Internal::TaskResult<R>* state, ThreadPool& thread_pool) noexcept
+		: _state(state), _thread_pool(&thread_pool)
+	{
+	}
+
+public:
+	TaskFuture (TaskFuture&& other) noexcept
+		: _state(std::exchange(other._state, nullptr)), _thread_pool(other._thread_pool)
+	{
+	}
+
+	TaskFuture& operator= (TaskFuture&& other) noexcept
+	{
+		if (this != &other)
+		{
+			if (_state != nullptr)
+			{
+				_state->release();
+			}
+			_state			= std::exchange(other._state, nullptr);
+			_thread_pool	= other._thread_pool;
+		}
+		return *this;
+	}
+
+	TaskFuture (const TaskFuture&)				= delete;
+	TaskFuture& operator= (const TaskFuture&)	= delete;
+
+	~TaskFuture ()
+	{
+		if (_state != nullptr)
+		{
+			_state->release();
+		}
+	}
+
+	[[nodiscard]] bool valid () const noexcept
+	{
+		return _state != nullptr;
+	}
+
+	[[nodiscard]] bool isReady () const noexcept
+	{
+		return _state->isReady();
+	}
+
+	void wait () const
+	{
+		_thread_pool->helpUntil([this]() { return _state->isReady(); }, [this]() { _state->waitReady(); });
+	}
+
+	// Rethrows the exception of the task. Throws std::future_error(broken_promise) if the task was dropped unrun.
+	R get ()
+	{
+		wait();
+		Internal::TaskResult<R>* state = std::exchange(_state, nullptr);
+
+		struct Release
+		{
+			Internal::TaskResult<R>* state;
+			~Release () { state->release(); }
+		} release {state};
+
+		return state->takeValue();
+	}
+};
+
+/**
+ * TaskFuture::wait that returns false once the current CancellationToken is cancelled, see interruptible_wait.h. Runs
+ * tasks of the pool meanwhile like wait(). Sleeping on the future's state, it is woken by the cancel at once.
+ */
+template<typename R>
+bool interruptibleWait (const TaskFuture<R>& future)
+{
+	Internal::TaskResultWaiter<R>	waiter(*future._state);
+	Internal::InterruptRegistration	registration(waiter);
+
+	const auto interrupted = [&registration]() { return registration.isInterrupted(); };
+	future._thread_pool->helpUntil([&future, &interrupted]() { return future._state->isReady() || interrupted(); },
+								   [&future, &interrupted]() { future._state->waitReady(interrupted); });
+	registration.unregister();
+	return future._state->isReady();
+}
 
 } // namespace Concurrency
 
@@ -0,0 +1,146 @@
+#ifndef THREADPOOL_METRICS_H
+#define THREADPOOL_METRICS_H
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * CONCURRENCY_THREADPOOL_METRICS=0 compiles the per-worker counters of ThreadPool out, ThreadPool::metrics() then only
+ * reports what the pool tracks anyway: workers, pending tasks, local queue depths and steals.
+ * CONCURRENCY_THREADPOOL_TASK_HISTOGRAMS=1 adds the queue wait and run time histograms. They cost two clock reads and
+ * a wrapper around every task, which doesn't fit inline in a MovableFunction, so they are off unless asked for.
+ */
+#ifndef CONCURRENCY_THREADPOOL_METRICS
+#define CONCURRENCY_THREADPOOL_METRICS 1
+#endif
+
+#ifndef CONCURRENCY_THREADPOOL_TASK_HISTOGRAMS
+#define CONCURRENCY_THREADPOOL_TASK_HISTOGRAMS 0
+#endif
+
+namespace Concurrency {
+
+/**
+ * Durations in power of two buckets of nanoseconds: bucket i counts the durations in [2^i, 2^(i+1)) ns, bucket 0 also
+ * counts the durations under a nanosecond, the last bucket everything from 2^(number_of_buckets - 1) ns on.
+ */
+struct LatencyHistogram
+{
+    static constexpr size_t number_of_buckets = 40;
+
+    std::array<uint64_t, number_of_buckets> buckets {};
+
+    [[nodiscard]] uint64_t count () const noexcept
+    {
+        uint64_t count = 0;
+        for (const uint64_t bucket : buckets)
+        {
+            count += bucket;
+        }
+        return count;
+    }
+
+    // Upper bound of the bucket holding the given fraction of the durations, e.g. 0.99 for p99. Zero if empty.
+    [[nodiscard]] std::chrono::nanoseconds percentile (const double fraction) const noexcept
+    {
+        const uint64_t total = count();
+        if (total == 0)
+        {
+            return std::chrono::nanoseconds::zero();
+        }
+
+        const auto rank       = static_cast<uint64_t>(fraction * static_cast<double>(total - 1));
+        uint64_t   cumulative = 0;
+        for (size_t i = 0; i < number_of_buckets; ++i)
+        {
+            cumulative += buckets[i];
+            if (cumulative > rank)
+            {
+                return std::chrono::nanoseconds(int64_t{2} << i);
+            }
+        }
+        return std::chrono::nanoseconds(int64_t{2} << (number_of_buckets - 1));
+    }
+
+    LatencyHistogram& operator+= (const LatencyHistogram& other) noexcept
+    {
+        for (size_t i = 0; i < number_of_buckets; ++i)
+        {
+            buckets[i] += other.buckets[i];
+        }
+        return *this;
+    }
+};
+
+/**
+ * Totals of one worker since the pool was created. Every task the worker ran is exactly one pickup: from its local
+ * queue, from a shared queue (the priority and domain queues, and the due timers) or stolen from another worker.
+ */
+struct WorkerMetrics
+{
+    uint64_t                 local_pickups  = 0;
+    uint64_t                 shared_pickups = 0;
+    uint64_t                 stolen_pickups = 0;
+    uint64_t                 failed_steals  = 0;
+    // Tasks this thread queued on a shared queue.
+    uint64_t                 shared_pushes  = 0;
+    // Searches for a task that found nothing while idle, and how often the worker then slept.
+    uint64_t                 idle_spins     = 0;
+    uint64_t                 parks          = 0;
+    // Parked workers this thread woke for a task it queued.
+    uint64_t                 unparks        = 0;
+    std::chrono::nanoseconds idle_time {0};
+    // Tasks in the worker's local queue when the snapshot was taken.
+    size_t                   local_queue_depth = 0;
+
+    [[nodiscard]] uint64_t tasksExecuted () const noexcept
+    {
+        return local_pickups + shared_pickups + stolen_pickups;
+    }
+};
+
+/**
+ * Snapshot of a ThreadPool, see ThreadPool::metrics(). The counters are read one by one while the pool runs, so they
+ * are only consistent with each other up to the tasks that ran during the snapshot.
+ */
+struct ThreadPoolMetrics
+{
+    // One entry per worker slot. The last one sums the threads outside the pool that ran tasks with runPendingTask.
+    std::vector<WorkerMetrics> workers;
+    size_t                     number_of_workers  = 0;
+    // Tasks queued or running.
+    size_t                     pending_tasks      = 0;
+    // Tasks in the shared queues, the priority and domain queues.
+    size_t                     shared_queue_depth = 0;
+    // Threads outside the pool blocked in a push until the shared queues have room, see OverflowPolicy::Block.
+    size_t                     blocked_producers  = 0;
+    // Time from queueing to start, and from start to end, of the tasks that ran. Empty without histograms.
+    LatencyHistogram           queue_wait;
+    LatencyHistogram           run_time;
+
+    [[nodiscard]] WorkerMetrics total () const noexcept
+    {
+        WorkerMetrics total;
+        for (const WorkerMetrics& worker : workers)
+        {
+            total.local_pickups     += worker.local_pickups;
+            total.shared_pickups    += worker.shared_pickups;
+            total.stolen_pickups    += worker.stolen_pickups;
+            total.failed_steals     += worker.failed_steals;
+            total.shared_pushes     += worker.shared_pushes;
+            total.idle_spins        += worker.idle_spins;
+            total.parks             += worker.parks;
+            total.unparks           += worker.unparks;
+            total.idle_time         += worker.idle_time;
+            total.local_queue_depth += worker.local_queue_depth;
+        }
+        return total;
+    }
+};
+
+} // namespace Concurrency
+
+#endif // THREADPOOL_METRICS_H
@@ -0,0 +1,767 @@
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <list>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <time.h>
+
+#include "coroutine_task.h"
+#include "threadpool.h"
+#include "quicksort.h"
+#include "task_graph.h"
+
+
+namespace {
+
+/**
+ * Binary fork-join tree of 2^depth leaves: every inner task submits one half and computes the other half itself, then
+ * helps the pool until the submitted half is done. Nearly all the work is task spawn and execution overhead.
+ */
+uint64_t forkJoinTree(Concurrency::ThreadPool& thread_pool, const int depth)
+{
+    if (depth == 0)
+    {
+        return 1;
+    }
+
+    auto left = thread_pool.submit([&thread_pool, depth]() { return forkJoinTree(thread_pool, depth - 1); });
+    const uint64_t right = forkJoinTree(thread_pool, depth - 1);
+
+    std::future<uint64_t> left_fut = std::move(left.value());
+    while (left_fut.wait_for(std::chrono::seconds(0)) == std::future_status::timeout)
+    {
+        thread_pool.runPendingTask();
+    }
+
+    return left_fut.get() + right;
+}
+
+// Same tree as forkJoinTree, the left half is a coroutine resumed on the pool instead of a submitted task.
+Concurrency::Task<uint64_t> forkJoinTreeCoroutine(Concurrency::ThreadPool& thread_pool, const int depth, const bool on_pool)
+{
+    if (on_pool)
+    {
+        co_await thread_pool.schedule();
+    }
+    if (depth == 0)
+    {
+        co_return 1;
+    }
+
+    auto left = forkJoinTreeCoroutine(thread_pool, depth - 1, true);
+    left.start();
+    const uint64_t right = co_await forkJoinTreeCoroutine(thread_pool, depth - 1, false);
+
+    co_return co_await left + right;
+}
+
+std::list<int> generateRandomizedList(const size_t size)
+{
+    std::mt19937                    gen{42};
+    std::uniform_int_distribution<> distrib{-1'000'000, 1'000'000};
+
+    std::list<int> results(size);
+    std::generate(results.begin(), results.end(), [&]() { return distrib(gen); });
+    return results;
+}
+
+} // namespace
+
+
+static void forkJoinSpawnThroughput(benchmark::State& state) {
+
+    const auto              steal_policy = static_cast<Concurrency::StealPolicy>(state.range(1));
+    Concurrency::ThreadPool thread_pool(std::thread::hardware_concurrency(), steal_policy);
+    const int               depth = state.range(0);
+
+    for (auto _ : state)
+    {
+        auto root = thread_pool.submit([&thread_pool, depth]() { return forkJoinTree(thread_pool, depth); });
+        benchmark::DoNotOptimize(root.value().get());
+    }
+
+    // Every inner node of the tree is one submitted task.
+    state.SetItemsProcessed(state.iterations() * ((int64_t{1} << depth) - 1));
+
+    const Concurrency::StealStatistics statistics = thread_pool.stealStatistics();
+    state.counters["steal_success_rate"] = statistics.attempts == 0
+                                         ? 0.0
+                                         : static_cast<double>(statistics.successes) / statistics.attempts;
+    state.counters["tasks_per_steal"]    = statistics.successes == 0
+                                         ? 0.0
+                                         : static_cast<double>(statistics.stolen_tasks) / statistics.successes;
+}
+BENCHMARK(forkJoinSpawnThroughput)
+    ->ArgsProduct({{10, 13, 16},
+                   {static_cast<int64_t>(Concurrency::StealPolicy::One),
+                    static_cast<int64_t>(Concurrency::StealPolicy::Half)}})
+    ->ArgNames({"depth", "steal_policy"})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+/**
+ * forkJoinSpawnThroughput with coroutines: a join suspends the parent instead of polling, and the thread that
+ * finishes the last child resumes it right away.
+ */
+static void forkJoinCoroutines(benchmark::State& state) {
+
+    Concurrency::ThreadPool thread_pool;
+    const int               depth = state.range(0);
+
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(Concurrency::syncWait(thread_pool, forkJoinTreeCoroutine(thread_pool, depth, true)));
+    }
+
+    state.SetItemsProcessed(state.iterations() * ((int64_t{1} << depth) - 1));
+}
+BENCHMARK(forkJoinCoroutines)->Arg(10)->Arg(13)->Arg(16)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+/**
+ * forkJoinSpawnThroughput on a pool built from the discovered topology: workers pinned to their CPU and stealing
+ * within their NUMA node or L3 domain first. Compare with steal_policy:0 above.
+ */
+static void forkJoinPinnedTopology(benchmark::State& state) {
+
+    const Concurrency::CpuTopology topology = Concurrency::CpuTopology::discover();
+    Concurrency::ThreadPool        thread_pool(topology);
+    const int                      depth = state.range(0);
+
+    for (auto _ : state)
+    {
+        auto root = thread_pool.submit([&thread_pool, depth]() { return forkJoinTree(thread_pool, depth); });
+        benchmark::DoNotOptimize(root.value().get());
+    }
+
+    state.SetItemsProcessed(state.iterations() * ((int64_t{1} << depth) - 1));
+    state.counters["domains"] = static_cast<double>(thread_pool.numberOfDomains());
+}
+BENCHMARK(forkJoinPinnedTopology)->Arg(10)->Arg(13)->Arg(16)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+
+static void threadPoolQuickSort(benchmark::State& state) {
+
+    Concurrency::ThreadPool thread_pool;
+    const std::list<int>    input = generateRandomizedList(state.range(0));
+
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        std::list<int> numbers = input;
+        state.ResumeTiming();
+
+        auto sorted = thread_pool.submit([&thread_pool, &numbers]()
+        {
+            return Concurrency::ThreadPoolQuickSort(std::move(numbers), thread_pool);
+        });
+        benchmark::DoNotOptimize(sorted.value().get());
+    }
+
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(threadPoolQuickSort)->Arg(10'000)->Arg(100'000)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+
+static void localQueueEnqueueDequeue(benchmark::State& state) {
+
+    Concurrency::Internal::WorkStealingQueue queue;
+    const int                                number_of_elements = state.range(0);
+
+    for (auto _ : state)
+    {
+        for (int i = 0; i < number_of_elements; ++i)
+        {
+            queue.enqueue(Concurrency::Internal::MovableFunction([]() {}));
+        }
+
+        for (int i = 0; i < number_of_elements; ++i)
+        {
+            auto task = queue.dequeue();
+            benchmark::DoNotOptimize(task);
+        }
+    }
+
+    state.SetItemsProcessed(state.iterations() * number_of_elements);
+}
+BENCHMARK(localQueueEnqueueDequeue)->Range(8, 8 << 10);
+
+
+static double processCpuSeconds() {
+
+    timespec cpu_time {};
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu_time);
+    return static_cast<double>(cpu_time.tv_sec) + static_cast<double>(cpu_time.tv_nsec) * 1e-9;
+}
+
+/**
+ * CPU burnt by a pool without work, as a fraction of one core. The benchmark thread only sleeps.
+ */
+static void idlePoolCpuUsage(benchmark::State& state) {
+
+    Concurrency::ThreadPool thread_pool;
+    const auto              idle_period = std::chrono::milliseconds(state.range(0));
+    double                  cpu_seconds = 0.0;
+    double                  wall_seconds = 0.0;
+
+    for (auto _ : state)
+    {
+        const double cpu_start  = processCpuSeconds();
+        const auto   wall_start = std::chrono::steady_clock::now();
+
+        std::this_thread::sleep_for(idle_period);
+
+        cpu_seconds  += processCpuSeconds() - cpu_start;
+        wall_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - wall_start).count();
+    }
+
+    state.counters["idle_cpu_cores"] = cpu_seconds / wall_seconds;
+}
+BENCHMARK(idlePoolCpuUsage)->Arg(100)->Iterations(5)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+/**
+ * Time from submit until the task starts running, on a pool that was idle for `range(0)` microseconds, so its
+ * workers are spinning, yielding or parked depending on the idle time.
+ */
+static void submitToStartLatency(benchmark::State& state) {
+
+    Concurrency::ThreadPool thread_pool;
+    const auto              idle_period = std::chrono::microseconds(state.range(0));
+
+    for (auto _ : state)
+    {
+        std::this_thread::sleep_for(idle_period);
+
+        std::chrono::steady_clock::time_point started;
+        const auto submitted = std::chrono::steady_clock::now();
+        auto res = thread_pool.submit([&started]() { started = std::chrono::steady_clock::now(); });
+        res.value().wait();
+
+        state.SetIterationTime(std::chrono::duration<double>(started - submitted).count());
+    }
+}
+BENCHMARK(submitToStartLatency)->Arg(0)->Arg(100)->Arg(10'000)->Iterations(200)->UseManualTime()->Unit(benchmark::kMicrosecond);
+
+
+/**
+ * Per-task overhead of the type erasure: build, call and destroy a MovableFunction.
+ * Small captures two pointers and fits the inline buffer, large captures 128 bytes and goes to the heap.
+ */
+static void movableFunctionSmall(benchmark::State& state) {
+
+    int  counter = 0;
+    int* counter_pointer = &counter;
+
+    for (auto _ : state)
+    {
+        Concurrency::Internal::MovableFunction function([&counter, counter_pointer]() { counter += *counter_pointer; });
+        benchmark::DoNotOptimize(function);
+        function();
+    }
+    benchmark::DoNotOptimize(counter);
+}
+BENCHMARK(movableFunctionSmall);
+
+static void movableFunctionLarge(benchmark::State& state) {
+
+    std::array<int, 32> numbers {};
+    int                 counter = 0;
+
+    for (auto _ : state)
+    {
+        Concurrency::Internal::MovableFunction function([&counter, numbers]() { counter += numbers[0]; });
+        benchmark::DoNotOptimize(function);
+        function();
+    }
+    benchmark::DoNotOptimize(counter);
+}
+BENCHMARK(movableFunctionLarge);
+
+// submit round trip of an empty task: the type erasure plus packaged_task and its future.
+static void submitAndWait(benchmark::State& state) {
+
+    Concurrency::ThreadPool thread_pool;
+
+    for (auto _ : state)
+    {
+        auto res = thread_pool.submit([]() {});
+        res.value().wait();
+    }
+}
+BENCHMARK(submitAndWait);
+
+// Same round trip through spawn: one allocation and a TaskFuture that helps the pool while waiting.
+static void spawnAndGet(benchmark::State& state) {
+
+    Concurrency::ThreadPool thread_pool;
+
+    for (auto _ : state)
+    {
+        auto res = thread_pool.spawn([]() { return 1; });
+        benchmark::DoNotOptimize(res.value().get());
+    }
+}
+BENCHMARK(spawnAndGet);
+
+// Fire-and-forget tasks, waiting only for the whole batch to be done.
+static void postThroughput(benchmark::State& state) {
+
+    Concurrency::ThreadPool thread_pool;
+    const int               number_of_tasks = state.range(0);
+    std::atomic<int>        done {0};
+
+    for (auto _ : state)
+    {
+        done.store(0, std::memory_order_relaxed);
+        for (int i = 0; i < number_of_tasks; ++i)
+        {
+            thread_pool.post([&done]() { done.fetch_add(1, std::memory_order_relaxed); });
+        }
+        while (done.load(std::memory_order_relaxed) != number_of_tasks)
+        {
+            thread_pool.runPendingTask();
+        }
+    }
+
+    state.SetItemsProcessed(state.iterations() * number_of_tasks);
+}
+BENCHMARK(postThroughput)->Arg(1'000)->Unit(benchmark::kMicrosecond)->UseRealTime();
+
+// postThroughput's batch through submit, one packaged_task and future per task.
+static void submitThroughput(benchmark::State& state) {
+
+    Concurrency::ThreadPool thread_pool;
+    const int               number_of_tasks = state.range(0);
+    std::atomic<int>        done {0};
+
+    for (auto _ : state)
+    {
+        done.store(0, std::memory_order_relaxed);
+        for (int i = 0; i < number_of_tasks; ++i)
+        {
+            thread_pool.submit([&done]() { done.fetch_add(1, std::memory_order_relaxed); });
+        }
+        while (done.load(std::memory_order_relaxed) != number_of_tasks)
+        {
+            thread_pool.runPendingTask();
+        }
+    }
+
+    state.SetItemsProcessed(state.iterations() * number_of_tasks);
+}
+BENCHMARK(submitThroughput)->Arg(1'000)->Unit(benchmark::kMicrosecond)->UseRealTime();
+
+
+/**
+ * A loop over range(0) elements in chunks of range(1), the per-chunk submit of parallelAccumulateThreadPool against
+ * parallelFor. Each element costs a few nanoseconds, so the difference is the cost of distributing the chunks.
+ */
+static void loopPerChunkSubmit(benchmark::State& state) {
+
+    Concurrency::ThreadPool thread_pool;
+    std::vector<uint64_t>   numbers(state.range(0));
+    const size_t            chunk_size = state.range(1);
+
+    for (auto _ : state)
+    {
+        std::vector<std::future<void>> results;
+        results.reserve(numbers.size() / chunk_size + 1);
+        for (size_t chunk_start = 0; chunk_start < numbers.size(); chunk_start += chunk_size)
+        {
+            const size_t chunk_end = std::min(chunk_start + chunk_size, numbers.size());
+            results.push_back(std::move(thread_pool.submit([&numbers, chunk_start, chunk_end]()
+            {
+                for (size_t i = chunk_start; i < chunk_end; ++i)
+                {
+                    numbers[i] = numbers[i] * 31 + i;
+                }
+            }).value()));
+        }
+
+        for (std::future<void>& result : results)
+        {
+            result.get();
+        }
+    }
+    benchmark::DoNotOptimize(numbers.data());
+
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(loopPerChunkSubmit)->Args({1'000'000, 25})->Args({1'000'000, 1'000})->Unit(benchmark::kMillisecond)->UseRealTime();
+
+static void loopParallelFor(benchmark::State& state) {
+
+    Concurrency::ThreadPool thread_pool;
+    std::vector<uint64_t>   numbers(state.range(0));
+    const size_t            grain = state.range(1);
+
+    for (auto _ : state)
+    {
+        thread_pool.parallelFor(size_t{0}, numbers.size(), grain, [&numbers](const size_t i)
+        {
+            numbers[i] = numbers[i] * 31 + i;
+        });
+    }
+    benchmark::DoNotOptimize(numbers.data());
+
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(loopParallelFor)->Args({1'000'000, 25})->Args({1'000'000, 1'000})->Unit(benchmark::kMillisecond)->UseRealTime();
+
+
+/**
+ * A batch of range(0) small tasks per iteration, waited for either with waitIdle on a pool kept across batches or by
+ * destroying a pool created for the batch, which pays for starting and joining the threads every time.
+ */
+static void batchWaitIdle(benchmark::State& state) {
+
+    Concurrency::ThreadPool thread_pool;
+    std::atomic<int>        done {0};
+
+    for (auto _ : state)
+    {
+        for (int i = 0; i < state.range(0); ++i)
+        {
+            thread_pool.post([&done]() { done.fetch_add(1, std::memory_order_relaxed); });
+        }
+        thread_pool.waitIdle();
+    }
+    benchmark::DoNotOptimize(done.load());
+}
+BENCHMARK(batchWaitIdle)->Arg(100)->Unit(benchmark::kMicrosecond)->UseRealTime();
+
+static void batchPoolPerBatch(benchmark::State& state) {
+
+    std::atomic<int> done {0};
+
+    for (auto _ : state)
+    {
+        Concurrency::ThreadPool thread_pool;
+        for (int i = 0; i < state.range(0); ++i)
+        {
+            thread_pool.post([&done]() { done.fetch_add(1, std::memory_order_relaxed); });
+        }
+    }
+    benchmark::DoNotOptimize(done.load());
+}
+BENCHMARK(batchPoolPerBatch)->Arg(100)->Unit(benchmark::kMicrosecond)->UseRealTime();
+
+
+/**
+ * Start latency of a probe task submitted with priority range(0) while the pool is saturated with Low background
+ * tasks of ~20us each, kept at about 64 queued tasks per worker. Reports the median and the 99th percentile.
+ */
+static void probeLatencyUnderBackgroundLoad(benchmark::State& state) {
+
+    const auto              probe_priority = static_cast<Concurrency::TaskPriority>(state.range(0));
+    Concurrency::ThreadPool thread_pool;
+    const int               backlog = 64 * static_cast<int>(std::max(std::thread::hardware_concurrency(), 1u));
+    std::atomic<int>        queued_background {0};
+    std::vector<double>     latencies;
+
+    const auto background_task = [&queued_background]()
+    {
+        const auto end = std::chrono::steady_clock::now() + std::chrono::microseconds(20);
+        while (std::chrono::steady_clock::now() < end)
+        {
+        }
+        queued_background.fetch_sub(1, std::memory_order_relaxed);
+    };
+
+    for (auto _ : state)
+    {
+        while (queued_background.load(std::memory_order_relaxed) < backlog)
+        {
+            queued_background.fetch_add(1, std::memory_order_relaxed);
+            thread_pool.post(background_task, Concurrency::TaskPriority::Low);
+        }
+
+        std::chrono::steady_clock::time_point started;
+        const auto submitted = std::chrono::steady_clock::now();
+        // A std::future, waiting on it doesn't run the probe on this thread.
+        auto res = thread_pool.submit([&started]() { started = std::chrono::steady_clock::now(); }, probe_priority);
+        res.value().wait();
+
+        const double latency = std::chrono::duration<double>(started - submitted).count();
+        latencies.push_back(latency);
+        state.SetIterationTime(latency);
+    }
+
+    thread_pool.shutdown(Concurrency::DrainPolicy::cancelNow());
+
+    std::sort(latencies.begin(), latencies.end());
+    state.counters["p50_us"] = latencies[latencies.size() / 2] * 1e6;
+    state.counters["p99_us"] = latencies[latencies.size() * 99 / 100] * 1e6;
+}
+BENCHMARK(probeLatencyUnderBackgroundLoad)
+    ->Arg(static_cast<int64_t>(Concurrency::TaskPriority::High))
+    ->Arg(static_cast<int64_t>(Concurrency::TaskPriority::Low))
+    ->ArgNames({"probe_priority"})
+    ->Iterations(200)
+    ->UseManualTime()
+    ->Unit(benchmark::kMicrosecond);
+
+
+/**
+ * A pipeline of range(0) stages of range(1) tasks each, every task depending on all the tasks of the stage before.
+ * As a TaskGraph built once and re-run, against chaining the stages with tasks that block on the futures of the stage
+ * before, which holds a worker for every waiting task.
+ */
+static void pipelineTaskGraph(benchmark::State& state) {
+
+    Concurrency::ThreadPool thread_pool;
+    Concurrency::TaskGraph  graph;
+    std::atomic<int>        done {0};
+
+    std::vector<Concurrency::TaskGraph::TaskNode> previous_stage;
+    for (int stage = 0; stage < state.range(0); ++stage)
+    {
+        std::vector<Concurrency::TaskGraph::TaskNode> current_stage;
+        for (int i = 0; i < state.range(1); ++i)
+        {
+            auto node = graph.emplace([&done]() { done.fetch_add(1, std::memory_order_relaxed); });
+            for (const Concurrency::TaskGraph::TaskNode& dependency : previous_stage)
+            {
+                node.succeed(dependency);
+            }
+            current_stage.push_back(node);
+        }
+        previous_stage = std::move(current_stage);
+    }
+
+    for (auto _ : state)
+    {
+        graph.run(thread_pool);
+        graph.wait();
+    }
+    benchmark::DoNotOptimize(done.load());
+
+    state.SetItemsProcessed(state.iterations() * state.range(0) * state.range(1));
+}
+BENCHMARK(pipelineTaskGraph)->Args({16, 8})->Unit(benchmark::kMicrosecond)->UseRealTime();
+
+static void pipelineBlockingFutures(benchmark::State& state) {
+
+    Concurrency::ThreadPool thread_pool;
+    std::atomic<int>        done {0};
+
+    for (auto _ : state)
+    {
+        std::vector<std::shared_future<void>> previous_stage;
+        for (int stage = 0; stage < state.range(0); ++stage)
+        {
+            std::vector<std::shared_future<void>> current_stage;
+            for (int i = 0; i < state.range(1); ++i)
+            {
+                auto res = thread_pool.submit([&done, previous_stage]()
+                {
+                    for (const std::shared_future<void>& dependency : previous_stage)
+                    {
+                        dependency.wait();
+                    }
+                    done.fetch_add(1, std::memory_order_relaxed);
+                });
+                current_stage.push_back(res.value().share());
+            }
+            previous_stage = std::move(current_stage);
+        }
+
+        for (const std::shared_future<void>& result : previous_stage)
+        {
+            result.wait();
+        }
+    }
+    benchmark::DoNotOptimize(done.load());
+
+    state.SetItemsProcessed(state.iterations() * state.range(0) * state.range(1));
+}
+BENCHMARK(pipelineBlockingFutures)->Args({16, 8})->Unit(benchmark::kMicrosecond)->UseRealTime();
+
+/**
+ * Bursts of tasks that each block for 200us, like a short I/O call. The fixed pool has one worker per CPU, the elastic
+ * pool starts with as many and adds workers while tasks are blocked.
+ */
+static void runBlockingBurst(Concurrency::ThreadPool& thread_pool, const int number_of_tasks)
+{
+    for (int i = 0; i < number_of_tasks; ++i)
+    {
+        thread_pool.post([&thread_pool]()
+        {
+            const auto blocking_region = thread_pool.blockingRegion();
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+        });
+    }
+    thread_pool.waitIdle();
+}
+
+static void blockingBurstFixedPool(benchmark::State& state) {
+
+    Concurrency::ThreadPool thread_pool;
+    for (auto _ : state)
+    {
+        runBlockingBurst(thread_pool, state.range(0));
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    state.counters["workers"] = static_cast<double>(thread_pool.numberOfWorkers());
+}
+BENCHMARK(blockingBurstFixedPool)->Arg(256)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+static void blockingBurstElasticPool(benchmark::State& state) {
+
+    const size_t            number_of_cpus = std::max(std::thread::hardware_concurrency(), 1u);
+    Concurrency::ThreadPool thread_pool(Concurrency::ElasticLimits {.min_workers = number_of_cpus,
+                                                                    .max_workers = 64});
+    for (auto _ : state)
+    {
+        runBlockingBurst(thread_pool, state.range(0));
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    state.counters["workers"] = static_cast<double>(thread_pool.numberOfWorkers());
+}
+BENCHMARK(blockingBurstElasticPool)->Arg(256)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// Cost of a metrics snapshot while the pool runs tasks, what a one per second scrape pays.
+static void metricsSnapshot(benchmark::State& state) {
+
+    Concurrency::ThreadPool thread_pool;
+    std::atomic<bool>       stop {false};
+    for (size_t i = 0; i < thread_pool.numberOfWorkers(); ++i)
+    {
+        thread_pool.post([&thread_pool, &stop]()
+        {
+            while (!stop.load(std::memory_order_relaxed))
+            {
+                thread_pool.post([]() {});
+                thread_pool.runPendingTask();
+            }
+        });
+    }
+
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(thread_pool.metrics());
+    }
+    stop.store(true);
+}
+BENCHMARK(metricsSnapshot);
+
+// A producer much faster than the workers: posts 10'000 tasks of ~2us each into a pool bounded to 256 queued tasks,
+// or unbounded for the last policy argument. Reports how deep the shared queue got and how many tasks were dropped.
+static void overloadedProducer(benchmark::State& state) {
+
+    constexpr int           number_of_tasks = 10'000;
+    const auto              policy          = static_cast<Concurrency::OverflowPolicy>(state.range(0));
+    const bool              bounded         = state.range(1) != 0;
+    Concurrency::ThreadPool thread_pool;
+    if (bounded)
+    {
+        thread_pool.setQueueBound({.capacity = 256, .policy = policy});
+    }
+
+    std::atomic<int> done {0};
+    size_t           max_depth = 0;
+    int              rejected  = 0;
+    for (auto _ : state)
+    {
+        done.store(0, std::memory_order_relaxed);
+        for (int i = 0; i < number_of_tasks; ++i)
+        {
+            const bool queued = thread_pool.post([&done]()
+            {
+                const auto end = std::chrono::steady_clock::now() + std::chrono::microseconds(2);
+                while (std::chrono::steady_clock::now() < end)
+                {
+                }
+                done.fetch_add(1, std::memory_order_relaxed);
+            });
+            rejected += queued ? 0 : 1;
+            if (i % 256 == 0)
+            {
+                max_depth = std::max(max_depth, thread_pool.metrics().shared_queue_depth);
+            }
+        }
+        thread_pool.waitIdle();
+    }
+
+    state.SetItemsProcessed(state.iterations() * number_of_tasks);
+    state.counters["max_depth"] = static_cast<double>(max_depth);
+    state.counters["not_run"]   = static_cast<double>(number_of_tasks - done.load()); // Of the last iteration.
+    state.counters["rejected"]  = static_cast<double>(rejected) / static_cast<double>(state.iterations());
+}
+BENCHMARK(overloadedProducer)
+    ->ArgsProduct({{static_cast<int>(Concurrency::OverflowPolicy::Block)}, {0}})
+    ->ArgsProduct({{static_cast<int>(Concurrency::OverflowPolicy::Block),
+                    static_cast<int>(Concurrency::OverflowPolicy::FailFast),
+                    static_cast<int>(Concurrency::OverflowPolicy::CallerRuns),
+                    static_cast<int>(Concurrency::OverflowPolicy::DropOldest)}, {1}})
+    ->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// How late a 500us timer fires, on the pool and on a thread of its own sleeping until the deadline.
+static void timerLatenessPool(benchmark::State& state) {
+
+    Concurrency::ThreadPool  thread_pool;
+    std::chrono::nanoseconds lateness {0};
+    for (auto _ : state)
+    {
+        const auto due      = std::chrono::steady_clock::now() + std::chrono::microseconds(500);
+        auto       fired_at = thread_pool.submitAt(due, []() { return std::chrono::steady_clock::now(); });
+        lateness += fired_at.value().get() - due;
+    }
+    state.counters["lateness_us"] = static_cast<double>(lateness.count()) / 1'000.0
+                                  / static_cast<double>(state.iterations());
+}
+BENCHMARK(timerLatenessPool)->Unit(benchmark::kMicrosecond)->UseRealTime();
+
+static void timerLatenessSleepingThread(benchmark::State& state) {
+
+    std::chrono::nanoseconds lateness {0};
+    for (auto _ : state)
+    {
+        const auto                             due = std::chrono::steady_clock::now() + std::chrono::microseconds(500);
+        std::chrono::steady_clock::time_point  fired_at;
+        std::thread([due, &fired_at]()
+        {
+            std::this_thread::sleep_until(due);
+            fired_at = std::chrono::steady_clock::now();
+        }).join();
+        lateness += fired_at - due;
+    }
+    state.counters["lateness_us"] = static_cast<double>(lateness.count()) / 1'000.0
+                                  / static_cast<double>(state.iterations());
+}
+BENCHMARK(timerLatenessSleepingThread)->Unit(benchmark::kMicrosecond)->UseRealTime();
+
+// A request queues 1'000 tasks of ~20us and is then abandoned: how long the pool stays busy with them, with the
+// tasks cancelled or not.
+static void abandonedRequest(benchmark::State& state) {
+
+    constexpr int           number_of_tasks = 1'000;
+    const bool              cancel          = state.range(0) != 0;
+    Concurrency::ThreadPool thread_pool;
+
+    for (auto _ : state)
+    {
+        Concurrency::CancellationSource request;
+        for (int i = 0; i < number_of_tasks; ++i)
+        {
+            thread_pool.post(request.token(), []()
+            {
+                const auto end = std::chrono::steady_clock::now() + std::chrono::microseconds(20);
+                while (std::chrono::steady_clock::now() < end && !Concurrency::CancellationToken::isCurrentCancelled())
+                {
+                }
+            });
+        }
+        if (cancel)
+        {
+            request.cancel();
+        }
+        thread_pool.waitIdle();
+    }
+    state.SetItemsProcessed(state.iterations() * number_of_tasks);
+}
+BENCHMARK(abandonedRequest)->ArgName("cancel")->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond)->UseRealTime();
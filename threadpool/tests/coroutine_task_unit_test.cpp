@@ -0,0 +1,152 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "coroutine_task.h"
+
+namespace {
+
+Concurrency::Task<std::thread::id> threadIdOnPool (Concurrency::ThreadPool& thread_pool)
+{
+	co_await thread_pool.schedule();
+	co_return std::this_thread::get_id();
+}
+
+Concurrency::Task<int> addOnPool (Concurrency::ThreadPool& thread_pool, const int left, const int right)
+{
+	co_await thread_pool.schedule();
+	co_return left + right;
+}
+
+Concurrency::Task<int> fibonacci (Concurrency::ThreadPool& thread_pool, const int n)
+{
+	if (n < 2)
+	{
+		co_return n;
+	}
+
+	co_await thread_pool.schedule();
+	auto first = fibonacci(thread_pool, n - 1);
+	first.start();
+	const int second = co_await fibonacci(thread_pool, n - 2);
+	co_return co_await first + second;
+}
+
+} // namespace
+
+TEST(CoroutineTask, Schedule_ResumesOnAPoolThread)
+{
+	Concurrency::ThreadPool thread_pool(2);
+
+	// Unlike syncWait, waitIdle doesn't run tasks on this thread.
+	auto task = threadIdOnPool(thread_pool);
+	task.start();
+	thread_pool.waitIdle();
+
+	ASSERT_TRUE(task.isDone());
+	EXPECT_NE(task.result(), std::this_thread::get_id());
+}
+
+TEST(CoroutineTask, Task_IsLazy)
+{
+	Concurrency::ThreadPool thread_pool(2);
+	bool                    ran = false;
+
+	auto task = [](bool& ran) -> Concurrency::Task<>
+	{
+		ran = true;
+		co_return;
+	}(ran);
+
+	EXPECT_FALSE(ran);
+	EXPECT_FALSE(task.isDone());
+	Concurrency::syncWait(thread_pool, std::move(task));
+	EXPECT_TRUE(ran);
+}
+
+TEST(CoroutineTask, AwaitTask_ReturnsItsResult)
+{
+	Concurrency::ThreadPool thread_pool(2);
+
+	auto task = [](Concurrency::ThreadPool& thread_pool) -> Concurrency::Task<int>
+	{
+		const int sum = co_await addOnPool(thread_pool, 1, 2);
+		co_return sum * 10;
+	}(thread_pool);
+
+	EXPECT_EQ(Concurrency::syncWait(thread_pool, std::move(task)), 30);
+}
+
+TEST(CoroutineTask, AwaitStartedTask_AfterItCompleted)
+{
+	Concurrency::ThreadPool thread_pool(2);
+
+	auto task = [](Concurrency::ThreadPool& thread_pool) -> Concurrency::Task<int>
+	{
+		auto started = addOnPool(thread_pool, 20, 22);
+		started.start();
+		while (!started.isDone())
+		{
+			std::this_thread::yield();
+		}
+		co_return co_await started;
+	}(thread_pool);
+
+	EXPECT_EQ(Concurrency::syncWait(thread_pool, std::move(task)), 42);
+}
+
+TEST(CoroutineTask, ForkJoin_ComputesFibonacci)
+{
+	Concurrency::ThreadPool thread_pool(4);
+
+	EXPECT_EQ(Concurrency::syncWait(thread_pool, fibonacci(thread_pool, 20)), 6765);
+}
+
+TEST(CoroutineTask, Exception_PropagatesThroughAwaitAndSyncWait)
+{
+	Concurrency::ThreadPool thread_pool(2);
+
+	auto throwing = [](Concurrency::ThreadPool& thread_pool) -> Concurrency::Task<int>
+	{
+		co_await thread_pool.schedule();
+		throw std::runtime_error("task failed");
+	};
+	auto awaiting = [](Concurrency::ThreadPool& thread_pool, auto& throwing) -> Concurrency::Task<int>
+	{
+		co_return co_await throwing(thread_pool) + 1;
+	};
+
+	EXPECT_THROW(Concurrency::syncWait(thread_pool, awaiting(thread_pool, throwing)), std::runtime_error);
+}
+
+TEST(CoroutineTask, DestroyStartedTask_FinishesAndFreesItself)
+{
+	Concurrency::ThreadPool thread_pool(2);
+	std::atomic<int>        finished {0};
+
+	for (int i = 0; i < 100; ++i)
+	{
+		auto task = [](Concurrency::ThreadPool& thread_pool, std::atomic<int>& finished) -> Concurrency::Task<>
+		{
+			co_await thread_pool.schedule();
+			finished.fetch_add(1);
+		}(thread_pool, finished);
+		task.start();
+	}
+
+	thread_pool.waitIdle();
+	EXPECT_EQ(finished.load(), 100);
+}
+
+TEST(CoroutineTask, ScheduleAfterShutdown_ContinuesOnTheCallingThread)
+{
+	Concurrency::ThreadPool thread_pool(2);
+	thread_pool.shutdown(Concurrency::DrainPolicy::drainAll());
+
+	const std::thread::id id = Concurrency::syncWait(thread_pool, threadIdOnPool(thread_pool));
+
+	EXPECT_EQ(id, std::this_thread::get_id());
+}
@@ -0,0 +1,56 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "cpu_topology.h"
+
+using Concurrency::CpuTopology;
+
+TEST(CpuTopology, ParseCpuList_RangesAndSingleCpus)
+{
+	EXPECT_EQ(CpuTopology::parseCpuList("0-3,8,10-11\n"), (std::vector<int>{0, 1, 2, 3, 8, 10, 11}));
+	EXPECT_EQ(CpuTopology::parseCpuList("5"), (std::vector<int>{5}));
+	EXPECT_EQ(CpuTopology::parseCpuList(" \n"), (std::vector<int>{}));
+}
+
+TEST(CpuTopology, ParseCpuList_MalformedListIsRejected)
+{
+	EXPECT_FALSE(CpuTopology::parseCpuList("3-1").has_value());
+	EXPECT_FALSE(CpuTopology::parseCpuList("0,,1").has_value());
+	EXPECT_FALSE(CpuTopology::parseCpuList("0-").has_value());
+	EXPECT_FALSE(CpuTopology::parseCpuList("cpu0").has_value());
+	EXPECT_FALSE(CpuTopology::fromCpuList("").has_value());
+}
+
+TEST(CpuTopology, ParseCpuList_CpuBeyondCpuSetIsRejected)
+{
+	EXPECT_FALSE(CpuTopology::parseCpuList("2147483647").has_value());
+	EXPECT_FALSE(CpuTopology::parseCpuList("0-2147483647").has_value());
+	EXPECT_FALSE(CpuTopology::parseCpuList("0-2000000000").has_value());
+	EXPECT_FALSE(CpuTopology::parseCpuList(std::to_string(CPU_SETSIZE)).has_value());
+
+	const std::optional<std::vector<int>> cpus = CpuTopology::parseCpuList("0-" + std::to_string(CPU_SETSIZE - 1));
+	ASSERT_TRUE(cpus.has_value());
+	EXPECT_EQ(cpus.value().size(), static_cast<size_t>(CPU_SETSIZE));
+}
+
+TEST(CpuTopology, Discover_GroupsAllowedCpusOnce)
+{
+	const CpuTopology      topology = CpuTopology::discover();
+	const std::vector<int> allowed  = CpuTopology::allowedCpus();
+
+	ASSERT_FALSE(topology.domains.empty());
+	EXPECT_EQ(topology.numberOfCpus(), allowed.size());
+
+	std::vector<int> cpus;
+	for (const std::vector<int>& domain : topology.domains)
+	{
+		EXPECT_FALSE(domain.empty());
+		cpus.insert(cpus.end(), domain.begin(), domain.end());
+	}
+	std::sort(cpus.begin(), cpus.end());
+	EXPECT_EQ(cpus, allowed);
+}
@@ -0,0 +1,109 @@
+#include <gtest/gtest.h>
+
+#include <array>
+#include <future>
+#include <memory>
+#include <type_traits>
+
+#include "internal/movable_function.h"
+
+namespace {
+
+using Concurrency::Internal::MovableFunction;
+using Concurrency::Internal::MustRunTask;
+
+// Not trivially copyable, but safe to move by copying its bytes.
+struct Relocatable
+{
+	static constexpr bool trivially_relocatable = true;
+
+	int* calls;
+
+	~Relocatable () {}
+
+	void operator() () const
+	{
+		++*calls;
+	}
+};
+
+} // namespace
+
+TEST(MovableFunction, SmallTriviallyCopyableCallable_StoredInline)
+{
+	int  calls = 0;
+	auto small = [&calls]() { ++calls; };
+	static_assert(MovableFunction::stored_inline<decltype(small)>);
+
+	MovableFunction function(small);
+	function();
+	function();
+	EXPECT_EQ(calls, 2);
+}
+
+TEST(MovableFunction, LargeOrNonTrivialCallable_StoredOnHeap)
+{
+	std::array<int, 32> numbers {};
+	numbers[31] = 7;
+	int  result = 0;
+	auto large  = [numbers, &result]() { result = numbers[31]; };
+	static_assert(!MovableFunction::stored_inline<decltype(large)>);
+
+	std::packaged_task<int()> packaged_task([]() { return 5; });
+	auto future = packaged_task.get_future();
+	static_assert(!MovableFunction::stored_inline<std::packaged_task<int()>>);
+
+	MovableFunction large_function(large);
+	MovableFunction task_function(std::move(packaged_task));
+	large_function();
+	task_function();
+
+	EXPECT_EQ(result, 7);
+	EXPECT_EQ(future.get(), 5);
+}
+
+TEST(MovableFunction, MustRunTask_StoredInlineIfItsCallableIs)
+{
+	static_assert(!std::is_trivially_copyable_v<Relocatable>);
+	static_assert(MovableFunction::stored_inline<MustRunTask<Relocatable>>);
+	static_assert(!MovableFunction::stored_inline<MustRunTask<std::packaged_task<int()>>>);
+
+	int             calls = 0;
+	MovableFunction function(MustRunTask {Relocatable {&calls}});
+	EXPECT_TRUE(function.mustRun());
+	function();
+	EXPECT_EQ(calls, 1);
+}
+
+TEST(MovableFunction, Move_TransfersCallable)
+{
+	int             calls = 0;
+	MovableFunction first([&calls]() { ++calls; });
+	MovableFunction second(std::move(first));
+	second();
+
+	MovableFunction third([]() {});
+	third = std::move(second);
+	third();
+
+	EXPECT_EQ(calls, 2);
+}
+
+TEST(MovableFunction, Destruction_DestroysCallableOnce)
+{
+	auto counter = std::make_shared<int>(0);
+	{
+		MovableFunction first([counter]() {});
+		EXPECT_EQ(counter.use_count(), 2);
+
+		MovableFunction second(std::move(first));
+		EXPECT_EQ(counter.use_count(), 2);
+
+		second = MovableFunction([]() {});
+		EXPECT_EQ(counter.use_count(), 1);
+
+		MovableFunction third([counter]() {});
+		EXPECT_EQ(counter.use_count(), 2);
+	}
+	EXPECT_EQ(counter.use_count(), 1);
+}
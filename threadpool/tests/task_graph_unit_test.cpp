@@ -0,0 +1,198 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <latch>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "task_graph.h"
+
+TEST(TaskGraph, Diamond_NodesRunAfterTheirDependencies)
+{
+	Concurrency::ThreadPool thread_pool;
+	Concurrency::TaskGraph  graph;
+
+	std::atomic<int> clock {0};
+	std::vector<int> finished_at(4, -1);
+	auto node = [&clock, &finished_at](const int index)
+	{
+		return [&clock, &finished_at, index]() { finished_at[index] = clock.fetch_add(1); };
+	};
+
+	auto source = graph.emplace(node(0));
+	auto left   = graph.emplace(node(1));
+	auto right  = graph.emplace(node(2));
+	auto sink   = graph.emplace(node(3));
+	source.precede(left, right);
+	sink.succeed(left, right);
+
+	ASSERT_TRUE(graph.run(thread_pool));
+	graph.wait();
+
+	EXPECT_EQ(finished_at[0], 0);
+	EXPECT_LT(finished_at[0], finished_at[1]);
+	EXPECT_LT(finished_at[0], finished_at[2]);
+	EXPECT_EQ(finished_at[3], 3);
+}
+
+TEST(TaskGraph, Rerun_RunsEveryNodeAgain)
+{
+	Concurrency::ThreadPool thread_pool;
+	Concurrency::TaskGraph  graph;
+	std::atomic<int>        runs {0};
+
+	// Two independent chains.
+	for (int chain = 0; chain < 2; ++chain)
+	{
+		auto previous = graph.emplace([&runs]() { runs.fetch_add(1); });
+		for (int i = 0; i < 9; ++i)
+		{
+			auto current = graph.emplace([&runs]() { runs.fetch_add(1); });
+			previous.precede(current);
+			previous = current;
+		}
+	}
+
+	for (int run = 1; run <= 3; ++run)
+	{
+		ASSERT_TRUE(graph.run(thread_pool));
+		graph.wait();
+		EXPECT_EQ(runs.load(), run * 20);
+	}
+}
+
+TEST(TaskGraph, LongChainOnSingleWorker_Completes)
+{
+	// Nothing blocks a worker, so one worker is enough for any graph.
+	Concurrency::ThreadPool thread_pool(1);
+	Concurrency::TaskGraph  graph;
+	int                     runs = 0;
+
+	auto previous = graph.emplace([&runs]() { ++runs; });
+	for (int i = 0; i < 10'000; ++i)
+	{
+		auto current = graph.emplace([&runs]() { ++runs; });
+		current.succeed(previous);
+		previous = current;
+	}
+
+	ASSERT_TRUE(graph.run(thread_pool));
+	graph.wait();
+	EXPECT_EQ(runs, 10'001);
+}
+
+TEST(TaskGraph, RunWhileRunning_ReturnsFalse)
+{
+	Concurrency::ThreadPool thread_pool;
+	Concurrency::TaskGraph  graph;
+	std::latch              release(1);
+
+	graph.emplace([&release]() { release.wait(); });
+
+	ASSERT_TRUE(graph.run(thread_pool));
+	EXPECT_FALSE(graph.run(thread_pool));
+
+	release.count_down();
+	graph.wait();
+}
+
+TEST(TaskGraph, NodeThrows_WaitRethrowsAndSuccessorsAreSkipped)
+{
+	Concurrency::ThreadPool thread_pool;
+	Concurrency::TaskGraph  graph;
+	bool                    successor_ran = false;
+
+	auto failing   = graph.emplace([]() { throw std::runtime_error("node failed"); });
+	auto successor = graph.emplace([&successor_ran]() { successor_ran = true; });
+	failing.precede(successor);
+
+	ASSERT_TRUE(graph.run(thread_pool));
+	EXPECT_THROW(graph.wait(), std::runtime_error);
+	EXPECT_FALSE(successor_ran);
+}
+
+TEST(TaskGraph, EmptyGraph_FinishesImmediately)
+{
+	Concurrency::ThreadPool thread_pool;
+	Concurrency::TaskGraph  graph;
+
+	ASSERT_TRUE(graph.run(thread_pool));
+	graph.wait();
+	EXPECT_EQ(graph.size(), 0u);
+}
+
+TEST(TaskGraph, OutlivesItsPool_DestroyedWithoutTouchingThePool)
+{
+	std::atomic<int> runs {0};
+	{
+		// Declared before the pool, so destroyed after it.
+		Concurrency::TaskGraph graph;
+		auto                   thread_pool = std::make_unique<Concurrency::ThreadPool>(1);
+
+		graph.emplace([&runs]() { runs.fetch_add(1); });
+		ASSERT_TRUE(graph.run(*thread_pool));
+		graph.wait();
+		thread_pool.reset();
+	}
+	EXPECT_EQ(runs.load(), 1);
+}
+
+TEST(TaskGraph, DestroyedOnWorkerWhileRunning_RunsItsNodes)
+{
+	Concurrency::ThreadPool thread_pool(1);
+
+	// The nodes are queued on the only worker, which is the one destroying the graph.
+	auto runs = thread_pool.submit([&thread_pool]()
+	{
+		std::atomic<int> runs {0};
+		{
+			Concurrency::TaskGraph graph;
+			auto                   source = graph.emplace([&runs]() { runs.fetch_add(1); });
+			source.precede(graph.emplace([&runs]() { runs.fetch_add(1); }),
+						   graph.emplace([&runs]() { runs.fetch_add(1); }));
+			graph.run(thread_pool);
+		}
+		return runs.load();
+	});
+	ASSERT_TRUE(runs.has_value());
+	ASSERT_EQ(runs.value().wait_for(std::chrono::seconds(5)), std::future_status::ready);
+	EXPECT_EQ(runs.value().get(), 3);
+}
+
+TEST(TaskGraph, PoolShutdownCancelNow_RunsQueuedNodes)
+{
+	Concurrency::ThreadPool thread_pool(1);
+	Concurrency::TaskGraph  graph;
+	std::latch              started(1);
+	std::latch              release(1);
+	std::atomic<int>        runs {0};
+
+	ASSERT_TRUE(thread_pool.post([&started, &release]()
+	{
+		started.count_down();
+		release.wait();
+	}));
+	started.wait();
+
+	auto source = graph.emplace([&runs]() { runs.fetch_add(1); });
+	auto left   = graph.emplace([&runs]() { runs.fetch_add(1); });
+	auto right  = graph.emplace([&runs]() { runs.fetch_add(1); });
+	source.precede(left, right);
+	ASSERT_TRUE(graph.run(thread_pool));
+	ASSERT_TRUE(thread_pool.post([]() {}));
+
+	std::jthread releaser([&release]()
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		release.count_down();
+	});
+
+	// Only the plain task is dropped, the graph would never finish without its queued node.
+	EXPECT_EQ(thread_pool.shutdown(Concurrency::DrainPolicy::cancelNow()), 1u);
+	graph.wait();
+	EXPECT_EQ(runs.load(), 3);
+}
@@ -1,11 +1,22 @@
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <functional>
 #include <future>
 #include <chrono>
+#include <condition_variable>
 #include <latch>
+#include <mutex>
+#include <numeric>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+#include <vector>
 
 
+#include "interruptible_thread.h"
 #include "threadpool.h"
 
 namespace {
@@ -16,6 +27,18 @@ int dummyFunction ()
 	return return_number;
 }
 
+// Poll until predicate() or the timeout, returns predicate().
+template<typename Predicate>
+bool eventually (Predicate predicate, const std::chrono::milliseconds timeout = std::chrono::seconds(5))
+{
+	const auto deadline = std::chrono::steady_clock::now() + timeout;
+	while (!predicate() && std::chrono::steady_clock::now() < deadline)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	return predicate();
+}
+
 } // namespace
 
 TEST(ThreadPool, SubmitAndReceiveFunctionDoneSignalTest)
@@ -107,4 +130,1202 @@ TEST(ThreadPool, TaskFromLocalQueueShouldGetStolen)
 
     ASSERT_TRUE(res.has_value());
     ASSERT_EQ(res.value().wait_for(std::chrono::seconds(1)), std::future_status::ready);
-}
\ No newline at end of file
+}
+
+TEST(ThreadPool, ExternalThreadStealsFromBusyWorker)
+{
+    Concurrency::ThreadPool thread_pool(1);
+    std::latch              inner_submitted(1);
+    std::latch              inner_done(1);
+
+    auto res = thread_pool.submit([&thread_pool, &inner_submitted, &inner_done]()
+    {
+        auto inner_res = thread_pool.submit([&inner_done]() { inner_done.count_down(); });
+        inner_submitted.count_down();
+
+        // Keep the only worker busy, the inner task can only run if another thread steals it.
+        inner_done.wait();
+    });
+    ASSERT_TRUE(res.has_value());
+    inner_submitted.wait();
+
+    while (!inner_done.try_wait())
+    {
+        thread_pool.runPendingTask();
+    }
+    ASSERT_EQ(res.value().wait_for(std::chrono::seconds(1)), std::future_status::ready);
+
+    const Concurrency::StealStatistics statistics = thread_pool.stealStatistics();
+    EXPECT_GE(statistics.attempts, statistics.successes);
+    EXPECT_GE(statistics.successes, 1u);
+    EXPECT_EQ(statistics.stolen_tasks, statistics.successes);
+}
+
+TEST(ThreadPool, StealHalf_ThiefTakesSeveralTasks)
+{
+    if (std::thread::hardware_concurrency() < 2)
+    {
+        GTEST_SKIP() << "Needs two workers";
+    }
+
+    constexpr int           number_of_tasks = 64;
+    Concurrency::ThreadPool thread_pool(2, Concurrency::StealPolicy::Half);
+    std::latch              tasks_done(number_of_tasks);
+
+    auto res = thread_pool.submit([&thread_pool, &tasks_done]()
+    {
+        for (int i = 0; i < number_of_tasks; ++i)
+        {
+            auto task_res = thread_pool.submit([&tasks_done]() { tasks_done.count_down(); });
+        }
+
+        // Only the other worker can run the tasks.
+        tasks_done.wait();
+    });
+    ASSERT_TRUE(res.has_value());
+    ASSERT_EQ(res.value().wait_for(std::chrono::seconds(5)), std::future_status::ready);
+
+    const Concurrency::StealStatistics statistics = thread_pool.stealStatistics();
+    EXPECT_GT(statistics.stolen_tasks, statistics.successes);
+}
+
+TEST(ThreadPool, IdleWorkersPark_SubmitWakesOne)
+{
+    Concurrency::ThreadPool thread_pool;
+
+    for (int i = 0; i < 3; ++i)
+    {
+        // Long enough for every worker to go through spinning and yielding and park.
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+        auto res = thread_pool.submit(dummyFunction);
+        ASSERT_TRUE(res.has_value());
+        ASSERT_EQ(res.value().wait_for(std::chrono::seconds(1)), std::future_status::ready);
+        EXPECT_EQ(res.value().get(), return_number);
+    }
+}
+
+TEST(ThreadPool, DestroyIdlePool_WorkersExit)
+{
+    Concurrency::ThreadPool thread_pool;
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+}
+
+TEST(ThreadPool, Post_TaskRuns)
+{
+    Concurrency::ThreadPool thread_pool;
+    std::latch              latch(1);
+
+    ASSERT_TRUE(thread_pool.post([&latch]() { latch.count_down(); }));
+    latch.wait();
+}
+
+TEST(ThreadPool, Spawn_GetReturnsResult)
+{
+    Concurrency::ThreadPool thread_pool;
+
+    auto res = thread_pool.spawn(dummyFunction);
+    ASSERT_TRUE(res.has_value());
+    EXPECT_EQ(res.value().get(), return_number);
+    EXPECT_FALSE(res.value().valid());
+
+    auto void_res = thread_pool.spawn([]() {});
+    ASSERT_TRUE(void_res.has_value());
+    void_res.value().get();
+}
+
+TEST(ThreadPool, Spawn_ExceptionIsRethrownByGet)
+{
+    Concurrency::ThreadPool thread_pool;
+
+    auto res = thread_pool.spawn([]() -> int { throw std::runtime_error("task failed"); });
+    ASSERT_TRUE(res.has_value());
+    EXPECT_THROW(res.value().get(), std::runtime_error);
+}
+
+TEST(ThreadPool, SpawnFromTask_WaitRunsPendingTasks)
+{
+    // With a single worker the inner task can only run if waiting on it runs it.
+    Concurrency::ThreadPool thread_pool(1);
+
+    auto res = thread_pool.spawn([&thread_pool]()
+    {
+        auto inner_res = thread_pool.spawn(dummyFunction);
+        return inner_res.value().get() + 1;
+    });
+    ASSERT_TRUE(res.has_value());
+    EXPECT_EQ(res.value().get(), return_number + 1);
+}
+
+TEST(ThreadPool, SpawnAndDiscardFuture_TaskStillRuns)
+{
+    Concurrency::ThreadPool thread_pool;
+    std::latch              latch(1);
+
+    EXPECT_TRUE(thread_pool.spawn([&latch]() { latch.count_down(); }).has_value());
+    latch.wait();
+}
+
+TEST(ThreadPool, SpawnedTaskDroppedUnrun_ResultIsBrokenPromise)
+{
+    auto function = []() { return return_number; };
+    using Function = decltype(function);
+
+    // What happens to a spawned task still queued when its pool is destroyed.
+    auto* state = new Concurrency::Internal::TaskState<int, Function>(std::move(function));
+    {
+        Concurrency::Internal::MovableFunction task(Concurrency::Internal::SpawnedTask<int, Function>{state});
+        static_assert(Concurrency::Internal::MovableFunction::stored_inline<
+                      Concurrency::Internal::SpawnedTask<int, Function>>);
+    }
+
+    ASSERT_TRUE(state->isReady());
+    try
+    {
+        state->takeValue();
+        FAIL() << "Task should have been dropped";
+    } catch (const std::future_error& error)
+    {
+        EXPECT_EQ(error.code(), std::future_errc::broken_promise);
+    }
+
+    // The future's reference.
+    state->release();
+}
+
+TEST(ThreadPool, SubmitBulk_ReturnsAllResults)
+{
+    Concurrency::ThreadPool thread_pool;
+
+    std::vector<std::function<int()>> functions;
+    for (int i = 0; i < 100; ++i)
+    {
+        functions.emplace_back([i]() { return i; });
+    }
+
+    auto res = thread_pool.submitBulk(functions);
+    ASSERT_TRUE(res.has_value());
+    ASSERT_EQ(res.value().size(), functions.size());
+    for (int i = 0; i < 100; ++i)
+    {
+        EXPECT_EQ(res.value()[i].get(), i);
+    }
+}
+
+TEST(ThreadPool, ParallelFor_CallsFunctionOncePerIndex)
+{
+    Concurrency::ThreadPool thread_pool;
+
+    constexpr int                  size = 100'000;
+    std::vector<std::atomic<int>>  calls(size);
+    thread_pool.parallelFor(0, size, 64, [&calls](const int i) { calls[i].fetch_add(1, std::memory_order_relaxed); });
+
+    EXPECT_TRUE(std::all_of(calls.begin(), calls.end(), [](const std::atomic<int>& count) { return count.load() == 1; }));
+
+    // Empty range.
+    thread_pool.parallelFor(size, size, 64, [](const int) { FAIL(); });
+}
+
+TEST(ThreadPool, ParallelFor_IteratorsVisitEveryElement)
+{
+    Concurrency::ThreadPool thread_pool;
+
+    std::vector<int> numbers(10'000);
+    std::iota(numbers.begin(), numbers.end(), 0);
+    thread_pool.parallelFor(numbers.begin(), numbers.end(), 100, [](int& number) { number *= 2; });
+
+    for (int i = 0; i < static_cast<int>(numbers.size()); ++i)
+    {
+        EXPECT_EQ(numbers[i], 2 * i);
+    }
+}
+
+TEST(ThreadPool, ParallelForFromTask_SplitsOnOwnQueue)
+{
+    // With a single worker the split off halves can only run if the worker waiting for them runs them.
+    Concurrency::ThreadPool thread_pool(1);
+    std::atomic<int>        sum {0};
+
+    auto res = thread_pool.spawn([&thread_pool, &sum]()
+    {
+        thread_pool.parallelFor(0, 1'000, 10, [&sum](const int i) { sum.fetch_add(i, std::memory_order_relaxed); });
+    });
+    ASSERT_TRUE(res.has_value());
+    res.value().get();
+
+    EXPECT_EQ(sum.load(), 999 * 1'000 / 2);
+}
+
+TEST(ThreadPool, ParallelFor_ExceptionIsRethrown)
+{
+    Concurrency::ThreadPool thread_pool;
+
+    EXPECT_THROW(thread_pool.parallelFor(0, 10'000, 16, [](const int i)
+    {
+        if (i == 5'000)
+        {
+            throw std::runtime_error("element failed");
+        }
+    }), std::runtime_error);
+}
+
+TEST(ThreadPool, WaitIdle_ReturnsOnceQueuedTasksRan)
+{
+    Concurrency::ThreadPool thread_pool;
+    std::atomic<int>        done {0};
+
+    for (int round = 1; round <= 3; ++round)
+    {
+        for (int i = 0; i < 100; ++i)
+        {
+            ASSERT_TRUE(thread_pool.post([&done]() { done.fetch_add(1, std::memory_order_relaxed); }));
+        }
+        ASSERT_TRUE(thread_pool.waitIdle());
+        EXPECT_EQ(done.load(), round * 100);
+    }
+}
+
+TEST(ThreadPool, WaitIdle_FalseAtDeadlineWhileBusy)
+{
+    Concurrency::ThreadPool thread_pool;
+    std::latch              release(1);
+
+    ASSERT_TRUE(thread_pool.post([&release]() { release.wait(); }));
+    EXPECT_FALSE(thread_pool.waitIdle(Concurrency::RingWaitClock::now() + std::chrono::milliseconds(10)));
+
+    release.count_down();
+    EXPECT_TRUE(thread_pool.waitIdle());
+}
+
+TEST(ThreadPool, HelpingAnotherPool_LeavesOwnLocalTasksToOwnPool)
+{
+    Concurrency::ThreadPool pool_a(1);
+    Concurrency::ThreadPool pool_b(1);
+    std::atomic<int>        done {0};
+
+    // A worker of pool_a queues on its local queue of pool_a, then helps pool_b: pool_b must not run that task.
+    auto helped = pool_a.submit([&pool_a, &pool_b, &done]()
+    {
+        pool_a.post([&done]() { done.fetch_add(1); });
+        return pool_b.runPendingTask();
+    });
+    EXPECT_FALSE(helped.value().get());
+
+    EXPECT_TRUE(pool_a.waitIdle(Concurrency::RingWaitClock::now() + std::chrono::seconds(5)));
+    EXPECT_EQ(done.load(), 1);
+    EXPECT_EQ(pool_a.metrics().pending_tasks, 0u);
+    EXPECT_EQ(pool_b.metrics().pending_tasks, 0u);
+}
+
+TEST(ThreadPool, ShutdownDrainAll_RunsQueuedTasksThenRejects)
+{
+    Concurrency::ThreadPool thread_pool(1);
+    std::atomic<int>        done {0};
+    std::latch              release(1);
+
+    ASSERT_TRUE(thread_pool.post([&release]() { release.wait(); }));
+    for (int i = 0; i < 10; ++i)
+    {
+        ASSERT_TRUE(thread_pool.post([&done]() { done.fetch_add(1, std::memory_order_relaxed); }));
+    }
+
+    // A task still running when shutdown starts can add subtasks and wait for them.
+    auto res = thread_pool.spawn([&thread_pool]()
+    {
+        auto inner_res = thread_pool.spawn(dummyFunction);
+        return inner_res.value().get();
+    });
+
+    std::jthread releaser([&thread_pool, &release]()
+    {
+        EXPECT_TRUE(eventually([&thread_pool]() { return thread_pool.state() == Concurrency::PoolState::Draining; }));
+        release.count_down();
+    });
+
+    EXPECT_EQ(thread_pool.state(), Concurrency::PoolState::Running);
+    EXPECT_EQ(thread_pool.shutdown(), 0u);
+    EXPECT_EQ(thread_pool.state(), Concurrency::PoolState::Stopping);
+    EXPECT_EQ(done.load(), 10);
+    EXPECT_EQ(res.value().get(), return_number);
+
+    EXPECT_FALSE(thread_pool.post([]() {}));
+    EXPECT_FALSE(thread_pool.submit(dummyFunction).has_value());
+}
+
+TEST(ThreadPool, ShutdownCancelNow_DropsQueuedTasks)
+{
+    Concurrency::ThreadPool thread_pool(1);
+    std::latch              started(1);
+    std::latch              release(1);
+
+    ASSERT_TRUE(thread_pool.post([&started, &release]()
+    {
+        started.count_down();
+        release.wait();
+    }));
+    started.wait();
+
+    std::vector<Concurrency::TaskFuture<int>> futures;
+    for (int i = 0; i < 10; ++i)
+    {
+        futures.push_back(std::move(thread_pool.spawn(dummyFunction).value()));
+    }
+
+    // Released once the worker won't pick up another task, otherwise it could run the queued ones.
+    std::jthread releaser([&thread_pool, &release]()
+    {
+        EXPECT_TRUE(eventually([&thread_pool]() { return thread_pool.state() == Concurrency::PoolState::Stopping; }));
+        release.count_down();
+    });
+
+    EXPECT_EQ(thread_pool.shutdown(Concurrency::DrainPolicy::cancelNow()), 10u);
+    for (Concurrency::TaskFuture<int>& future : futures)
+    {
+        EXPECT_THROW(future.get(), std::future_error);
+    }
+}
+
+TEST(ThreadPool, ShutdownDrainUntil_DropsTasksLeftAtDeadline)
+{
+    Concurrency::ThreadPool thread_pool(1);
+    std::latch              started(1);
+    std::latch              release(1);
+
+    ASSERT_TRUE(thread_pool.post([&started, &release]()
+    {
+        started.count_down();
+        release.wait();
+    }));
+    started.wait();
+
+    for (int i = 0; i < 5; ++i)
+    {
+        ASSERT_TRUE(thread_pool.post([]() {}));
+    }
+
+    // Released once the deadline has passed and the workers are stopping, nothing queued can run before.
+    std::jthread releaser([&thread_pool, &release]()
+    {
+        EXPECT_TRUE(eventually([&thread_pool]() { return thread_pool.state() == Concurrency::PoolState::Stopping; }));
+        release.count_down();
+    });
+
+    const auto deadline = Concurrency::RingWaitClock::now() + std::chrono::milliseconds(10);
+    EXPECT_EQ(thread_pool.shutdown(Concurrency::DrainPolicy::drainUntil(deadline)), 5u);
+}
+
+TEST(ThreadPool, PinnedWorkers_RunOnTheirDomainCpus)
+{
+    const int cpu = Concurrency::CpuTopology::allowedCpus().front();
+
+    // Two domains on the same CPU, so the test runs on any machine.
+    Concurrency::ThreadPool thread_pool(Concurrency::CpuTopology{.domains = {{cpu}, {cpu}}});
+    ASSERT_EQ(thread_pool.numberOfDomains(), 2u);
+
+    for (size_t domain = 0; domain < thread_pool.numberOfDomains(); ++domain)
+    {
+        auto res = thread_pool.submitToDomain(domain, []() { return sched_getcpu(); });
+        ASSERT_TRUE(res.has_value());
+        EXPECT_EQ(res.value().get(), cpu);
+    }
+
+    EXPECT_FALSE(thread_pool.postToDomain(2, []() {}));
+    EXPECT_FALSE(thread_pool.submitToDomain(2, dummyFunction).has_value());
+}
+
+TEST(ThreadPool, DomainPool_RunsForkJoinAcrossDomains)
+{
+    const int cpu = Concurrency::CpuTopology::allowedCpus().front();
+    Concurrency::ThreadPool thread_pool(Concurrency::CpuTopology{.domains = {{cpu}, {cpu}}, .pin_workers = false});
+
+    std::atomic<int> sum {0};
+    thread_pool.parallelFor(0, 10'000, 8, [&sum](const int i) { sum.fetch_add(i, std::memory_order_relaxed); });
+    EXPECT_EQ(sum.load(), 9'999 * 10'000 / 2);
+}
+
+TEST(ThreadPool, NoWorkersAsked_StillGetsOne)
+{
+    // Destroying a pool without workers waited forever for its queued task.
+    {
+        Concurrency::ThreadPool thread_pool(0);
+        auto res = thread_pool.submit(dummyFunction);
+        ASSERT_TRUE(res.has_value());
+        EXPECT_EQ(res.value().get(), return_number);
+        EXPECT_TRUE(thread_pool.post([]() {}));
+    }
+    {
+        Concurrency::ThreadPool thread_pool(Concurrency::CpuTopology{.domains = {{}, {}}});
+        ASSERT_EQ(thread_pool.numberOfDomains(), 2u);
+        auto res = thread_pool.submit(dummyFunction);
+        ASSERT_TRUE(res.has_value());
+        EXPECT_EQ(res.value().get(), return_number);
+
+        // The worker is in the first domain, it takes the second one's tasks as well.
+        auto other_domain = thread_pool.submitToDomain(1, dummyFunction);
+        ASSERT_TRUE(other_domain.has_value());
+        EXPECT_EQ(other_domain.value().get(), return_number);
+    }
+}
+
+namespace {
+
+// Queue the tasks on a single worker kept busy, so they are all waiting when it picks the first one.
+std::vector<Concurrency::TaskPriority> runOrderOnBusyWorker(const std::vector<Concurrency::TaskPriority>& priorities)
+{
+    Concurrency::ThreadPool                thread_pool(1);
+    std::latch                             release(1);
+    std::vector<Concurrency::TaskPriority> order;
+
+    EXPECT_TRUE(thread_pool.post([&release]() { release.wait(); }));
+    for (const Concurrency::TaskPriority priority : priorities)
+    {
+        EXPECT_TRUE(thread_pool.post([&order, priority]() { order.push_back(priority); }, priority));
+    }
+
+    release.count_down();
+    EXPECT_TRUE(thread_pool.waitIdle());
+    return order;
+}
+
+} // namespace
+
+TEST(ThreadPool, Priorities_HigherPrioritiesRunFirst)
+{
+    using Concurrency::TaskPriority;
+
+    std::vector<TaskPriority> priorities;
+    for (const TaskPriority priority : {TaskPriority::Low, TaskPriority::Normal, TaskPriority::High})
+    {
+        priorities.insert(priorities.end(), 5, priority);
+    }
+    const std::vector<TaskPriority> order = runOrderOnBusyWorker(priorities);
+    ASSERT_EQ(order.size(), priorities.size());
+
+    // Lower priorities get a turn now and then, on average they still run later.
+    std::array<size_t, 3> position_sums {};
+    for (size_t position = 0; position < order.size(); ++position)
+    {
+        position_sums[static_cast<size_t>(order[position])] += position;
+    }
+    EXPECT_LT(position_sums[static_cast<size_t>(TaskPriority::High)],
+              position_sums[static_cast<size_t>(TaskPriority::Normal)]);
+    EXPECT_LT(position_sums[static_cast<size_t>(TaskPriority::Normal)],
+              position_sums[static_cast<size_t>(TaskPriority::Low)]);
+}
+
+TEST(ThreadPool, Priorities_LowPriorityIsNotStarved)
+{
+    using Concurrency::TaskPriority;
+
+    std::vector<TaskPriority> priorities {TaskPriority::Low};
+    priorities.insert(priorities.end(), 100, TaskPriority::High);
+
+    const std::vector<TaskPriority> order = runOrderOnBusyWorker(priorities);
+    const auto low_position = std::find(order.begin(), order.end(), TaskPriority::Low) - order.begin();
+    EXPECT_LE(low_position, 16);
+}
+
+TEST(ThreadPool, Elastic_StartsWithMinWorkers)
+{
+    Concurrency::ThreadPool thread_pool(Concurrency::ElasticLimits {.min_workers = 2, .max_workers = 8});
+    EXPECT_EQ(thread_pool.numberOfWorkers(), 2);
+
+    Concurrency::ThreadPool fixed_pool(1);
+    EXPECT_EQ(fixed_pool.numberOfWorkers(), 1);
+}
+
+TEST(ThreadPool, Elastic_GrowsWhenQueuesBackUpThenRetiresIdleWorkers)
+{
+    Concurrency::ThreadPool thread_pool(Concurrency::ElasticLimits {.min_workers  = 1,
+                                                                    .max_workers  = 4,
+                                                                    .idle_timeout = std::chrono::milliseconds(20)});
+
+    // Every task waits for all four to run at once, which needs four workers.
+    constexpr int    number_of_tasks = 4;
+    std::atomic<int> running {0};
+    std::atomic<int> all_met {0};
+    for (int i = 0; i < number_of_tasks; ++i)
+    {
+        ASSERT_TRUE(thread_pool.post([&running, &all_met]()
+        {
+            running.fetch_add(1);
+            if (eventually([&running]() { return running.load() == number_of_tasks; }))
+            {
+                all_met.fetch_add(1);
+            }
+        }));
+    }
+
+    ASSERT_TRUE(thread_pool.waitIdle());
+    EXPECT_EQ(all_met.load(), number_of_tasks);
+    EXPECT_EQ(thread_pool.numberOfWorkers(), 4);
+
+    EXPECT_TRUE(eventually([&thread_pool]() { return thread_pool.numberOfWorkers() == 1; }));
+}
+
+TEST(ThreadPool, Elastic_BlockingRegionAddsAWorker)
+{
+    Concurrency::ThreadPool thread_pool(Concurrency::ElasticLimits {.min_workers = 1, .max_workers = 2});
+
+    std::atomic<bool> released {false};
+    auto blocked = thread_pool.submit([&thread_pool, &released]()
+    {
+        const auto blocking_region = thread_pool.blockingRegion();
+        const size_t workers = thread_pool.numberOfWorkers();
+        // Released by a task that can only run on the added worker.
+        eventually([&released]() { return released.load(); });
+        return workers;
+    });
+    ASSERT_TRUE(blocked.has_value());
+
+    ASSERT_TRUE(eventually([&thread_pool]() { return thread_pool.numberOfWorkers() == 2; }));
+    ASSERT_TRUE(thread_pool.post([&released]() { released.store(true); }));
+
+    EXPECT_EQ(blocked.value().get(), 2);
+    EXPECT_TRUE(released.load());
+}
+
+TEST(ThreadPool, Elastic_BurstsAcrossGrowAndRetireRunEveryTask)
+{
+    Concurrency::ThreadPool thread_pool(Concurrency::ElasticLimits {.min_workers  = 1,
+                                                                    .max_workers  = 6,
+                                                                    .idle_timeout = std::chrono::milliseconds(1)});
+
+    std::atomic<int> counter {0};
+    for (int burst = 0; burst < 20; ++burst)
+    {
+        for (int i = 0; i < 50; ++i)
+        {
+            ASSERT_TRUE(thread_pool.post([&thread_pool, &counter]()
+            {
+                // Forked tasks go through the local queues of workers that may retire right after.
+                thread_pool.post([&counter]() { counter.fetch_add(1); });
+                counter.fetch_add(1);
+            }));
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(3));
+    }
+
+    ASSERT_TRUE(thread_pool.waitIdle());
+    EXPECT_EQ(counter.load(), 20 * 50 * 2);
+    EXPECT_LE(thread_pool.numberOfWorkers(), 6);
+}
+
+TEST(ThreadPool, Metrics_EveryTaskIsOnePickup)
+{
+    if constexpr (!Concurrency::Internal::WorkerCounters::enabled)
+    {
+        GTEST_SKIP() << "built with CONCURRENCY_THREADPOOL_METRICS=0";
+    }
+
+    constexpr int           number_of_tasks = 1'000;
+    Concurrency::ThreadPool thread_pool(2);
+    std::atomic<int>        forked {0};
+    for (int i = 0; i < number_of_tasks; ++i)
+    {
+        // Every task also forks one on its worker's local queue.
+        ASSERT_TRUE(thread_pool.post([&thread_pool, &forked]()
+        {
+            thread_pool.post([&forked]() { forked.fetch_add(1); });
+        }));
+    }
+    ASSERT_TRUE(thread_pool.waitIdle());
+    ASSERT_EQ(forked.load(), number_of_tasks);
+
+    const Concurrency::ThreadPoolMetrics metrics = thread_pool.metrics();
+    const Concurrency::WorkerMetrics     total   = metrics.total();
+    ASSERT_EQ(metrics.workers.size(), thread_pool.numberOfWorkers() + 1);
+    EXPECT_EQ(metrics.pending_tasks, 0);
+    EXPECT_EQ(metrics.shared_queue_depth, 0);
+    EXPECT_EQ(total.local_queue_depth, 0);
+
+    EXPECT_EQ(total.tasksExecuted(), 2 * number_of_tasks);
+    EXPECT_EQ(total.shared_pushes, number_of_tasks);
+    EXPECT_EQ(total.shared_pickups, number_of_tasks);
+    // The posting thread is outside the pool, its pushes land in the last slot.
+    EXPECT_EQ(metrics.workers.back().shared_pushes, number_of_tasks);
+}
+
+TEST(ThreadPool, Metrics_IdleWorkersCountSpinsParksAndIdleTime)
+{
+    if constexpr (!Concurrency::Internal::WorkerCounters::enabled)
+    {
+        GTEST_SKIP() << "built with CONCURRENCY_THREADPOOL_METRICS=0";
+    }
+
+    Concurrency::ThreadPool thread_pool(1);
+    ASSERT_TRUE(eventually([&thread_pool]() { return thread_pool.metrics().workers[0].parks > 0; }));
+
+    // Waking the parked worker for a task is an unpark, counted for the pushing thread.
+    ASSERT_TRUE(thread_pool.post([]() {}));
+    ASSERT_TRUE(thread_pool.waitIdle());
+    ASSERT_TRUE(eventually([&thread_pool]() { return thread_pool.metrics().workers[0].idle_time.count() > 0; }));
+
+    const Concurrency::ThreadPoolMetrics metrics = thread_pool.metrics();
+    EXPECT_GT(metrics.workers[0].idle_spins, 0);
+    EXPECT_EQ(metrics.workers.back().unparks, 1);
+}
+
+TEST(ThreadPool, Metrics_TaskHistogramsCountEveryTask)
+{
+    if constexpr (!Concurrency::Internal::WorkerCounters::histograms)
+    {
+        GTEST_SKIP() << "built without CONCURRENCY_THREADPOOL_TASK_HISTOGRAMS";
+    }
+
+    Concurrency::ThreadPool thread_pool(2);
+    for (int i = 0; i < 100; ++i)
+    {
+        ASSERT_TRUE(thread_pool.post([]() { std::this_thread::sleep_for(std::chrono::microseconds(100)); }));
+    }
+    ASSERT_TRUE(thread_pool.waitIdle());
+
+    const Concurrency::ThreadPoolMetrics metrics = thread_pool.metrics();
+    EXPECT_EQ(metrics.queue_wait.count(), 100);
+    EXPECT_EQ(metrics.run_time.count(), 100);
+    EXPECT_GE(metrics.run_time.percentile(0.5), std::chrono::microseconds(100));
+}
+
+TEST(LatencyHistogram, Percentile_UpperBoundOfTheBucket)
+{
+    Concurrency::LatencyHistogram histogram;
+    EXPECT_EQ(histogram.percentile(0.5), std::chrono::nanoseconds::zero());
+
+    // 90 durations in [2^10, 2^11) ns, 10 in [2^20, 2^21) ns.
+    histogram.buckets[10] = 90;
+    histogram.buckets[20] = 10;
+    EXPECT_EQ(histogram.count(), 100);
+    EXPECT_EQ(histogram.percentile(0.5), std::chrono::nanoseconds(1 << 11));
+    EXPECT_EQ(histogram.percentile(0.99), std::chrono::nanoseconds(1 << 21));
+}
+
+namespace {
+
+// Keeps the only worker of a pool busy until release(), so queued tasks stay queued.
+class BusyWorker
+{
+public:
+    explicit BusyWorker (Concurrency::ThreadPool& thread_pool)
+    {
+        thread_pool.post([this]()
+        {
+            _running.store(true);
+            _released.wait(false);
+        });
+        eventually([this]() { return _running.load(); });
+    }
+
+    ~BusyWorker ()
+    {
+        release();
+    }
+
+    void release ()
+    {
+        _released.store(true);
+        _released.notify_all();
+    }
+
+private:
+    std::atomic<bool> _running {false};
+    std::atomic<bool> _released {false};
+};
+
+} // namespace
+
+TEST(ThreadPool, QueueBound_FailFastAndTrySubmitRejectWhenFull)
+{
+    Concurrency::ThreadPool thread_pool(1);
+    BusyWorker              busy_worker(thread_pool);
+    thread_pool.setQueueBound({.capacity = 2, .policy = Concurrency::OverflowPolicy::FailFast});
+
+    auto first  = thread_pool.submit(dummyFunction);
+    auto second = thread_pool.submit(dummyFunction);
+    ASSERT_TRUE(first.has_value());
+    ASSERT_TRUE(second.has_value());
+    EXPECT_FALSE(thread_pool.submit(dummyFunction).has_value());
+    EXPECT_FALSE(thread_pool.post([]() {}));
+
+    // trySubmit fails on a full queue whatever the policy.
+    thread_pool.setQueueBound({.capacity = 2, .policy = Concurrency::OverflowPolicy::Block});
+    EXPECT_FALSE(thread_pool.trySubmit(dummyFunction).has_value());
+    EXPECT_EQ(thread_pool.metrics().shared_queue_depth, 2);
+
+    busy_worker.release();
+    EXPECT_EQ(first.value().get(), return_number);
+    EXPECT_EQ(second.value().get(), return_number);
+    ASSERT_TRUE(thread_pool.waitIdle());
+    EXPECT_TRUE(thread_pool.trySubmit(dummyFunction).has_value());
+}
+
+TEST(ThreadPool, QueueBound_CallerRunsRunsTheTaskOnTheCallingThread)
+{
+    Concurrency::ThreadPool thread_pool(1);
+    BusyWorker              busy_worker(thread_pool);
+    thread_pool.setQueueBound({.capacity = 1, .policy = Concurrency::OverflowPolicy::CallerRuns});
+
+    auto queued = thread_pool.submit([]() { return std::this_thread::get_id(); });
+    auto ran_here = thread_pool.submit([]() { return std::this_thread::get_id(); });
+    ASSERT_TRUE(ran_here.has_value());
+    ASSERT_EQ(ran_here.value().wait_for(std::chrono::seconds(0)), std::future_status::ready);
+    EXPECT_EQ(ran_here.value().get(), std::this_thread::get_id());
+
+    busy_worker.release();
+    EXPECT_NE(queued.value().get(), std::this_thread::get_id());
+}
+
+TEST(ThreadPool, QueueBound_DropOldestDropsFromTheLowestPriority)
+{
+    using Concurrency::TaskPriority;
+
+    Concurrency::ThreadPool thread_pool(1);
+    BusyWorker              busy_worker(thread_pool);
+    thread_pool.setQueueBound({.capacity = 2, .policy = Concurrency::OverflowPolicy::DropOldest});
+
+    auto normal = thread_pool.submit(dummyFunction, TaskPriority::Normal);
+    auto low    = thread_pool.submit(dummyFunction, TaskPriority::Low);
+    auto newest = thread_pool.submit(dummyFunction, TaskPriority::Normal);
+    ASSERT_TRUE(newest.has_value());
+    EXPECT_EQ(thread_pool.metrics().shared_queue_depth, 2);
+
+    busy_worker.release();
+    EXPECT_EQ(normal.value().get(), return_number);
+    EXPECT_EQ(newest.value().get(), return_number);
+    EXPECT_THROW(low.value().get(), std::future_error);
+}
+
+TEST(ThreadPool, QueueBound_DropOldestRunsThePoolsOwnTasks)
+{
+    Concurrency::ThreadPool thread_pool(1);
+    BusyWorker              busy_worker(thread_pool);
+    thread_pool.setQueueBound({.capacity = 1, .policy = Concurrency::OverflowPolicy::DropOldest});
+
+    // The halves parallelFor queues are the oldest tasks when the body posts, dropping them would never return.
+    constexpr int    size = 64;
+    std::atomic<int> calls {0};
+    thread_pool.parallelFor(0, size, 1, [&thread_pool, &calls](const int)
+    {
+        calls.fetch_add(1, std::memory_order_relaxed);
+        thread_pool.post([]() {});
+    });
+    EXPECT_EQ(calls.load(), size);
+
+    busy_worker.release();
+    ASSERT_TRUE(thread_pool.waitIdle());
+    EXPECT_EQ(thread_pool.metrics().pending_tasks, 0u);
+}
+
+TEST(ThreadPool, QueueBound_BlockWaitsForRoomAndGivesUpOnShutdown)
+{
+    Concurrency::ThreadPool thread_pool(1);
+    auto                    busy_worker = std::make_unique<BusyWorker>(thread_pool);
+    thread_pool.setQueueBound({.capacity = 1, .policy = Concurrency::OverflowPolicy::Block});
+    ASSERT_TRUE(thread_pool.post([]() {}));
+
+    const auto blocked_producers = [&thread_pool]() { return thread_pool.metrics().blocked_producers; };
+
+    std::atomic<bool> returned {false};
+    std::thread producer([&thread_pool, &returned]()
+    {
+        EXPECT_TRUE(thread_pool.post([]() {}));
+        returned.store(true);
+    });
+    ASSERT_TRUE(eventually([&blocked_producers]() { return blocked_producers() == 1; }));
+    EXPECT_FALSE(returned.load());
+
+    busy_worker->release();
+    EXPECT_TRUE(eventually([&returned]() { return returned.load(); }));
+    EXPECT_EQ(blocked_producers(), 0u);
+    producer.join();
+    ASSERT_TRUE(thread_pool.waitIdle());
+
+    // Full again, a producer blocked at shutdown is refused instead of waiting forever.
+    busy_worker = std::make_unique<BusyWorker>(thread_pool);
+    ASSERT_TRUE(thread_pool.post([]() {}));
+    std::thread late_producer([&thread_pool]() { EXPECT_FALSE(thread_pool.post([]() {})); });
+    ASSERT_TRUE(eventually([&blocked_producers]() { return blocked_producers() == 1; }));
+
+    // The producer only gives up once shutdown has started, the worker is released then so the drain can finish.
+    std::thread releaser([&busy_worker, &blocked_producers]()
+    {
+        EXPECT_TRUE(eventually([&blocked_producers]() { return blocked_producers() == 0; }));
+        busy_worker->release();
+    });
+    thread_pool.shutdown(Concurrency::DrainPolicy::drainAll());
+    late_producer.join();
+    releaser.join();
+}
+
+TEST(ThreadPool, QueueBound_WorkersAreNeverRefused)
+{
+    Concurrency::ThreadPool thread_pool(1);
+    thread_pool.setQueueBound({.capacity = 1, .policy = Concurrency::OverflowPolicy::FailFast});
+
+    std::atomic<int> counter {0};
+    auto parent = thread_pool.submit([&thread_pool, &counter]()
+    {
+        bool all_queued = true;
+        for (int i = 0; i < 10; ++i)
+        {
+            all_queued &= thread_pool.post([&counter]() { counter.fetch_add(1); }, Concurrency::TaskPriority::High);
+        }
+        return all_queued;
+    });
+    EXPECT_TRUE(parent.value().get());
+    ASSERT_TRUE(thread_pool.waitIdle());
+    EXPECT_EQ(counter.load(), 10);
+}
+
+TEST(ThreadPool, Timer_SubmitAfterRunsOnceTheDelayHasPassed)
+{
+    Concurrency::ThreadPool thread_pool(1);
+    const auto              delay = std::chrono::milliseconds(20);
+
+    const auto submitted_at = std::chrono::steady_clock::now();
+    auto       fired_at     = thread_pool.submitAfter(delay, []() { return std::chrono::steady_clock::now(); });
+    ASSERT_TRUE(fired_at.has_value());
+    EXPECT_GE(fired_at.value().get() - submitted_at, delay);
+}
+
+TEST(ThreadPool, Timer_SubmitAtFiresInDeadlineOrder)
+{
+    Concurrency::ThreadPool thread_pool(1);
+    const auto              now = std::chrono::steady_clock::now();
+
+    std::mutex       mutex;
+    std::vector<int> order;
+    auto record = [&mutex, &order](const int timer)
+    {
+        return [&mutex, &order, timer]()
+        {
+            std::lock_guard lock(mutex);
+            order.push_back(timer);
+        };
+    };
+    auto third  = thread_pool.submitAt(now + std::chrono::milliseconds(30), record(3));
+    auto first  = thread_pool.submitAt(now + std::chrono::milliseconds(10), record(1));
+    auto second = thread_pool.submitAt(now + std::chrono::milliseconds(20), record(2));
+
+    third.value().get();
+    first.value().get();
+    second.value().get();
+    EXPECT_EQ(order, (std::vector<int> {1, 2, 3}));
+}
+
+TEST(ThreadPool, Timer_AnEarlierTimerIsNotHeldUpByALaterOne)
+{
+    Concurrency::ThreadPool thread_pool(1);
+    auto late  = thread_pool.submitAfter(std::chrono::hours(1), dummyFunction);
+    // Let the worker go to sleep until the late timer.
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+    auto early = thread_pool.submitAfter(std::chrono::milliseconds(1), dummyFunction);
+    ASSERT_TRUE(early.has_value());
+    ASSERT_EQ(early.value().wait_for(std::chrono::seconds(5)), std::future_status::ready);
+    EXPECT_EQ(late.value().wait_for(std::chrono::seconds(0)), std::future_status::timeout);
+}
+
+TEST(ThreadPool, Timer_FiresWhileTheWorkersAreBusy)
+{
+    Concurrency::ThreadPool thread_pool(1);
+    std::atomic<bool>       stop {false};
+    std::function<void()>   busy_loop = [&thread_pool, &stop, &busy_loop]()
+    {
+        if (!stop.load())
+        {
+            thread_pool.post([&busy_loop]() { busy_loop(); });
+        }
+    };
+    thread_pool.post([&busy_loop]() { busy_loop(); });
+
+    auto timer = thread_pool.submitAfter(std::chrono::milliseconds(5), [&stop]() { stop.store(true); });
+    EXPECT_EQ(timer.value().wait_for(std::chrono::seconds(5)), std::future_status::ready);
+    stop.store(true);
+    ASSERT_TRUE(thread_pool.waitIdle());
+}
+
+TEST(ThreadPool, Timer_SubmitEveryRunsUntilCancelled)
+{
+    Concurrency::ThreadPool thread_pool(1);
+    std::atomic<int>        runs {0};
+
+    auto timer = thread_pool.submitEvery(std::chrono::milliseconds(1), [&runs]() { runs.fetch_add(1); });
+    ASSERT_TRUE(timer.has_value());
+    EXPECT_TRUE(eventually([&runs]() { return runs.load() >= 3; }));
+
+    timer.value().cancel();
+    EXPECT_TRUE(timer.value().isCancelled());
+    // cancel() waited for a run that had already started.
+    const int runs_after_cancel = runs.load();
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    EXPECT_EQ(runs.load(), runs_after_cancel);
+}
+
+TEST(ThreadPool, Timer_CancelWaitsForTheRunInProgress)
+{
+    Concurrency::ThreadPool thread_pool(1);
+    std::atomic<bool>       running {false};
+    std::atomic<bool>       release {false};
+    std::atomic<bool>       finished {false};
+
+    auto timer = thread_pool.submitEvery(std::chrono::milliseconds(1), [&running, &release, &finished]()
+    {
+        running.store(true);
+        while (!release.load())
+        {
+            std::this_thread::yield();
+        }
+        finished.store(true);
+    });
+    ASSERT_TRUE(timer.has_value());
+    ASSERT_TRUE(eventually([&running]() { return running.load(); }));
+
+    std::atomic<bool> cancelled {false};
+    std::thread       canceller([&timer, &cancelled]()
+    {
+        timer.value().cancel();
+        cancelled.store(true);
+    });
+    ASSERT_TRUE(eventually([&timer]() { return timer.value().isCancelled(); }));
+    EXPECT_FALSE(cancelled.load());
+
+    release.store(true);
+    canceller.join();
+    EXPECT_TRUE(finished.load());
+}
+
+TEST(ThreadPool, Timer_RunCanCancelItsOwnTimer)
+{
+    Concurrency::ThreadPool                   thread_pool(1);
+    std::atomic<int>                          runs {0};
+    std::optional<Concurrency::PeriodicTimer> timer;
+    std::mutex                                timer_mutex;
+
+    std::unique_lock lock(timer_mutex);
+    timer = thread_pool.submitEvery(std::chrono::milliseconds(1), [&runs, &timer, &timer_mutex]()
+    {
+        std::lock_guard lock(timer_mutex);
+        runs.fetch_add(1);
+        timer->cancel();
+    });
+    ASSERT_TRUE(timer.has_value());
+    lock.unlock();
+
+    EXPECT_TRUE(eventually([&runs]() { return runs.load() == 1; }));
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    EXPECT_EQ(runs.load(), 1);
+    EXPECT_TRUE(timer->isCancelled());
+    ASSERT_TRUE(thread_pool.waitIdle());
+}
+
+TEST(ThreadPool, Timer_ShutdownDropsTimersNotDue)
+{
+    Concurrency::ThreadPool thread_pool(1);
+    std::atomic<int>        runs {0};
+
+    auto once     = thread_pool.submitAfter(std::chrono::hours(1), dummyFunction);
+    auto periodic = thread_pool.submitEvery(std::chrono::hours(1), [&runs]() { runs.fetch_add(1); });
+    ASSERT_TRUE(once.has_value());
+    ASSERT_TRUE(periodic.has_value());
+    // Timers aren't pending tasks until due.
+    EXPECT_TRUE(thread_pool.waitIdle(std::chrono::steady_clock::now()));
+
+    EXPECT_EQ(thread_pool.shutdown(), 2);
+    EXPECT_THROW(once.value().get(), std::future_error);
+    EXPECT_EQ(runs.load(), 0);
+    EXPECT_FALSE(thread_pool.submitAfter(std::chrono::milliseconds(1), dummyFunction).has_value());
+}
+
+TEST(ThreadPool, Timer_PushFailsOnceShutdownClearedTheTimers)
+{
+    // What a submitAt sees that passed the pool's shutdown check just before shutdown() cleared the timers.
+    Concurrency::Internal::TimerQueue timers;
+    bool                              became_first = false;
+    int                               runs         = 0;
+
+    ASSERT_TRUE(timers.push(Concurrency::RingWaitClock::now(), [&runs]() { ++runs; }, became_first));
+    EXPECT_EQ(timers.clear(), 1u);
+
+    EXPECT_FALSE(timers.push(Concurrency::RingWaitClock::now(), [&runs]() { ++runs; }, became_first));
+    EXPECT_TRUE(timers.empty());
+    EXPECT_FALSE(timers.popDue(Concurrency::RingWaitClock::time_point::max()).has_value());
+    EXPECT_EQ(runs, 0);
+}
+
+TEST(ThreadPool, Timer_DueTimersDontStarveLowPriority)
+{
+    using Concurrency::TaskPriority;
+
+    Concurrency::ThreadPool thread_pool(1);
+    BusyWorker              busy_worker(thread_pool);
+    std::atomic<bool>       stop {false};
+    std::atomic<bool>       low_ran {false};
+
+    // A High backlog that never runs out, and a timer that is due every time the worker looks for one.
+    std::function<void()> high_task = [&thread_pool, &stop, &high_task]()
+    {
+        const auto until = std::chrono::steady_clock::now() + std::chrono::microseconds(10);
+        while (std::chrono::steady_clock::now() < until)
+        {
+        }
+        if (!stop.load())
+        {
+            thread_pool.post(high_task, TaskPriority::High);
+        }
+    };
+    for (int i = 0; i < 4; ++i)
+    {
+        ASSERT_TRUE(thread_pool.post(high_task, TaskPriority::High));
+    }
+    auto timer = thread_pool.submitEvery(std::chrono::microseconds(1), []() {});
+    ASSERT_TRUE(timer.has_value());
+    ASSERT_TRUE(thread_pool.post([&low_ran]() { low_ran.store(true); }, TaskPriority::Low));
+
+    busy_worker.release();
+    EXPECT_TRUE(eventually([&low_ran]() { return low_ran.load(); }));
+
+    stop.store(true);
+    timer.value().cancel();
+    ASSERT_TRUE(thread_pool.waitIdle());
+}
+
+TEST(ThreadPool, Cancellation_QueuedTaskIsDroppedOnceCancelled)
+{
+    Concurrency::ThreadPool         thread_pool(1);
+    Concurrency::CancellationSource source;
+    std::atomic<int>                runs {0};
+    {
+        BusyWorker busy_worker(thread_pool);
+        auto       result = thread_pool.submit(source.token(), [&runs]() { return runs.fetch_add(1); });
+        ASSERT_TRUE(thread_pool.post(source.token(), [&runs]() { runs.fetch_add(1); }));
+        ASSERT_TRUE(result.has_value());
+
+        source.cancel();
+        busy_worker.release();
+        EXPECT_THROW(result.value().get(), std::future_error);
+    }
+    ASSERT_TRUE(thread_pool.waitIdle());
+    EXPECT_EQ(runs.load(), 0);
+}
+
+TEST(ThreadPool, Cancellation_RunningTaskSeesItsToken)
+{
+    Concurrency::ThreadPool         thread_pool(1);
+    Concurrency::CancellationSource source;
+    std::atomic<bool>               started {false};
+
+    auto result = thread_pool.submit(source.token(), [&started]()
+    {
+        started.store(true);
+        while (!Concurrency::InterruptibleThread::isInterrupted())
+        {
+            std::this_thread::yield();
+        }
+        return Concurrency::CancellationToken::current().isCancelled();
+    });
+    ASSERT_TRUE(eventually([&started]() { return started.load(); }));
+
+    source.cancel();
+    EXPECT_TRUE(result.value().get());
+    // The token is only current while its task runs.
+    auto after = thread_pool.submit([]() { return Concurrency::CancellationToken::current().canBeCancelled(); });
+    EXPECT_FALSE(after.value().get());
+}
+
+TEST(ThreadPool, Cancellation_InterruptingAThreadDropsItsTasks)
+{
+    Concurrency::ThreadPool thread_pool(1);
+    std::atomic<int>        runs {0};
+    std::atomic<bool>       queued {false};
+    BusyWorker              busy_worker(thread_pool);
+
+    Concurrency::InterruptibleThread thread([&thread_pool, &runs, &queued]()
+    {
+        for (int i = 0; i < 10; ++i)
+        {
+            thread_pool.post(Concurrency::CancellationToken::current(), [&runs]() { runs.fetch_add(1); });
+        }
+        queued.store(true);
+        while (!Concurrency::InterruptibleThread::isInterrupted())
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    });
+    ASSERT_TRUE(eventually([&queued]() { return queued.load(); }));
+
+    thread.interrupt();
+    thread.join();
+    busy_worker.release();
+    ASSERT_TRUE(thread_pool.waitIdle());
+    EXPECT_EQ(runs.load(), 0);
+}
+
+TEST(ThreadPool, Cancellation_WakesATaskBlockedInAnInterruptibleWait)
+{
+    Concurrency::ThreadPool         thread_pool(1);
+    Concurrency::CancellationSource source;
+    std::mutex                      mutex;
+    std::condition_variable         condition;
+    std::atomic<bool>               waiting {false};
+
+    auto result = thread_pool.submit(source.token(), [&mutex, &condition, &waiting]()
+    {
+        std::unique_lock lock(mutex);
+        waiting.store(true);
+        return Concurrency::interruptibleWait(condition, lock, []() { return false; });
+    });
+    ASSERT_TRUE(eventually([&waiting]() { return waiting.load(); }));
+
+    source.cancel();
+    ASSERT_EQ(result.value().wait_for(std::chrono::seconds(5)), std::future_status::ready);
+    EXPECT_FALSE(result.value().get());
+}
+
+TEST(ThreadPool, Cancellation_InterruptWakesAThreadWaitingForATaskFuture)
+{
+    Concurrency::ThreadPool thread_pool(1);
+    std::atomic<bool>       started {false};
+    std::atomic<bool>       release {false};
+    std::atomic<bool>       waited {true};
+
+    // Run by the worker, nothing is left for the waiting thread to run.
+    auto result = thread_pool.spawn([&started, &release]()
+    {
+        started.store(true);
+        while (!release.load())
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return return_number;
+    });
+    ASSERT_TRUE(result.has_value());
+    ASSERT_TRUE(eventually([&started]() { return started.load(); }));
+
+    std::atomic<bool>                waiting {false};
+    std::atomic<bool>                returned {false};
+    Concurrency::InterruptibleThread thread([&result, &waited, &waiting, &returned]()
+    {
+        waiting.store(true);
+        waited.store(Concurrency::interruptibleWait(result.value()));
+        returned.store(true);
+    });
+    ASSERT_TRUE(eventually([&waiting]() { return waiting.load(); }));
+    // Let the thread block.
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+    // The wait sleeps on the future's state without a timeout: only the wake through the state ends it before the
+    // task is released.
+    thread.interrupt();
+    EXPECT_TRUE(eventually([&returned]() { return returned.load(); }));
+    release.store(true);
+    thread.join();
+    EXPECT_FALSE(waited.load());
+
+    Concurrency::InterruptibleThread late_waiter([&result, &waited]()
+    {
+        waited.store(Concurrency::interruptibleWait(result.value()));
+    });
+    late_waiter.join();
+    EXPECT_TRUE(waited.load());
+    EXPECT_EQ(result.value().get(), return_number);
+}
@@ -0,0 +1,147 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <latch>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "threadpool.h"
+
+namespace {
+
+using Concurrency::Internal::MovableFunction;
+using Concurrency::Internal::WorkStealingQueue;
+
+MovableFunction recordFunction(std::vector<int>& record, const int value)
+{
+	return MovableFunction([&record, value]() { record.push_back(value); });
+}
+
+} // namespace
+
+TEST(WorkStealingQueue, QueueIsEmpty_DequeueAndSteal_ReturnNull)
+{
+	WorkStealingQueue queue;
+	EXPECT_FALSE(queue.dequeue().has_value());
+	EXPECT_FALSE(queue.steal().has_value());
+}
+
+TEST(WorkStealingQueue, DequeueIsLIFO_StealIsFIFO)
+{
+	WorkStealingQueue queue;
+	std::vector<int>  record;
+
+	for (int i = 0; i < 4; ++i)
+	{
+		ASSERT_TRUE(queue.enqueue(recordFunction(record, i)));
+	}
+
+	queue.dequeue().value()();
+	queue.steal().value()();
+	queue.dequeue().value()();
+	queue.steal().value()();
+
+	EXPECT_EQ(record, (std::vector<int>{3, 0, 2, 1}));
+	EXPECT_FALSE(queue.dequeue().has_value());
+	EXPECT_FALSE(queue.steal().has_value());
+}
+
+TEST(WorkStealingQueue, EnqueueBeyondCapacity_QueueGrows)
+{
+	WorkStealingQueue queue;
+	std::vector<int>  record;
+	constexpr int     number_of_elems = 1000;
+
+	for (int i = 0; i < number_of_elems; ++i)
+	{
+		ASSERT_TRUE(queue.enqueue(recordFunction(record, i)));
+	}
+
+	for (int i = 0; i < number_of_elems / 2; ++i)
+	{
+		queue.steal().value()();
+	}
+	while (auto task = queue.dequeue())
+	{
+		task.value()();
+	}
+
+	ASSERT_EQ(record.size(), static_cast<size_t>(number_of_elems));
+	EXPECT_TRUE(std::is_sorted(record.begin(), record.begin() + number_of_elems / 2));
+	EXPECT_TRUE(std::is_sorted(record.begin() + number_of_elems / 2, record.end(), std::greater<>()));
+}
+
+TEST(WorkStealingQueue, Destruction_DestroysRemainingElements)
+{
+	auto counter = std::make_shared<int>(0);
+	{
+		WorkStealingQueue queue;
+		for (int i = 0; i < 100; ++i)
+		{
+			queue.enqueue(MovableFunction([counter]() {}));
+		}
+		queue.steal();
+		queue.dequeue();
+		EXPECT_EQ(counter.use_count(), 99);
+	}
+	EXPECT_EQ(counter.use_count(), 1);
+}
+
+TEST(WorkStealingQueue, OwnerAndThieves_EveryElementRunsOnce)
+{
+	constexpr int     number_of_elems   = 200'000;
+	constexpr int     number_of_thieves = 3;
+	WorkStealingQueue queue;
+	std::vector<int>  run_counts(number_of_elems, 0);
+	std::atomic<int>  executed_elems = 0;
+	std::latch        latch(number_of_thieves + 1);
+
+	auto run = [&executed_elems](MovableFunction& task)
+	{
+		task();
+		executed_elems.fetch_add(1, std::memory_order_relaxed);
+	};
+
+	std::vector<std::jthread> thieves;
+	for (int i = 0; i < number_of_thieves; ++i)
+	{
+		thieves.emplace_back([&]()
+		{
+			latch.arrive_and_wait();
+			while (executed_elems.load(std::memory_order_relaxed) < number_of_elems)
+			{
+				if (auto task = queue.steal())
+				{
+					run(task.value());
+				}
+			}
+		});
+	}
+
+	latch.arrive_and_wait();
+	for (int i = 0; i < number_of_elems; ++i)
+	{
+		// Every element writes its own counter, so racing executions of one element would show up as a count of 2.
+		ASSERT_TRUE(queue.enqueue(MovableFunction([&run_counts, i]() { ++run_counts[i]; })));
+		if (i % 3 == 0)
+		{
+			if (auto task = queue.dequeue())
+			{
+				run(task.value());
+			}
+		}
+	}
+
+	while (executed_elems.load(std::memory_order_relaxed) < number_of_elems)
+	{
+		if (auto task = queue.dequeue())
+		{
+			run(task.value());
+		}
+	}
+	thieves.clear();
+
+	EXPECT_TRUE(std::all_of(run_counts.begin(), run_counts.end(), [](const int count) { return count == 1; }));
+}
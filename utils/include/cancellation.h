@@ -0,0 +1,207 @@
+#ifndef CANCELLATION_H
+#define CANCELLATION_H
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+namespace Concurrency {
+
+namespace Internal {
+
+// A thread blocked in an interruptibleWait, woken by InterruptFlag::set once the flag is set.
+struct InterruptWaiter
+{
+    void (*wake) (InterruptWaiter& waiter) noexcept = nullptr;
+    InterruptWaiter*  next                          = nullptr;
+    // Set while set() is waking the waiter, it must outlive the wake.
+    std::atomic<bool> being_woken {false};
+};
+
+/**
+ * The state shared by a CancellationSource and its tokens. set() wakes the registered waiters outside of the lock of
+ * the list, a waker typically takes the mutex the waiter sleeps with, and the waiter holds it while it registers.
+ */
+class InterruptFlag
+{
+private:
+    std::atomic_flag _flag {};
+    std::mutex       _waiters_mutex;
+    InterruptWaiter* _waiters = nullptr;
+
+public:
+    [[nodiscard]] bool isSet () const noexcept
+    {
+        return _flag.test(std::memory_order_acquire);
+    }
+
+    void set () noexcept
+    {
+        if (_flag.test_and_set(std::memory_order_acq_rel))
+        {
+            return;
+        }
+
+        std::unique_lock lock(_waiters_mutex);
+        while (_waiters != nullptr)
+        {
+            InterruptWaiter& waiter = *std::exchange(_waiters, _waiters->next);
+            waiter.being_woken.store(true, std::memory_order_relaxed);
+            lock.unlock();
+
+            waiter.wake(waiter);
+            waiter.being_woken.store(false, std::memory_order_release);
+            lock.lock();
+        }
+    }
+
+    // Returns false, without registering, if the flag is already set.
+    bool addWaiter (InterruptWaiter& waiter)
+    {
+        std::lock_guard lock(_waiters_mutex);
+        if (isSet())
+        {
+            return false;
+        }
+
+        waiter.next = std::exchange(_waiters, &waiter);
+        return true;
+    }
+
+    // Returns false if set() is waking the waiter, the caller then releases what the waker needs and calls awaitWoken.
+    bool removeWaiter (InterruptWaiter& waiter)
+    {
+        std::lock_guard lock(_waiters_mutex);
+        if (waiter.being_woken.load(std::memory_order_relaxed))
+        {
+            return false;
+        }
+
+        for (InterruptWaiter** link = &_waiters; *link != nullptr; link = &(*link)->next)
+        {
+            if (*link == &waiter)
+            {
+                *link = waiter.next;
+                break;
+            }
+        }
+        return true;
+    }
+
+    static void awaitWoken (const InterruptWaiter& waiter) noexcept
+    {
+        while (waiter.being_woken.load(std::memory_order_acquire))
+        {
+            std::this_thread::yield();
+        }
+    }
+};
+
+class InterruptRegistration;
+
+} // namespace Internal
+
+/**
+ * Read side of a CancellationSource, cheap to copy and to poll. A default constructed token is never cancelled.
+ *
+ * The token of the code running on a thread is CancellationToken::current(): the token of an InterruptibleThread on
+ * its thread, the token of a ThreadPool task submitted with one while it runs. Tasks a thread runs while it helps the
+ * pool, e.g. in ThreadPool::runPendingTask, see the token of the code that helps.
+ */
+class CancellationToken
+{
+private:
+    std::shared_ptr<Internal::InterruptFlag> _flag;
+
+    inline static thread_local const CancellationToken* this_thread_token = nullptr;
+
+    friend class CancellationSource;
+    friend class Internal::InterruptRegistration;
+
+    explicit CancellationToken (std::shared_ptr<Internal::InterruptFlag> flag) noexcept
+        : _flag(std::move(flag))
+    {
+    }
+
+public:
+    CancellationToken () noexcept = default;
+
+    [[nodiscard]] bool isCancelled () const noexcept
+    {
+        return _flag != nullptr && _flag->isSet();
+    }
+
+    [[nodiscard]] bool canBeCancelled () const noexcept
+    {
+        return _flag != nullptr;
+    }
+
+    // Token of the code running on this thread, a token that is never cancelled if there is none.
+    [[nodiscard]] static CancellationToken current ()
+    {
+        return this_thread_token != nullptr ? *this_thread_token : CancellationToken();
+    }
+
+    // current().isCancelled() without copying the token.
+    [[nodiscard]] static bool isCurrentCancelled () noexcept
+    {
+        return this_thread_token != nullptr && this_thread_token->isCancelled();
+    }
+
+    // Makes a token current on this thread for its lifetime.
+    class Scope
+    {
+    private:
+        const CancellationToken* _previous;
+
+    public:
+        explicit Scope (const CancellationToken& token) noexcept
+            : _previous(std::exchange(this_thread_token, &token))
+        {
+        }
+
+        ~Scope ()
+        {
+            this_thread_token = _previous;
+        }
+
+        Scope (const Scope&)            = delete;
+        Scope& operator= (const Scope&) = delete;
+    };
+};
+
+/**
+ * Cancels the operations it handed its tokens to. Cancelling is a request: queued ThreadPool tasks holding a cancelled
+ * token are dropped instead of run, running code sees it when it polls its token.
+ */
+class CancellationSource
+{
+private:
+    std::shared_ptr<Internal::InterruptFlag> _flag = std::make_shared<Internal::InterruptFlag>();
+
+public:
+    [[nodiscard]] CancellationToken token () const noexcept
+    {
+        return CancellationToken(_flag);
+    }
+
+    /**
+     * Only the first call does anything. Wakes the interruptibleWait calls of the tokens: one on a
+     * std::condition_variable is woken under its mutex, so the caller must not hold that mutex.
+     */
+    void cancel () noexcept
+    {
+        _flag->set();
+    }
+
+    [[nodiscard]] bool isCancelled () const noexcept
+    {
+        return _flag->isSet();
+    }
+};
+
+} // namespace Concurrency
+
+#endif // CANCELLATION_H
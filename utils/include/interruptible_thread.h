@@ -4,47 +4,28 @@
 #include <type_traits>
 #include <thread>
 
-#include <iostream>
-#include <format>
+#include "cancellation.h"
+#include "interruptible_wait.h"
 
 namespace Concurrency {
 
-
-namespace Internal {
-
-struct InterruptFlag
-{
-    std::atomic_flag flag {};
-
-    [[nodiscard]] bool isSet () const
-    {
-        return flag.test(std::memory_order_relaxed);
-    }
-
-    void set ()
-    {
-        flag.test_and_set(std::memory_order_relaxed);
-    }
-};
-
-}
-
+/**
+ * A thread that can be asked to stop. interrupt() cancels the thread's CancellationToken, which is current on the
+ * thread: the thread polls it with isInterrupted(), and can pass it on to the pool tasks it submits so they are
+ * dropped once the thread is interrupted.
+ */
 class InterruptibleThread
 {
 
 private:
-    inline static thread_local Internal::InterruptFlag this_thread_interrupt_flag;
-
-    Internal::InterruptFlag*    _interrupt_flag;
+    // The thread shares the flag, interrupt() is safe even once the thread has ended.
+    CancellationSource          _interruption;
     std::thread                 _internal_thread;
-    std::atomic_flag            _is_ready;
 
     template <typename Callable, typename... Args>
-    void worker (Callable&& callable, Args&&... args)
+    static void worker (const CancellationToken token, Callable&& callable, Args&&... args)
     {
-        _interrupt_flag = &this_thread_interrupt_flag;
-        _is_ready.test_and_set();
-        _is_ready.notify_one();
+        CancellationToken::Scope scope(token);
         std::invoke(std::forward<Callable>(callable), std::forward<Args>(args)...);
     }
 
@@ -53,10 +34,8 @@ public:
     template <typename Callable, typename... Args>
     requires std::is_invocable_v<Callable, Args...>
     InterruptibleThread(Callable&& callable, Args&&... args)
-        : _interrupt_flag{nullptr}
     {
-        _internal_thread = std::thread(&InterruptibleThread::worker<Callable, Args...>, this, std::forward<Callable>(callable), std::forward<Args>(args)...);
-        _is_ready.wait(false);
+        _internal_thread = std::thread(&InterruptibleThread::worker<Callable, Args...>, _interruption.token(), std::forward<Callable>(callable), std::forward<Args>(args)...);
     }
 
     ~InterruptibleThread()
@@ -79,9 +58,10 @@ public:
         _internal_thread.join();
     }
 
+    // interrupt() does nothing once the thread is detached.
     void detach ()
     {
-        _interrupt_flag = nullptr;
+        _interruption = CancellationSource();
         _internal_thread.detach();
     }
 
@@ -90,19 +70,23 @@ public:
         return _internal_thread.joinable();
     }
 
+    // Cancels the thread's token, see CancellationSource::cancel: don't hold the mutex of a std::condition_variable
+    // the thread waits on in interruptibleWait.
     void interrupt ()
     {
-        if (!_interrupt_flag)
-        {
-            return;
-        }
+        _interruption.cancel();
+    }
 
-        _interrupt_flag->set();
+    [[nodiscard]] CancellationToken cancellationToken () const noexcept
+    {
+        return _interruption.token();
     }
 
+    // Whether the current token is cancelled: on an InterruptibleThread whether it was interrupted, in a ThreadPool
+    // task submitted with a token whether the token was cancelled.
     [[nodiscard]] bool static isInterrupted ()
     {
-        return this_thread_interrupt_flag.isSet();
+        return CancellationToken::isCurrentCancelled();
     }
 };
 
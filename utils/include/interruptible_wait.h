@@ -0,0 +1,232 @@
+#ifndef INTERRUPTIBLE_WAIT_H
+#define INTERRUPTIBLE_WAIT_H
+
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <climits>
+#include <condition_variable>
+#include <cstdint>
+#include <ctime>
+#include <future>
+#include <mutex>
+#include <stop_token>
+#include <type_traits>
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "cancellation.h"
+
+/**
+ * Blocking waits that return early when the current CancellationToken is cancelled: InterruptibleThread::interrupt()
+ * on an InterruptibleThread, the token's source in a ThreadPool task submitted with a token. Without a current token
+ * they wait like the plain wait.
+ *
+ * The condition variable waits register with the token and interrupt() wakes them at once. Waking a
+ * std::condition_variable waiter takes its mutex: the thread calling interrupt() or CancellationSource::cancel() must
+ * not hold the mutex of a std::condition_variable wait it interrupts, std::mutex isn't recursive. Other mutexes may be
+ * held, and the std::condition_variable_any wait takes no user mutex to be woken. std::future and
+ * std::atomic have no hook to wake a waiter from outside: a future is polled every interrupt_poll_interval, an atomic
+ * is woken at once by interrupt() but may see a change of its value only after interrupt_poll_interval, since
+ * std::atomic::notify_one/notify_all wake only threads in std::atomic::wait. A ThreadPool's TaskFuture has its own
+ * overload in threadpool.h, woken at once through the future's state.
+ */
+
+namespace Concurrency {
+
+inline constexpr std::chrono::milliseconds interrupt_poll_interval {1};
+
+namespace Internal {
+
+// Registers a waiter with the current token for the lifetime of the wait.
+class InterruptRegistration
+{
+private:
+    InterruptFlag*   _flag;
+    InterruptWaiter& _waiter;
+    bool             _registered = false;
+
+public:
+    explicit InterruptRegistration (InterruptWaiter& waiter)
+        : _flag(CancellationToken::this_thread_token != nullptr ? CancellationToken::this_thread_token->_flag.get()
+                                                                : nullptr),
+          _waiter(waiter)
+    {
+        _registered = _flag != nullptr && _flag->addWaiter(_waiter);
+    }
+
+    InterruptRegistration (const InterruptRegistration&)            = delete;
+    InterruptRegistration& operator= (const InterruptRegistration&) = delete;
+
+    [[nodiscard]] bool isInterrupted () const noexcept
+    {
+        return _flag != nullptr && _flag->isSet();
+    }
+
+    /**
+     * Must be called before the waiter goes away. If interrupt() is waking the waiter right now, the wake needs lock's
+     * mutex: lock is released until the wake is done.
+     */
+    template<typename Lock>
+    void unregister (Lock& lock)
+    {
+        if (_registered && !_flag->removeWaiter(_waiter))
+        {
+            lock.unlock();
+            InterruptFlag::awaitWoken(_waiter);
+            lock.lock();
+        }
+        _registered = false;
+    }
+
+    void unregister ()
+    {
+        if (_registered && !_flag->removeWaiter(_waiter))
+        {
+            InterruptFlag::awaitWoken(_waiter);
+        }
+        _registered = false;
+    }
+};
+
+/**
+ * Wakes a std::condition_variable waiter: taking its mutex means it has either not checked the flag yet or is waiting.
+ * The waker must not hold the mutex already.
+ */
+template<typename ConditionVariable, typename Mutex>
+struct ConditionVariableWaiter : InterruptWaiter
+{
+    ConditionVariable& condition;
+    Mutex&             mutex;
+
+    ConditionVariableWaiter (ConditionVariable& condition, Mutex& mutex) noexcept
+        : condition(condition), mutex(mutex)
+    {
+        wake = [](InterruptWaiter& waiter) noexcept
+        {
+            auto&           self = static_cast<ConditionVariableWaiter&>(waiter);
+            std::lock_guard lock(self.mutex);
+            self.condition.notify_all();
+        };
+    }
+};
+
+template<typename ConditionVariable, typename Lock, typename Mutex, typename Predicate>
+bool interruptibleWait (ConditionVariable& condition, Lock& lock, Mutex& mutex, Predicate& predicate)
+{
+    ConditionVariableWaiter<ConditionVariable, Mutex> waiter(condition, mutex);
+    InterruptRegistration                             registration(waiter);
+
+    while (!predicate() && !registration.isInterrupted())
+    {
+        condition.wait(lock);
+    }
+    registration.unregister(lock);
+    // The lock may have been released meanwhile.
+    return predicate();
+}
+
+/**
+ * Wakes a std::condition_variable_any waiter through the stop token of its wait, which notifies under the condition
+ * variable's internal mutex, like std::condition_variable_any::wait(lock, stop_token, predicate) does for
+ * std::stop_source::request_stop.
+ */
+struct StopSourceWaiter : InterruptWaiter
+{
+    std::stop_source source;
+
+    StopSourceWaiter ()
+    {
+        wake = [](InterruptWaiter& waiter) noexcept { static_cast<StopSourceWaiter&>(waiter).source.request_stop(); };
+    }
+};
+
+struct FutexWaiter : InterruptWaiter
+{
+    const void* address;
+
+    explicit FutexWaiter (const void* address) noexcept
+        : address(address)
+    {
+        wake = [](InterruptWaiter& waiter) noexcept
+        {
+            syscall(SYS_futex, static_cast<FutexWaiter&>(waiter).address, FUTEX_WAKE_PRIVATE, INT_MAX, nullptr,
+                    nullptr, 0);
+        };
+    }
+};
+
+} // namespace Internal
+
+/**
+ * condition.wait(lock, predicate) that also returns once interrupted. Returns predicate(): false means interrupted.
+ * interrupt() locks lock's mutex to wake the wait: don't interrupt or cancel while holding that mutex.
+ */
+template<typename Predicate>
+bool interruptibleWait (std::condition_variable& condition, std::unique_lock<std::mutex>& lock, Predicate predicate)
+{
+    return Internal::interruptibleWait(condition, lock, *lock.mutex(), predicate);
+}
+
+/**
+ * The same for std::condition_variable_any with any lock, e.g. a std::unique_lock, a std::shared_lock or a mutex used
+ * as the lock directly. interrupt() doesn't take lock's mutex, it may be called with that mutex held.
+ */
+template<typename Lock, typename Predicate>
+bool interruptibleWait (std::condition_variable_any& condition, Lock& lock, Predicate predicate)
+{
+    Internal::StopSourceWaiter      waiter;
+    Internal::InterruptRegistration registration(waiter);
+
+    // A token cancelled before the wait registered never stops the source, the predicate sees it.
+    condition.wait(lock, waiter.source.get_token(),
+                   [&predicate, &registration]() { return predicate() || registration.isInterrupted(); });
+    registration.unregister();
+    return predicate();
+}
+
+/**
+ * Wait until the std::future or std::shared_future is ready. Returns false if interrupted first.
+ */
+template<typename Future>
+requires requires(const Future& future) { future.wait_for(interrupt_poll_interval); }
+bool interruptibleWait (const Future& future)
+{
+    while (future.wait_for(interrupt_poll_interval) != std::future_status::ready)
+    {
+        if (CancellationToken::isCurrentCancelled())
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Wait until atomic no longer holds old, like atomic.wait(old, order). Returns false if interrupted first.
+ * Only for 32-bit atomics, which a futex can sleep on.
+ */
+template<typename T>
+requires (sizeof(T) == sizeof(uint32_t) && std::atomic<T>::is_always_lock_free)
+bool interruptibleWait (const std::atomic<T>& atomic, const T old,
+                        const std::memory_order order = std::memory_order_seq_cst)
+{
+    Internal::FutexWaiter           waiter(&atomic);
+    Internal::InterruptRegistration registration(waiter);
+
+    const auto     old_bits = std::bit_cast<uint32_t>(old);
+    const timespec timeout {.tv_sec  = 0,
+                            .tv_nsec = static_cast<long>(std::chrono::nanoseconds(interrupt_poll_interval).count())};
+    while (std::bit_cast<uint32_t>(atomic.load(order)) == old_bits && !registration.isInterrupted())
+    {
+        syscall(SYS_futex, &atomic, FUTEX_WAIT_PRIVATE, old_bits, &timeout, nullptr, 0);
+    }
+    registration.unregister();
+    return std::bit_cast<uint32_t>(atomic.load(order)) != old_bits;
+}
+
+} // namespace Concurrency
+
+#endif // INTERRUPTIBLE_WAIT_H
@@ -0,0 +1,85 @@
+#include <gtest/gtest.h>
+
+#include "cancellation.h"
+#include "interruptible_thread.h"
+
+#include <chrono>
+#include <future>
+#include <thread>
+
+TEST(CancellationTest, CancelSource_EveryTokenSeesIt)
+{
+    Concurrency::CancellationSource source;
+    const Concurrency::CancellationToken first  = source.token();
+    const Concurrency::CancellationToken second = first;
+    EXPECT_TRUE(first.canBeCancelled());
+    EXPECT_FALSE(second.isCancelled());
+
+    source.cancel();
+    EXPECT_TRUE(source.isCancelled());
+    EXPECT_TRUE(first.isCancelled());
+    EXPECT_TRUE(second.isCancelled());
+}
+
+TEST(CancellationTest, DefaultToken_IsNeverCancelled)
+{
+    const Concurrency::CancellationToken token;
+    EXPECT_FALSE(token.canBeCancelled());
+    EXPECT_FALSE(token.isCancelled());
+    EXPECT_FALSE(Concurrency::CancellationToken::current().canBeCancelled());
+    EXPECT_FALSE(Concurrency::CancellationToken::isCurrentCancelled());
+}
+
+TEST(CancellationTest, Scope_MakesTheTokenCurrentUntilItEnds)
+{
+    Concurrency::CancellationSource outer;
+    Concurrency::CancellationSource inner;
+    inner.cancel();
+
+    const Concurrency::CancellationToken outer_token = outer.token();
+    const Concurrency::CancellationToken inner_token = inner.token();
+    {
+        Concurrency::CancellationToken::Scope outer_scope(outer_token);
+        EXPECT_FALSE(Concurrency::InterruptibleThread::isInterrupted());
+        {
+            Concurrency::CancellationToken::Scope inner_scope(inner_token);
+            EXPECT_TRUE(Concurrency::InterruptibleThread::isInterrupted());
+        }
+        EXPECT_FALSE(Concurrency::CancellationToken::isCurrentCancelled());
+        EXPECT_TRUE(Concurrency::CancellationToken::current().canBeCancelled());
+    }
+    EXPECT_FALSE(Concurrency::CancellationToken::current().canBeCancelled());
+}
+
+TEST(CancellationTest, InterruptibleThread_InterruptCancelsItsToken)
+{
+    std::promise<Concurrency::CancellationToken> current;
+    std::future<Concurrency::CancellationToken>  current_future = current.get_future();
+
+    Concurrency::InterruptibleThread thread([&current]()
+    {
+        current.set_value(Concurrency::CancellationToken::current());
+        while (!Concurrency::InterruptibleThread::isInterrupted())
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    });
+
+    const Concurrency::CancellationToken token = thread.cancellationToken();
+    const Concurrency::CancellationToken seen  = current_future.get();
+    EXPECT_FALSE(token.isCancelled());
+
+    thread.interrupt();
+    EXPECT_TRUE(token.isCancelled());
+    EXPECT_TRUE(seen.isCancelled());
+    thread.join();
+}
+
+TEST(CancellationTest, InterruptibleThread_InterruptAfterTheThreadEndedIsSafe)
+{
+    Concurrency::InterruptibleThread thread([]() {});
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    thread.interrupt();
+    EXPECT_TRUE(thread.cancellationToken().isCancelled());
+    thread.join();
+}
@@ -0,0 +1,264 @@
+#include <gtest/gtest.h>
+
+#include "interruptible_thread.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+
+namespace {
+
+// Each wait below would block for good without interrupt(), this is how long the thread may take to notice instead.
+constexpr std::chrono::milliseconds latency_bound {50};
+
+/**
+ * The waits that poll notice within interrupt_poll_interval, plus the time to get back on a CPU. They are measured a
+ * few times and the best run is held to the bound, so a single late scheduling doesn't fail the test.
+ */
+constexpr std::chrono::nanoseconds poll_bound = Concurrency::interrupt_poll_interval + std::chrono::microseconds(500);
+constexpr int                      poll_runs  = 5;
+
+template<typename Measure>
+std::chrono::nanoseconds bestOf (const int runs, Measure measure)
+{
+    std::chrono::nanoseconds best = std::chrono::nanoseconds::max();
+    for (int run = 0; run < runs; ++run)
+    {
+        best = std::min(best, measure());
+    }
+    return best;
+}
+
+/**
+ * Run wait on an InterruptibleThread, interrupt it once it waits and return the time from interrupt() to the end of
+ * the wait. wait returns what the interruptible wait returned, which must be false.
+ */
+std::chrono::nanoseconds interruptToExitLatency (std::function<bool()> wait)
+{
+    std::atomic<bool>                     waiting {false};
+    std::atomic<bool>                     result {true};
+    std::chrono::steady_clock::time_point exited_at;
+
+    Concurrency::InterruptibleThread thread([&wait, &waiting, &result, &exited_at]()
+    {
+        waiting.store(true);
+        result.store(wait());
+        exited_at = std::chrono::steady_clock::now();
+    });
+
+    while (!waiting.load())
+    {
+        std::this_thread::yield();
+    }
+    // Let the thread block.
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+    const auto interrupted_at = std::chrono::steady_clock::now();
+    thread.interrupt();
+    thread.join();
+
+    EXPECT_FALSE(result.load());
+    const auto latency = exited_at - interrupted_at;
+    testing::Test::RecordProperty("interrupt_to_exit_us",
+                                  static_cast<int>(std::chrono::duration_cast<std::chrono::microseconds>(latency).count()));
+    return latency;
+}
+
+} // namespace
+
+TEST(InterruptibleWaitTest, ConditionVariable_InterruptWakesTheWaiterAtOnce)
+{
+    std::mutex              mutex;
+    std::condition_variable condition;
+
+    const auto latency = interruptToExitLatency([&mutex, &condition]()
+    {
+        std::unique_lock lock(mutex);
+        const bool       ready = Concurrency::interruptibleWait(condition, lock, []() { return false; });
+        EXPECT_TRUE(lock.owns_lock());
+        return ready;
+    });
+    EXPECT_LT(latency, latency_bound);
+}
+
+TEST(InterruptibleWaitTest, ConditionVariable_ReturnsOnceThePredicateHolds)
+{
+    std::mutex              mutex;
+    std::condition_variable condition;
+    bool                    ready = false;
+    std::promise<bool>      result;
+
+    Concurrency::InterruptibleThread thread([&mutex, &condition, &ready, &result]()
+    {
+        std::unique_lock lock(mutex);
+        result.set_value(Concurrency::interruptibleWait(condition, lock, [&ready]() { return ready; }));
+    });
+
+    {
+        std::lock_guard lock(mutex);
+        ready = true;
+    }
+    condition.notify_all();
+    EXPECT_TRUE(result.get_future().get());
+    thread.join();
+}
+
+TEST(InterruptibleWaitTest, ConditionVariable_CancelWhileHoldingAnotherMutexWakesTheWaiter)
+{
+    // Only the waiter's own mutex must not be held by the thread that cancels, the wake locks it.
+    std::mutex                      mutex;
+    std::condition_variable         condition;
+    std::mutex                      state_mutex;
+    bool                            stopping = false;
+    Concurrency::CancellationSource source;
+    std::atomic<bool>               waiting {false};
+    std::promise<bool>              result;
+
+    std::thread waiter([&mutex, &condition, &source, &waiting, &result]()
+    {
+        const Concurrency::CancellationToken  token = source.token();
+        Concurrency::CancellationToken::Scope scope(token);
+        std::unique_lock                      lock(mutex);
+        waiting.store(true);
+        result.set_value(Concurrency::interruptibleWait(condition, lock, []() { return false; }));
+    });
+
+    while (!waiting.load())
+    {
+        std::this_thread::yield();
+    }
+    {
+        std::lock_guard lock(state_mutex);
+        stopping = true;
+        source.cancel();
+    }
+    auto future = result.get_future();
+    ASSERT_EQ(future.wait_for(std::chrono::seconds(5)), std::future_status::ready);
+    EXPECT_FALSE(future.get());
+    EXPECT_TRUE(stopping);
+    waiter.join();
+}
+
+TEST(InterruptibleWaitTest, ConditionVariableAny_InterruptWhileHoldingTheWaitersMutexWakesTheWaiter)
+{
+    std::mutex                  mutex;
+    std::condition_variable_any condition;
+    bool                        stopping = false;
+    std::atomic<bool>           waiting {false};
+    std::promise<bool>          result;
+
+    Concurrency::InterruptibleThread thread([&mutex, &condition, &waiting, &result]()
+    {
+        std::unique_lock lock(mutex);
+        waiting.store(true);
+        result.set_value(Concurrency::interruptibleWait(condition, lock, []() { return false; }));
+    });
+
+    while (!waiting.load())
+    {
+        std::this_thread::yield();
+    }
+    {
+        // Holding the mutex the thread waits with, the common "mark the state, then interrupt" controller.
+        std::lock_guard lock(mutex);
+        stopping = true;
+        thread.interrupt();
+    }
+    auto future = result.get_future();
+    ASSERT_EQ(future.wait_for(std::chrono::seconds(5)), std::future_status::ready);
+    EXPECT_FALSE(future.get());
+    EXPECT_TRUE(stopping);
+    thread.join();
+}
+
+TEST(InterruptibleWaitTest, ConditionVariableAny_InterruptWakesAWaiterWithASharedLock)
+{
+    std::shared_mutex           mutex;
+    std::condition_variable_any condition;
+
+    const auto latency = interruptToExitLatency([&mutex, &condition]()
+    {
+        std::shared_lock lock(mutex);
+        return Concurrency::interruptibleWait(condition, lock, []() { return false; });
+    });
+    EXPECT_LT(latency, latency_bound);
+}
+
+TEST(InterruptibleWaitTest, ConditionVariableAny_InterruptWakesAWaiterLockingTheMutexDirectly)
+{
+    std::mutex                  mutex;
+    std::condition_variable_any condition;
+
+    const auto latency = interruptToExitLatency([&mutex, &condition]()
+    {
+        std::lock_guard lock(mutex);
+        return Concurrency::interruptibleWait(condition, mutex, []() { return false; });
+    });
+    EXPECT_LT(latency, latency_bound);
+}
+
+TEST(InterruptibleWaitTest, Future_InterruptWakesTheWaiter)
+{
+    std::promise<int> promise;
+    std::future<int>  future = promise.get_future();
+
+    const auto latency = bestOf(poll_runs, [&future]()
+    {
+        return interruptToExitLatency([&future]() { return Concurrency::interruptibleWait(future); });
+    });
+    EXPECT_LE(latency, poll_bound);
+    EXPECT_EQ(future.wait_for(std::chrono::seconds(0)), std::future_status::timeout);
+}
+
+TEST(InterruptibleWaitTest, Future_ReturnsOnceReady)
+{
+    std::promise<int>      promise;
+    std::shared_future<int> future = promise.get_future().share();
+
+    Concurrency::InterruptibleThread thread([&promise]()
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        promise.set_value(7);
+    });
+    EXPECT_TRUE(Concurrency::interruptibleWait(future));
+    EXPECT_EQ(future.get(), 7);
+    thread.join();
+}
+
+TEST(InterruptibleWaitTest, Atomic_InterruptWakesTheWaiter)
+{
+    std::atomic<int> value {0};
+
+    const auto latency = interruptToExitLatency([&value]() { return Concurrency::interruptibleWait(value, 0); });
+    EXPECT_LT(latency, latency_bound);
+}
+
+TEST(InterruptibleWaitTest, Atomic_ReturnsOnceTheValueChanged)
+{
+    // Only a poll sees the change, notify_all doesn't wake the futex the wait sleeps on.
+    const auto latency = bestOf(poll_runs, []()
+    {
+        std::atomic<uint32_t>                 value {0};
+        std::chrono::steady_clock::time_point stored_at;
+
+        Concurrency::InterruptibleThread thread([&value, &stored_at]()
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            stored_at = std::chrono::steady_clock::now();
+            value.store(1);
+            value.notify_all();
+        });
+        EXPECT_TRUE(Concurrency::interruptibleWait(value, 0u));
+        const auto returned_at = std::chrono::steady_clock::now();
+        EXPECT_EQ(value.load(), 1u);
+        thread.join();
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(returned_at - stored_at);
+    });
+    EXPECT_LE(latency, poll_bound);
+}